@@ -41,7 +41,7 @@ CommonAudioProcessor::CommonAudioProcessor(const BusesProperties& busesPropertie
     effects.push_back(volumeEffect);
     effects.push_back(thresholdEffect);
 
-    wavParser.setLooping(false);
+    wavParser->setLooping(false);
 }
 
 void CommonAudioProcessor::addAllParameters() {
@@ -188,29 +188,35 @@ double CommonAudioProcessor::getSampleRate() {
 }
 
 void CommonAudioProcessor::loadAudioFile(const juce::File& file) {
-    auto stream = std::make_unique<juce::FileInputStream>(file);
-    if (stream->openedOk()) {
-        loadAudioFile(std::move(stream));
-    }
+    auto parser = std::make_unique<WavParser>(*this);
+    // files are opened directly, so that WAV and AIFF files can be memory mapped
+    parser->parse(file);
+    setWavParser(std::move(parser));
 }
 
 void CommonAudioProcessor::loadAudioFile(std::unique_ptr<juce::InputStream> stream) {
     if (stream != nullptr) {
-        juce::SpinLock::ScopedLockType lock(wavParserLock);
-        wavParser.parse(std::move(stream));
-
-        juce::SpinLock::ScopedLockType lock2(audioPlayerListenersLock);
-        for (auto listener : audioPlayerListeners) {
-            listener->parserChanged();
-        }
+        auto parser = std::make_unique<WavParser>(*this);
+        parser->parse(std::move(stream));
+        setWavParser(std::move(parser));
     }
 }
 
 void CommonAudioProcessor::stopAudioFile() {
-    juce::SpinLock::ScopedLockType lock(wavParserLock);
-    wavParser.close();
+    setWavParser(std::make_unique<WavParser>(*this));
+}
 
-    juce::SpinLock::ScopedLockType lock2(audioPlayerListenersLock);
+void CommonAudioProcessor::setWavParser(std::unique_ptr<WavParser> parser) {
+    parser->setLooping(wavParser->isLooping());
+    parser->setPaused(wavParser->isPaused());
+    {
+        juce::SpinLock::ScopedLockType lock(wavParserLock);
+        std::swap(wavParser, parser);
+    }
+    // the old parser's decoding thread is stopped outside the lock
+    parser = nullptr;
+
+    juce::SpinLock::ScopedLockType lock(audioPlayerListenersLock);
     for (auto listener : audioPlayerListeners) {
         listener->parserChanged();
     }
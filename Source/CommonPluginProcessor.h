@@ -94,8 +94,12 @@ public:
         )
     );
 
+    // The audio thread holds wavParserLock while it plays from wavParser. A new
+    // file is opened by a new parser outside the lock, which is then swapped
+    // in, so the audio thread never waits for a file to open or a thread to
+    // stop. wavParser is only replaced on the message thread.
     juce::SpinLock wavParserLock;
-    WavParser wavParser{ *this };
+    std::unique_ptr<WavParser> wavParser = std::make_unique<WavParser>(*this);
 
     std::atomic<double> currentSampleRate = 0.0;
     juce::SpinLock effectsLock;
@@ -129,6 +133,9 @@ protected:
     
     void saveProperties(juce::XmlElement& xml);
     void loadProperties(juce::XmlElement& xml);
+    // swaps in a parser that has already opened its file, keeping whether
+    // playback is paused or looping
+    void setWavParser(std::unique_ptr<WavParser> parser);
     
     juce::SpinLock propertiesLock;
     std::unordered_map<std::string, std::any> properties;
@@ -11,6 +11,7 @@ FrameSettingsComponent::FrameSettingsComponent(OscirenderAudioProcessor& p, Osci
 	addAndMakeVisible(offsetLabel);
 	addAndMakeVisible(offsetBox);
 	addAndMakeVisible(invertImage);
+	addAndMakeVisible(traceImage);
 	addAndMakeVisible(threshold);
 	addAndMakeVisible(stride);
 
@@ -54,7 +55,7 @@ void FrameSettingsComponent::resized() {
     double rowHeight = 20;
     
     auto toggleBounds = area.removeFromTop(rowHeight);
-    auto toggleWidth = juce::jmin(area.getWidth() / 3, 150);
+    auto toggleWidth = juce::jmin(area.getWidth() / (image ? 4 : 3), 150);
     
     if (animated) {
         animate.setBounds(toggleBounds.removeFromLeft(toggleWidth));
@@ -77,6 +78,7 @@ void FrameSettingsComponent::resized() {
 
     if (image) {
         invertImage.setBounds(toggleBounds.removeFromLeft(toggleWidth));
+        traceImage.setBounds(toggleBounds.removeFromLeft(toggleWidth));
         
         auto secondColumn = area;
         secondColumn.removeFromTop(5);
@@ -122,6 +124,7 @@ void FrameSettingsComponent::setAnimated(bool animated) {
 void FrameSettingsComponent::setImage(bool image) {
     this->image = image;
     invertImage.setVisible(image);
+    traceImage.setVisible(image);
     threshold.setVisible(image);
     stride.setVisible(image);
 }
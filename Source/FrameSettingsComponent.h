@@ -34,6 +34,7 @@ private:
     DoubleTextBox offsetBox{ audioProcessor.animationOffset->min, audioProcessor.animationRate->max };
 
     jux::SwitchButton invertImage{audioProcessor.invertImage};
+    jux::SwitchButton traceImage{audioProcessor.traceImage};
     EffectComponent threshold{*audioProcessor.imageThreshold};
     EffectComponent stride{*audioProcessor.imageStride};
 
@@ -10,7 +10,7 @@ MainComponent::MainComponent(OscirenderAudioProcessor& p, OscirenderAudioProcess
     fileButton.setButtonText("Choose File(s)");
     
 	fileButton.onClick = [this] {
-		chooser = std::make_unique<juce::FileChooser>("Open", audioProcessor.lastOpenedDirectory, "*.obj;*.svg;*.lua;*.txt;*.gpla;*.gif;*.png;*.jpg;*.jpeg;*.wav;*.aiff");
+		chooser = std::make_unique<juce::FileChooser>("Open", audioProcessor.lastOpenedDirectory, "*.obj;*.ply;*.stl;*.svg;*.lua;*.txt;*.gpla;*.zip;*.gif;*.png;*.jpg;*.jpeg;*.y4m;*.gray;*.wav;*.aiff");
 		auto flags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectMultipleItems |
             juce::FileBrowserComponent::canSelectFiles;
 
@@ -159,6 +159,8 @@ void MainComponent::updateFileLabel() {
 		fileLabel.setText("Rendering from Blender", juce::dontSendNotification);
 	} else if (audioProcessor.getCurrentFileIndex() == -1) {
 		fileLabel.setText("No file open", juce::dontSendNotification);
+	} else if (audioProcessor.getCurrentFileParser()->isParsing()) {
+		fileLabel.setText("Loading " + audioProcessor.getCurrentFileName() + "...", juce::dontSendNotification);
 	} else {
 		fileLabel.setText(audioProcessor.getCurrentFileName(), juce::dontSendNotification);
 	}
@@ -0,0 +1,149 @@
+#include "ObjComponent.h"
+#include "PluginEditor.h"
+
+ObjComponent::ObjComponent(OscirenderAudioProcessor& p, OscirenderAudioProcessorEditor& editor) : audioProcessor(p), pluginEditor(editor) {
+	setText("Object Settings");
+
+	addAndMakeVisible(solver);
+	addAndMakeVisible(timeBudgetLabel);
+	addAndMakeVisible(timeBudgetBox);
+	addAndMakeVisible(featureEdges);
+	addAndMakeVisible(creaseAngleLabel);
+	addAndMakeVisible(creaseAngleBox);
+	addAndMakeVisible(simplify);
+	addAndMakeVisible(targetEdgesBox);
+	addAndMakeVisible(fitToFrequency);
+	addAndMakeVisible(pathLabel);
+
+	solver.addItem("Automatic Path", (int) ObjSettings::Solver::Automatic + 1);
+	solver.addItem("Shortest Path", (int) ObjSettings::Solver::Exact + 1);
+	solver.addItem("Approximate Path", (int) ObjSettings::Solver::Approximate + 1);
+	solver.setTooltip("Controls how the path through the model's edges is found. The shortest path can take a very long time to find for large models, so Automatic finds an approximate path for these instead.");
+
+	timeBudgetLabel.setTooltip("The number of seconds that can be spent finding an approximate path. Longer times give shorter paths.");
+	timeBudgetBox.setJustification(juce::Justification::left);
+
+	featureEdges.setTooltip("Only draws the edges that outline the model: its boundaries, sharp creases, and edges between different objects or materials. This gives a clearer image with a much shorter path for detailed models.");
+	creaseAngleLabel.setTooltip("Edges where the faces either side meet at more than this angle are drawn when only drawing the outline.");
+	creaseAngleBox.setJustification(juce::Justification::left);
+
+	simplify.setTooltip("Simplifies the model to about this many edges before finding the path, keeping its shape as close as possible. This makes large models much quicker to load and draw.");
+	targetEdgesBox.setJustification(juce::Justification::left);
+	fitToFrequency.setTooltip("Simplifies the model to as many edges as there are samples in each cycle at the current frequency, so every edge can be drawn.");
+
+	pathLabel.setTooltip("How much longer the path is than the shortest possible path, at most.");
+
+	update();
+
+	auto updateSettings = [this]() {
+		juce::SpinLock::ScopedLockType lock1(audioProcessor.parsersLock);
+		juce::SpinLock::ScopedLockType lock2(audioProcessor.effectsLock);
+		int index = audioProcessor.getCurrentFileIndex();
+		if (index == -1) {
+			return;
+		}
+		ObjSettings settings;
+		settings.solver = (ObjSettings::Solver) (solver.getSelectedId() - 1);
+		settings.timeBudget = timeBudgetBox.getValue();
+		settings.featureEdges = featureEdges.getToggleState();
+		settings.creaseAngle = creaseAngleBox.getValue();
+		settings.simplify = simplify.getToggleState();
+		settings.targetEdges = juce::jmax(1, (int) targetEdgesBox.getValue());
+		ObjSettings& current = audioProcessor.objSettings[index];
+		if (settings.solver != current.solver || settings.timeBudget != current.timeBudget || settings.featureEdges != current.featureEdges || settings.creaseAngle != current.creaseAngle || settings.simplify != current.simplify || settings.targetEdges != current.targetEdges) {
+			audioProcessor.objSettings[index] = settings;
+			audioProcessor.openFile(index);
+		}
+		update();
+	};
+
+	solver.onChange = updateSettings;
+	timeBudgetBox.onFocusLost = updateSettings;
+	featureEdges.onClick = updateSettings;
+	creaseAngleBox.onFocusLost = updateSettings;
+	simplify.onClick = updateSettings;
+	targetEdgesBox.onFocusLost = updateSettings;
+	fitToFrequency.onClick = [this, updateSettings]() {
+		double samplesPerCycle = audioProcessor.currentSampleRate / audioProcessor.frequency;
+		if (samplesPerCycle >= 1) {
+			simplify.setToggleState(true, juce::dontSendNotification);
+			targetEdgesBox.setValue(std::floor(samplesPerCycle), false, 0);
+			updateSettings();
+		}
+	};
+}
+
+void ObjComponent::resized() {
+	auto area = getLocalBounds().withTrimmedTop(20).reduced(20);
+	double rowHeight = 30;
+	solver.setBounds(area.removeFromTop(rowHeight).reduced(0, 3));
+	auto timeBudgetBounds = area.removeFromTop(rowHeight).reduced(0, 5);
+	timeBudgetLabel.setBounds(timeBudgetBounds.removeFromLeft(140));
+	timeBudgetBox.setBounds(timeBudgetBounds.removeFromLeft(60));
+	featureEdges.setBounds(area.removeFromTop(rowHeight));
+	auto creaseAngleBounds = area.removeFromTop(rowHeight).reduced(0, 5);
+	creaseAngleLabel.setBounds(creaseAngleBounds.removeFromLeft(140));
+	creaseAngleBox.setBounds(creaseAngleBounds.removeFromLeft(60));
+	auto simplifyBounds = area.removeFromTop(rowHeight);
+	simplify.setBounds(simplifyBounds.removeFromLeft(100));
+	targetEdgesBox.setBounds(simplifyBounds.removeFromLeft(70).reduced(0, 5));
+	fitToFrequency.setBounds(simplifyBounds.removeFromLeft(130).reduced(5, 3));
+	pathLabel.setBounds(area.removeFromTop(rowHeight));
+}
+
+// parsersLock must be locked before calling this function
+void ObjComponent::update() {
+	int index = audioProcessor.getCurrentFileIndex();
+	if (index == -1) {
+		return;
+	}
+
+	ObjSettings settings = audioProcessor.objSettings[index];
+	solver.setSelectedId((int) settings.solver + 1, juce::dontSendNotification);
+	timeBudgetBox.setValue(settings.timeBudget, false, 1);
+	featureEdges.setToggleState(settings.featureEdges, juce::dontSendNotification);
+	creaseAngleBox.setValue(settings.creaseAngle, false, 1);
+	creaseAngleLabel.setEnabled(settings.featureEdges);
+	creaseAngleBox.setEnabled(settings.featureEdges);
+	simplify.setToggleState(settings.simplify, juce::dontSendNotification);
+	targetEdgesBox.setValue(settings.targetEdges, false, 0);
+	targetEdgesBox.setEnabled(settings.simplify);
+
+	updatePathLabel();
+}
+
+void ObjComponent::timerCallback() {
+	juce::SpinLock::ScopedLockType lock(audioProcessor.parsersLock);
+	if (audioProcessor.getCurrentFileIndex() == -1) {
+		stopTimer();
+		return;
+	}
+	updatePathLabel();
+}
+
+void ObjComponent::updatePathLabel() {
+	auto parser = audioProcessor.getCurrentFileParser();
+	auto object = parser->getObject();
+	if (parser->isParsing()) {
+		pathLabel.setText("Finding path... " + juce::String(juce::roundToInt(100 * parser->getParseProgress())) + "%", juce::dontSendNotification);
+		if (!isTimerRunning()) {
+			startTimerHz(10);
+		}
+		return;
+	}
+
+	stopTimer();
+	if (object == nullptr || object->pathLowerBound <= 0) {
+		pathLabel.setText("", juce::dontSendNotification);
+	} else {
+		if (object->loadMemory > 0) {
+			pathLabel.setTooltip("How much longer the path is than the shortest possible path, at most. Loading the model used about " + juce::File::descriptionOfSizeInBytes(object->loadMemory) + ".");
+		}
+		double overhead = 100 * (object->pathLength / object->pathLowerBound - 1);
+		if (overhead < 0.05) {
+			pathLabel.setText("Path is the shortest possible", juce::dontSendNotification);
+		} else {
+			pathLabel.setText("Path is at most " + juce::String(overhead, 1) + "% longer than the shortest", juce::dontSendNotification);
+		}
+	}
+}
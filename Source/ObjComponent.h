@@ -0,0 +1,34 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "components/DoubleTextBox.h"
+
+class OscirenderAudioProcessorEditor;
+class ObjComponent : public juce::GroupComponent, public juce::Timer {
+public:
+    ObjComponent(OscirenderAudioProcessor&, OscirenderAudioProcessorEditor&);
+
+    void resized() override;
+    void update();
+    // refreshes how far through finding the path the parse is
+    void timerCallback() override;
+private:
+    void updatePathLabel();
+
+    OscirenderAudioProcessor& audioProcessor;
+    OscirenderAudioProcessorEditor& pluginEditor;
+
+    juce::ComboBox solver;
+    juce::Label timeBudgetLabel{"Time Budget", "Time Budget (s)"};
+    DoubleTextBox timeBudgetBox{0.0, 600.0};
+    juce::ToggleButton featureEdges{"Outline Only"};
+    juce::Label creaseAngleLabel{"Crease Angle", "Crease Angle (deg)"};
+    DoubleTextBox creaseAngleBox{0.0, 180.0};
+    juce::ToggleButton simplify{"Simplify to"};
+    DoubleTextBox targetEdgesBox{1.0, 1000000.0};
+    juce::TextButton fitToFrequency{"Fit to Frequency"};
+    juce::Label pathLabel;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ObjComponent)
+};
@@ -17,11 +17,11 @@ OscirenderAudioProcessorEditor::OscirenderAudioProcessorEditor(OscirenderAudioPr
     addAndMakeVisible(console);
     console.setConsoleOpen(false);
     
-	LuaParser::onPrint = [this](const std::string& message) {
+	audioProcessor.luaDiagnostics.onPrint = [this](const std::string& message) {
 		console.print(message);
 	};
 
-    LuaParser::onClear = [this]() {
+    audioProcessor.luaDiagnostics.onClear = [this]() {
         console.clear();
     };
 
@@ -87,6 +87,8 @@ OscirenderAudioProcessorEditor::OscirenderAudioProcessorEditor(OscirenderAudioPr
 OscirenderAudioProcessorEditor::~OscirenderAudioProcessorEditor() {
     menuBar.setModel(nullptr);
     juce::MessageManagerLock lock;
+    audioProcessor.luaDiagnostics.onPrint = nullptr;
+    audioProcessor.luaDiagnostics.onClear = nullptr;
     audioProcessor.broadcaster.removeChangeListener(this);
     audioProcessor.fileChangeBroadcaster.removeChangeListener(this);
 }
@@ -107,6 +109,9 @@ bool OscirenderAudioProcessorEditor::isInterestedInFileDrag(const juce::StringAr
     }
     juce::File file(files[0]);
     return
+        // folders of SVGs, which are played as a sequence
+        file.isDirectory() ||
+        file.hasFileExtension("zip") ||
         file.hasFileExtension("wav") ||
         file.hasFileExtension("aiff") ||
         file.hasFileExtension("osci") ||
@@ -114,9 +119,13 @@ bool OscirenderAudioProcessorEditor::isInterestedInFileDrag(const juce::StringAr
         file.hasFileExtension("lua") ||
         file.hasFileExtension("svg") ||
         file.hasFileExtension("obj") ||
+        file.hasFileExtension("ply") ||
+        file.hasFileExtension("stl") ||
         file.hasFileExtension("gif") ||
         file.hasFileExtension("png") ||
         file.hasFileExtension("jpg") ||
+        file.hasFileExtension("y4m") ||
+        file.hasFileExtension("gray") ||
         file.hasFileExtension("gpla");
 }
 
@@ -139,7 +148,7 @@ void OscirenderAudioProcessorEditor::filesDropped(const juce::StringArray& files
 }
 
 bool OscirenderAudioProcessorEditor::isBinaryFile(juce::String name) {
-    return name.endsWith(".gpla") || name.endsWith(".gif") || name.endsWith(".png") || name.endsWith(".jpg") || name.endsWith(".jpeg") || name.endsWith(".wav") || name.endsWith(".aiff");
+    return name.endsWith(".gpla") || name.endsWith(".ply") || name.endsWith(".stl") || name.endsWith(".gif") || name.endsWith(".png") || name.endsWith(".jpg") || name.endsWith(".jpeg") || name.endsWith(".y4m") || name.endsWith(".gray") || name.endsWith(".wav") || name.endsWith(".aiff") || name.endsWith(".zip");
 }
 
 // parsersLock must be held
@@ -17,6 +17,9 @@
 #include "audio/BulgeEffect.h"
 #include "audio/EffectParameter.h"
 
+// the synth renders x, y and z
+static const int NUM_SYNTH_CHANNELS = 3;
+
 //==============================================================================
 OscirenderAudioProcessor::OscirenderAudioProcessor() : CommonAudioProcessor(BusesProperties().withInput("Input", juce::AudioChannelSet::namedChannelSet(2), true).withOutput("Output", juce::AudioChannelSet::stereo(), true)) {
     // locking isn't necessary here because we are in the constructor
@@ -157,6 +160,7 @@ OscirenderAudioProcessor::OscirenderAudioProcessor() : CommonAudioProcessor(Buse
     booleanParameters.push_back(animateFrames);
     booleanParameters.push_back(animationSyncBPM);
     booleanParameters.push_back(invertImage);
+    booleanParameters.push_back(traceImage);
 
     floatParameters.push_back(attackTime);
     floatParameters.push_back(attackLevel);
@@ -173,6 +177,14 @@ OscirenderAudioProcessor::OscirenderAudioProcessor() : CommonAudioProcessor(Buse
         synth.addVoice(new ShapeVoice(*this));
     }
 
+    synth.setParallelRendering(voiceThreadPool, [](juce::SynthesiserVoice* voice) {
+        return dynamic_cast<ShapeVoice*>(voice)->isRenderingLuaSamples();
+    });
+
+    luaDiagnostics.onError = [this](int lineNumber, juce::String id, juce::String error) {
+        notifyErrorListeners(lineNumber, id, error);
+    };
+
     intParameters.push_back(voices);
 
     voices->addListener(this);
@@ -187,6 +199,12 @@ OscirenderAudioProcessor::OscirenderAudioProcessor() : CommonAudioProcessor(Buse
 }
 
 OscirenderAudioProcessor::~OscirenderAudioProcessor() {
+    // parsing jobs use the processor, so must finish before anything is
+    // destroyed. They stop early once cancelled, so this doesn't wait long.
+    for (auto& parser : parsers) {
+        parser->cancelParse();
+    }
+    fileParsingPool.removeAllJobs(true, -1);
     for (int i = luaEffects.size() - 1; i >= 0; i--) {
         luaEffects[i]->parameters[0]->removeListener(this);
     }
@@ -203,6 +221,7 @@ void OscirenderAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBl
 
     volumeBuffer = std::vector<double>(VOLUME_BUFFER_SECONDS * sampleRate, 0);
     synth.setCurrentPlaybackSampleRate(sampleRate);
+    synth.prepareParallelRendering(NUM_SYNTH_CHANNELS, voices->max, samplesPerBlock);
     retriggerMidi = true;
 }
 
@@ -263,9 +282,20 @@ void OscirenderAudioProcessor::addFile(juce::File file) {
     fileBlocks.push_back(std::make_shared<juce::MemoryBlock>());
     fileNames.push_back(file.getFileName());
     fileIds.push_back(currentFileId++);
+    objSettings.push_back(ObjSettings());
 	parsers.push_back(std::make_shared<FileParser>(*this, errorCallback));
     sounds.push_back(new ShapeSound(*this, parsers.back()));
-    file.createInputStream()->readIntoMemoryBlock(*fileBlocks.back());
+    if (VideoStream::isVideoFile(file.getFileName())) {
+        // videos are streamed from disk, so only their path is kept
+        juce::String path = file.getFullPathName();
+        fileBlocks.back()->append(path.toRawUTF8(), path.getNumBytesAsUTF8());
+    } else if (file.isDirectory()) {
+        // folders of SVGs are played as a sequence, from a zip of the SVGs
+        fileNames.back() += ".zip";
+        SvgSequenceParser::zipFolder(file, *fileBlocks.back());
+    } else {
+        file.createInputStream()->readIntoMemoryBlock(*fileBlocks.back());
+    }
 
     openFile(fileBlocks.size() - 1);
 }
@@ -275,6 +305,7 @@ void OscirenderAudioProcessor::addFile(juce::String fileName, const char* data,
     fileBlocks.push_back(std::make_shared<juce::MemoryBlock>());
     fileNames.push_back(fileName);
     fileIds.push_back(currentFileId++);
+    objSettings.push_back(ObjSettings());
     parsers.push_back(std::make_shared<FileParser>(*this, errorCallback));
     sounds.push_back(new ShapeSound(*this, parsers.back()));
     fileBlocks.back()->append(data, size);
@@ -283,10 +314,11 @@ void OscirenderAudioProcessor::addFile(juce::String fileName, const char* data,
 }
 
 // parsersLock AND effectsLock must be locked before calling this function
-void OscirenderAudioProcessor::addFile(juce::String fileName, std::shared_ptr<juce::MemoryBlock> data) {
+void OscirenderAudioProcessor::addFile(juce::String fileName, std::shared_ptr<juce::MemoryBlock> data, ObjSettings settings) {
     fileBlocks.push_back(data);
     fileNames.push_back(fileName);
     fileIds.push_back(currentFileId++);
+    objSettings.push_back(settings);
     parsers.push_back(std::make_shared<FileParser>(*this, errorCallback));
     sounds.push_back(new ShapeSound(*this, parsers.back()));
 
@@ -301,6 +333,7 @@ void OscirenderAudioProcessor::removeFile(int index) {
     fileBlocks.erase(fileBlocks.begin() + index);
     fileNames.erase(fileNames.begin() + index);
     fileIds.erase(fileIds.begin() + index);
+    objSettings.erase(objSettings.begin() + index);
     parsers.erase(parsers.begin() + index);
     sounds.erase(sounds.begin() + index);
     auto newFileIndex = index;
@@ -316,12 +349,15 @@ int OscirenderAudioProcessor::numFiles() {
 
 // used for opening NEW files. Should be the default way of opening files as
 // it will reparse any existing files, so it is safer.
+// The file is parsed in the background, and the previous contents of the
+// file keep playing until it has finished, at which point
+// fileChangeBroadcaster is notified.
 // parsersLock AND effectsLock must be locked before calling this function
 void OscirenderAudioProcessor::openFile(int index) {
 	if (index < 0 || index >= fileBlocks.size()) {
 		return;
 	}
-    parsers[index]->parse(juce::String(fileIds[index]), fileNames[index].fromLastOccurrenceOf(".", true, false), std::make_unique<juce::MemoryInputStream>(*fileBlocks[index], false), font);
+    parsers[index]->parseAsync(juce::String(fileIds[index]), fileNames[index].fromLastOccurrenceOf(".", true, false), fileBlocks[index], font, objSettings[index]);
     changeCurrentFile(index);
 }
 
@@ -478,7 +514,7 @@ void OscirenderAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, ju
         inputBuffer.copyFrom(channel, 0, buffer, channel, 0, buffer.getNumSamples());
     }
 
-    juce::AudioBuffer<float> outputBuffer3d = juce::AudioBuffer<float>(3, buffer.getNumSamples());
+    juce::AudioBuffer<float> outputBuffer3d = juce::AudioBuffer<float>(NUM_SYNTH_CHANNELS, buffer.getNumSamples());
     outputBuffer3d.clear();
 
     if (usingInput && totalNumInputChannels >= 2) {
@@ -525,9 +561,12 @@ void OscirenderAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, ju
             if (currentFile >= 0 && sounds[currentFile]->parser->isAnimatable) {
                 int animFrame = (int)(animationTime * animationRate->getValueUnnormalised() + animationOffset->getValueUnnormalised());
                 auto lineArt = sounds[currentFile]->parser->getLineArt();
+                auto svgSequence = sounds[currentFile]->parser->getSvgSequence();
                 auto img = sounds[currentFile]->parser->getImg();
                 if (lineArt != nullptr) {
                     lineArt->setFrame(animFrame);
+                } else if (svgSequence != nullptr) {
+                    svgSequence->setFrame(animFrame);
                 } else if (img != nullptr) {
                     img->setFrame(animFrame);
                 }
@@ -664,6 +703,12 @@ void OscirenderAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
     for (int i = 0; i < fileBlocks.size(); i++) {
         auto fileXml = filesXml->createNewChildElement("file");
         fileXml->setAttribute("name", fileNames[i]);
+        fileXml->setAttribute("objSolver", (int) objSettings[i].solver);
+        fileXml->setAttribute("objTimeBudget", objSettings[i].timeBudget);
+        fileXml->setAttribute("objFeatureEdges", objSettings[i].featureEdges);
+        fileXml->setAttribute("objCreaseAngle", objSettings[i].creaseAngle);
+        fileXml->setAttribute("objSimplify", objSettings[i].simplify);
+        fileXml->setAttribute("objTargetEdges", objSettings[i].targetEdges);
         auto base64 = fileBlocks[i]->toBase64Encoding();
         fileXml->addTextElement(base64);
     }
@@ -781,7 +826,15 @@ void OscirenderAudioProcessor::setStateInformation(const void* data, int sizeInB
                     fileBlock->fromBase64Encoding(text);
                 }
                 
-                addFile(fileName, fileBlock);
+                ObjSettings settings;
+                settings.solver = (ObjSettings::Solver) juce::jlimit(0, 2, fileXml->getIntAttribute("objSolver", (int) settings.solver));
+                settings.timeBudget = fileXml->getDoubleAttribute("objTimeBudget", settings.timeBudget);
+                settings.featureEdges = fileXml->getBoolAttribute("objFeatureEdges", settings.featureEdges);
+                settings.creaseAngle = juce::jlimit(0.0, 180.0, fileXml->getDoubleAttribute("objCreaseAngle", settings.creaseAngle));
+                settings.simplify = fileXml->getBoolAttribute("objSimplify", settings.simplify);
+                settings.targetEdges = juce::jmax(1, fileXml->getIntAttribute("objTargetEdges", settings.targetEdges));
+                
+                addFile(fileName, fileBlock, settings);
             }
         }
         changeCurrentFile(xml->getIntAttribute("currentFile", -1));
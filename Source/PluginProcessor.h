@@ -14,6 +14,7 @@
 #include "shape/Shape.h"
 #include "concurrency/AudioBackgroundThread.h"
 #include "concurrency/AudioBackgroundThreadManager.h"
+#include "concurrency/ParallelFor.h"
 #include "audio/Effect.h"
 #include "audio/ShapeSound.h"
 #include "audio/ShapeVoice.h"
@@ -24,9 +25,12 @@
 #include "audio/WobbleEffect.h"
 #include "audio/PerspectiveEffect.h"
 #include "obj/ObjectServer.h"
+#include "obj/WorldObject.h"
 #include "UGen/Env.h"
 #include "UGen/ugen_JuceEnvelopeComponent.h"
 #include "audio/CustomEffect.h"
+#include "lua/LuaDiagnostics.h"
+#include "parser/ParseCache.h"
 #include "audio/DashedLineEffect.h"
 #include "CommonPluginProcessor.h"
 
@@ -55,6 +59,10 @@ public:
     void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override;
     void envelopeChanged(EnvelopeComponent* changedEnvelope) override;
 
+    // shared by every instance, and declared first so that it is destroyed
+    // after everything that might use it
+    juce::SharedResourcePointer<ParallelForPool> parallelForPool;
+
 	std::vector<std::shared_ptr<Effect>> toggleableEffects;
     std::vector<std::shared_ptr<Effect>> luaEffects;
     std::atomic<double> luaValues[26] = { 0.0 };
@@ -92,8 +100,11 @@ public:
 
     std::shared_ptr<DashedLineEffect> dashedLineEffect = std::make_shared<DashedLineEffect>();
 
-    std::function<void(int, juce::String, juce::String)> errorCallback = [this](int lineNum, juce::String fileName, juce::String error) { notifyErrorListeners(lineNum, fileName, error); };
-    std::shared_ptr<CustomEffect> customEffect = std::make_shared<CustomEffect>(errorCallback, luaValues);
+    // Lua errors and prints are passed to the message thread through this,
+    // as they are mostly raised on the audio thread
+    LuaDiagnostics luaDiagnostics;
+    std::function<void(int, juce::String, juce::String)> errorCallback = [this](int lineNum, juce::String fileName, juce::String error) { luaDiagnostics.reportError(lineNum, fileName, error); };
+    std::shared_ptr<CustomEffect> customEffect = std::make_shared<CustomEffect>(errorCallback, luaValues, &luaDiagnostics);
     std::shared_ptr<Effect> custom = std::make_shared<Effect>(
         customEffect,
         new EffectParameter("Lua Effect", "Controls the strength of the custom Lua effect applied. You can write your own custom effect using Lua by pressing the edit button on the right.", "customEffectStrength", VERSION_HINT, 1.0, 0.0, 1.0)
@@ -119,7 +130,10 @@ public:
     std::vector<juce::String> fileNames;
     int currentFileId = 0;
     std::vector<int> fileIds;
+    // only used by OBJ files, but every file has one to keep the indices the same
+    std::vector<ObjSettings> objSettings;
     std::atomic<int> currentFile = -1;
+    ParseCache parseCache;
 
     juce::ChangeBroadcaster broadcaster;
     std::atomic<bool> objectServerRendering = false;
@@ -153,6 +167,7 @@ public:
     FloatParameter* animationOffset = new FloatParameter("Animation Offset", "animationOffset", VERSION_HINT, 0, -10000, 10000);
 
     BooleanParameter* invertImage = new BooleanParameter("Invert Image", "invertImage", VERSION_HINT, false, "Inverts the image so that dark pixels become light, and vice versa.");
+    BooleanParameter* traceImage = new BooleanParameter("Trace Image", "traceImage", VERSION_HINT, false, "Draws the outlines in the image as lines, like an SVG, rather than visiting its pixels one at a time. The threshold sets how bright the outlined areas are.");
     std::shared_ptr<Effect> imageThreshold = std::make_shared<Effect>(
         [this](int index, OsciPoint input, const std::vector<std::atomic<double>>& values, double sampleRate) {
             return input;
@@ -181,6 +196,11 @@ public:
     juce::Font font = juce::Font(juce::Font::getDefaultSansSerifFontName(), 1.0f, juce::Font::plain);
 
     ShapeSound::Ptr objectServerSound = new ShapeSound();
+
+    // files are parsed on these threads, see FileParser::parseAsync. Jobs use
+    // the members above, so the pool is declared after them to be destroyed,
+    // and its jobs stopped, before any of them are.
+    juce::ThreadPool fileParsingPool { 2 };
     
     std::function<void()> haltRecording;
 
@@ -189,7 +209,7 @@ public:
     void updateFileBlock(int index, std::shared_ptr<juce::MemoryBlock> block);
     void addFile(juce::File file);
     void addFile(juce::String fileName, const char* data, const int size);
-    void addFile(juce::String fileName, std::shared_ptr<juce::MemoryBlock> data);
+    void addFile(juce::String fileName, std::shared_ptr<juce::MemoryBlock> data, ObjSettings settings = ObjSettings());
     void removeFile(int index);
     int numFiles();
     void changeCurrentFile(int index);
@@ -216,6 +236,8 @@ private:
     std::vector<ErrorListener*> errorListeners;
 
     ShapeSound::Ptr defaultSound = new ShapeSound(*this, std::make_shared<FileParser>(*this));
+    // used to render Lua voices concurrently
+    std::shared_ptr<AudioThreadPool> voiceThreadPool = std::make_shared<AudioThreadPool>(juce::jlimit(0, 7, juce::SystemStats::getNumCpus() - 1));
     PublicSynthesiser synth;
     bool retriggerMidi = true;
 
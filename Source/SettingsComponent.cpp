@@ -9,6 +9,7 @@ SettingsComponent::SettingsComponent(OscirenderAudioProcessor& p, OscirenderAudi
     addAndMakeVisible(mainResizerBar);
     addAndMakeVisible(midi);
     addChildComponent(txt);
+    addChildComponent(obj);
     addChildComponent(frame);
     
     double midiLayoutPreferredSize = std::any_cast<double>(audioProcessor.getProperty("midiLayoutPreferredSize", pluginEditor.CLOSED_PREF_SIZE));
@@ -50,6 +51,8 @@ void SettingsComponent::resized() {
 
     if (txt.isVisible()) {
         effectSettings = &txt;
+    } else if (obj.isVisible()) {
+        effectSettings = &obj;
     } else if (frame.isVisible()) {
         effectSettings = &frame;
     }
@@ -57,7 +60,8 @@ void SettingsComponent::resized() {
     auto dummyBounds = dummy.getBounds();
 
     if (effectSettings != nullptr) {
-        effectSettings->setBounds(dummyBounds.removeFromBottom(150));
+        // object settings have a couple more rows than the others
+        effectSettings->setBounds(dummyBounds.removeFromBottom(effectSettings == &obj ? 240 : 150));
         dummyBounds.removeFromBottom(pluginEditor.RESIZER_BAR_SIZE);
     }
 
@@ -74,15 +78,19 @@ void SettingsComponent::resized() {
 void SettingsComponent::fileUpdated(juce::String fileName) {
     juce::String extension = fileName.fromLastOccurrenceOf(".", true, false).toLowerCase();
     txt.setVisible(false);
+    obj.setVisible(false);
     frame.setVisible(false);
-    bool isImage =  extension == ".gif" || extension == ".png" || extension == ".jpg" || extension == ".jpeg";
+    bool isImage =  extension == ".gif" || extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".y4m" || extension == ".gray";
     if (fileName.isEmpty() || audioProcessor.objectServerRendering) {
         // do nothing
     } else if (extension == ".txt") {
         txt.setVisible(true);
-    } else if (extension == ".gpla" || isImage) {
+    } else if (extension == ".obj" || extension == ".ply" || extension == ".stl") {
+        obj.setVisible(true);
+        obj.update();
+    } else if (extension == ".gpla" || extension == ".zip" || isImage) {
         frame.setVisible(true);
-        frame.setAnimated(extension == ".gpla" || extension == ".gif");
+        frame.setAnimated(extension == ".gpla" || extension == ".zip" || extension == ".gif" || extension == ".y4m" || extension == ".gray");
         frame.setImage(isImage);
         frame.resized();
     }
@@ -92,6 +100,7 @@ void SettingsComponent::fileUpdated(juce::String fileName) {
 
 void SettingsComponent::update() {
     txt.update();
+    obj.update();
     frame.update();
 }
 
@@ -7,6 +7,7 @@
 #include "LuaComponent.h"
 #include "PerspectiveComponent.h"
 #include "TxtComponent.h"
+#include "ObjComponent.h"
 #include "EffectsComponent.h"
 #include "MidiComponent.h"
 
@@ -28,6 +29,7 @@ private:
 	MainComponent main{audioProcessor, pluginEditor};
 	PerspectiveComponent perspective{audioProcessor, pluginEditor};
 	TxtComponent txt{audioProcessor, pluginEditor};
+	ObjComponent obj{audioProcessor, pluginEditor};
 	FrameSettingsComponent frame{ audioProcessor, pluginEditor };
 	EffectsComponent effects{audioProcessor, pluginEditor};
 	MidiComponent midi{audioProcessor, pluginEditor};
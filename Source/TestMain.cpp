@@ -2,6 +2,10 @@
 #include "obj/Camera.h"
 #include "mathter/Common/Approx.hpp"
 #include "concurrency/BufferConsumer.h"
+#include "concurrency/ParallelFor.h"
+#include "img/VideoStream.h"
+#include "gpla/LineArtParser.h"
+#include "lua/LuaExpression.h"
 
 class FrustumTest : public juce::UnitTest {
 public:
@@ -184,10 +188,587 @@ public:
     }
 };
 
+class VideoStreamTest : public juce::UnitTest {
+public:
+    VideoStreamTest() : juce::UnitTest("Video Stream") {}
+
+    void runTest() override {
+        juce::TemporaryFile file(".y4m");
+        writeVideo(file.getFile(), 5, 3, 20);
+        VideoStream video(file.getFile());
+
+        beginTest("Y4M header");
+
+        expectEquals(video.getNumFrames(), 20);
+        expectEquals(video.getWidth(), 5);
+        expectEquals(video.getHeight(), 3);
+        expect(!video.isLive());
+
+        beginTest("Frames in order");
+
+        for (int i = 0; i < 20; i++) {
+            expectFrame(video, i);
+        }
+
+        beginTest("Frames out of order");
+
+        int frames[] = { 19, 0, 7, 6, 5, 12, 3 };
+        for (int i : frames) {
+            expectFrame(video, i);
+        }
+    }
+
+private:
+    // each frame is a single shade, which is 10 times the frame number
+    void writeVideo(juce::File file, int width, int height, int numFrames) {
+        juce::FileOutputStream stream(file);
+        stream.writeText("YUV4MPEG2 W" + juce::String(width) + " H" + juce::String(height) + " F25:1 Ip A1:1 C420jpeg\n", false, false, nullptr);
+        for (int i = 0; i < numFrames; i++) {
+            stream.writeText("FRAME\n", false, false, nullptr);
+            stream.writeRepeatedByte(i * 10, width * height);
+            stream.writeRepeatedByte(128, 2 * ((width + 1) / 2) * ((height + 1) / 2));
+        }
+    }
+
+    void expectFrame(VideoStream& video, int index) {
+        const uint8_t* pixels = nullptr;
+        for (int i = 0; i < 1000 && pixels == nullptr; i++) {
+            pixels = video.getFrame(index);
+            if (pixels == nullptr) {
+                juce::Thread::sleep(1);
+            }
+        }
+        expect(pixels != nullptr, "Frame " + juce::String(index) + " was never decoded");
+        if (pixels != nullptr) {
+            // 0 is reserved for transparent pixels
+            int expected = juce::jmax(1, index * 10);
+            expectEquals((int) pixels[0], expected);
+            expectEquals((int) pixels[14], expected);
+        }
+    }
+};
+
+class LineArtTest : public juce::UnitTest {
+public:
+    LineArtTest() : juce::UnitTest("Line Art") {}
+
+    void runTest() override {
+        juce::String json(BinaryData::fallback_gpla, BinaryData::fallback_gplaSize);
+        std::vector<std::vector<Line>> expected = LineArtParser::parseJsonFrames(json);
+        juce::MemoryBlock binary = writeBinary(juce::JSON::parse(json));
+
+        beginTest("Binary frames match JSON");
+
+        expectFrames(LineArtParser::parseBinaryFrames((char*) binary.getData(), (int) binary.getSize()), expected);
+
+        beginTest("Binary frames decoded on demand");
+
+        expectFrames(drawFrames(binary), expected);
+
+        // The fallback only has one frame, so it is made into an animation
+        // whose frames reuse the matrix and strokes of earlier frames
+        std::vector<Frame> animation = makeAnimation(readFrames(juce::JSON::parse(json))[0]);
+
+        for (bool quantised : { false, true }) {
+            for (bool zlib : { false, true }) {
+                beginTest(juce::String("Compact frames match JSON, ") + (quantised ? "quantised" : "float") + (zlib ? ", zlib" : ""));
+
+                // the frames are rounded to what the compact file stores
+                std::vector<Frame> rounded = animation;
+                int reused = 0;
+                juce::MemoryBlock compact = writeCompact(rounded, quantised, zlib, reused);
+                expectEquals(reused, 6);
+                std::vector<std::vector<Line>> roundedExpected = LineArtParser::parseJsonFrames(writeJson(rounded));
+
+                expectFrames(LineArtParser::parseBinaryFrames((char*) compact.getData(), (int) compact.getSize()), roundedExpected);
+                expectFrames(drawFrames(compact), roundedExpected);
+            }
+        }
+
+        beginTest("Broken compact files fall back");
+
+        std::vector<Frame> rounded = animation;
+        int reused = 0;
+        juce::MemoryBlock compact = writeCompact(rounded, true, true, reused);
+        std::vector<std::vector<Line>> roundedExpected = LineArtParser::parseJsonFrames(writeJson(rounded));
+
+        // files that are cut short, or have a frame outside the file, are
+        // replaced by the fallback
+        juce::MemoryBlock truncated(compact.getData(), compact.getSize() / 2);
+        expectFrames(LineArtParser::parseBinaryFrames((char*) truncated.getData(), (int) truncated.getSize()), expected);
+        expectFrames(drawFrames(truncated), expected);
+
+        juce::MemoryBlock outOfRange = compact;
+        juce::uint64 offset = compact.getSize() * 2;
+        outOfRange.copyFrom(&offset, 44 + 8 * 2, sizeof(offset));
+        expectFrames(LineArtParser::parseBinaryFrames((char*) outOfRange.getData(), (int) outOfRange.getSize()), expected);
+        expectFrames(drawFrames(outOfRange), expected);
+
+        // frames that are broken, or reuse parts of a broken frame, are empty
+        juce::MemoryBlock badSize = compact;
+        juce::uint32 contentsSize;
+        badSize.copyTo(&contentsSize, (int) compactOffset(compact, 0), sizeof(contentsSize));
+        contentsSize++;
+        badSize.copyFrom(&contentsSize, (int) compactOffset(compact, 0), sizeof(contentsSize));
+        // frame 3 only reuses the matrix of frame 2, which is stored in frame 2
+        std::vector<std::vector<Line>> onlyFrame3(roundedExpected.size());
+        onlyFrame3[3] = roundedExpected[3];
+        expectFrames(LineArtParser::parseBinaryFrames((char*) badSize.getData(), (int) badSize.getSize()), onlyFrame3);
+        expectFrames(drawFrames(badSize), onlyFrame3);
+
+        // reused parts have to come from an earlier frame that stores them
+        rounded = animation;
+        juce::MemoryBlock laterReferences = writeCompact(rounded, false, false, reused, true);
+        std::vector<std::vector<Line>> onlyFrame0(roundedExpected.size());
+        onlyFrame0[0] = LineArtParser::parseJsonFrames(writeJson(rounded))[0];
+        expectFrames(LineArtParser::parseBinaryFrames((char*) laterReferences.getData(), (int) laterReferences.getSize()), onlyFrame0);
+        expectFrames(drawFrames(laterReferences), onlyFrame0);
+    }
+
+private:
+    struct Object {
+        std::vector<double> matrix;
+        std::vector<std::vector<OsciPoint>> strokes;
+    };
+
+    struct Frame {
+        double focalLength = 0;
+        std::vector<Object> objects;
+    };
+
+    std::vector<Frame> readFrames(const juce::var& json) {
+        std::vector<Frame> frames;
+        for (auto& jsonFrame : *json["frames"].getArray()) {
+            Frame& frame = frames.emplace_back();
+            frame.focalLength = jsonFrame["focalLength"];
+            for (auto& jsonObject : *jsonFrame["objects"].getArray()) {
+                Object& object = frame.objects.emplace_back();
+                for (auto& value : *jsonObject["matrix"].getArray()) {
+                    object.matrix.push_back(value);
+                }
+                for (auto& jsonStroke : *jsonObject["vertices"].getArray()) {
+                    auto& stroke = object.strokes.emplace_back();
+                    for (auto& vertex : *jsonStroke.getArray()) {
+                        stroke.emplace_back((double) vertex["x"], (double) vertex["y"], (double) vertex["z"]);
+                    }
+                }
+            }
+        }
+        return frames;
+    }
+
+    // Frame 1 is the same as frame 0, frame 2 moves the object, frame 3
+    // shrinks its strokes, and frame 4 is the same as frame 0 again, so
+    // between them they reuse 6 matrices and strokes
+    std::vector<Frame> makeAnimation(const Frame& frame) {
+        std::vector<Frame> frames(5, frame);
+        for (int i : { 2, 3 }) {
+            for (auto& object : frames[i].objects) {
+                object.matrix[3] += 0.25;
+                object.matrix[7] -= 0.125;
+            }
+        }
+        for (auto& object : frames[3].objects) {
+            for (auto& stroke : object.strokes) {
+                for (auto& vertex : stroke) {
+                    vertex.scale(0.5, 0.5, 0.5);
+                }
+            }
+        }
+        return frames;
+    }
+
+    static bool samePoints(const std::vector<std::vector<OsciPoint>>& a, const std::vector<std::vector<OsciPoint>>& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (int i = 0; i < a.size(); i++) {
+            if (a[i].size() != b[i].size()) {
+                return false;
+            }
+            for (int j = 0; j < a[i].size(); j++) {
+                if (a[i][j].x != b[i][j].x || a[i][j].y != b[i][j].y || a[i][j].z != b[i][j].z) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    static void writeVarint(juce::MemoryOutputStream& stream, juce::uint64 value) {
+        while (value >= 0x80) {
+            stream.writeByte((char) ((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        stream.writeByte((char) value);
+    }
+
+    // Writes the frames in the compact format, reusing matrices and strokes
+    // that are the same as in an earlier frame, and rounds the frames to the
+    // values that are stored. If laterReferences is true, reused parts
+    // refer to frames after the end of the file instead.
+    juce::MemoryBlock writeCompact(std::vector<Frame>& frames, bool quantised, bool zlib, int& reused, bool laterReferences = false) {
+        const std::vector<Frame> original = frames;
+        // whether each object's matrix and strokes are stored in each frame
+        std::vector<std::vector<bool>> storesMatrix(frames.size()), storesStrokes(frames.size());
+        auto findStored = [&](int f, int i, const std::vector<std::vector<bool>>& stores, std::function<bool(const Object&, const Object&)> same) {
+            for (int earlier = 0; earlier < f; earlier++) {
+                if (i < original[earlier].objects.size() && stores[earlier][i] && same(original[earlier].objects[i], original[f].objects[i])) {
+                    return earlier;
+                }
+            }
+            return -1;
+        };
+        reused = 0;
+
+        std::vector<juce::MemoryBlock> chunks;
+        for (int f = 0; f < frames.size(); f++) {
+            juce::MemoryOutputStream contents;
+            frames[f].focalLength = (float) frames[f].focalLength;
+            contents.writeFloat((float) frames[f].focalLength);
+            writeVarint(contents, frames[f].objects.size());
+
+            for (int i = 0; i < frames[f].objects.size(); i++) {
+                Object& object = frames[f].objects[i];
+                int matrixFrame = findStored(f, i, storesMatrix, [](const Object& a, const Object& b) { return a.matrix == b.matrix; });
+                int strokesFrame = findStored(f, i, storesStrokes, [](const Object& a, const Object& b) { return samePoints(a.strokes, b.strokes); });
+                storesMatrix[f].push_back(matrixFrame < 0);
+                storesStrokes[f].push_back(strokesFrame < 0);
+                reused += (matrixFrame >= 0) + (strokesFrame >= 0);
+                juce::uint64 reference = laterReferences ? frames.size() : 0;
+                contents.writeByte((char) ((matrixFrame >= 0 ? 1 : 0) | (strokesFrame >= 0 ? 2 : 0)));
+
+                if (matrixFrame >= 0) {
+                    writeVarint(contents, reference + matrixFrame);
+                    object.matrix = frames[matrixFrame].objects[i].matrix;
+                } else {
+                    for (int k = 0; k < 12; k++) {
+                        object.matrix[k] = (float) object.matrix[k];
+                        contents.writeFloat((float) object.matrix[k]);
+                    }
+                }
+
+                if (strokesFrame >= 0) {
+                    writeVarint(contents, reference + strokesFrame);
+                    object.strokes = frames[strokesFrame].objects[i].strokes;
+                } else {
+                    writeStrokes(contents, object.strokes, quantised);
+                }
+            }
+
+            juce::MemoryOutputStream chunk;
+            chunk.writeInt((int) contents.getDataSize());
+            if (zlib) {
+                chunk.writeByte(1);
+                juce::GZIPCompressorOutputStream compressor(chunk);
+                compressor.write(contents.getData(), contents.getDataSize());
+                compressor.flush();
+            } else {
+                chunk.writeByte(0);
+                chunk.write(contents.getData(), contents.getDataSize());
+            }
+            chunks.push_back(chunk.getMemoryBlock());
+        }
+
+        juce::MemoryOutputStream stream;
+        stream.write("GPLA    ", 8);
+        // major, minor and patch versions
+        stream.writeInt64(3);
+        stream.writeInt64(0);
+        stream.writeInt64(0);
+        stream.writeInt(quantised ? 1 : 0);
+        stream.writeInt((int) frames.size());
+        stream.writeInt(24);
+        juce::uint64 offset = 44 + 8 * (frames.size() + 1);
+        for (auto& chunk : chunks) {
+            stream.writeInt64((juce::int64) offset);
+            offset += chunk.getSize();
+        }
+        stream.writeInt64((juce::int64) offset);
+        for (auto& chunk : chunks) {
+            stream.write(chunk.getData(), chunk.getSize());
+        }
+        return stream.getMemoryBlock();
+    }
+
+    void writeStrokes(juce::MemoryOutputStream& stream, std::vector<std::vector<OsciPoint>>& strokes, bool quantised) {
+        float origin[3] = {};
+        float step[3] = {};
+        if (quantised) {
+            double min[3] = { INFINITY, INFINITY, INFINITY };
+            double max[3] = { -INFINITY, -INFINITY, -INFINITY };
+            for (auto& stroke : strokes) {
+                for (auto& vertex : stroke) {
+                    double values[3] = { vertex.x, vertex.y, vertex.z };
+                    for (int k = 0; k < 3; k++) {
+                        min[k] = std::min(min[k], values[k]);
+                        max[k] = std::max(max[k], values[k]);
+                    }
+                }
+            }
+            for (int k = 0; k < 3; k++) {
+                origin[k] = std::isfinite(min[k]) ? (float) min[k] : 0.0f;
+                step[k] = max[k] > min[k] ? (float) ((max[k] - min[k]) / 65535) : 1.0f;
+            }
+            for (float value : origin) {
+                stream.writeFloat(value);
+            }
+            for (float value : step) {
+                stream.writeFloat(value);
+            }
+        }
+
+        writeVarint(stream, strokes.size());
+        juce::int64 steps[3] = {};
+        for (auto& stroke : strokes) {
+            writeVarint(stream, stroke.size());
+            for (auto& vertex : stroke) {
+                double* values[3] = { &vertex.x, &vertex.y, &vertex.z };
+                for (int k = 0; k < 3; k++) {
+                    if (quantised) {
+                        juce::int64 quantisedValue = juce::jlimit<juce::int64>(0, 65535, std::llround((*values[k] - origin[k]) / step[k]));
+                        juce::int64 difference = quantisedValue - steps[k];
+                        steps[k] = quantisedValue;
+                        // zigzag encoded, so that small negative numbers are short too
+                        writeVarint(stream, ((juce::uint64) difference << 1) ^ (juce::uint64) (difference >> 63));
+                        // the same sum as the parser does
+                        *values[k] = origin[k] + steps[k] * (double) step[k];
+                    } else {
+                        *values[k] = (float) *values[k];
+                        stream.writeFloat((float) *values[k]);
+                    }
+                }
+            }
+        }
+    }
+
+    // the offset of a frame in a compact file, from its offset table
+    juce::uint64 compactOffset(const juce::MemoryBlock& compact, int frame) {
+        juce::uint64 offset;
+        compact.copyTo(&offset, 44 + 8 * frame, sizeof(offset));
+        return offset;
+    }
+
+    juce::String writeJson(const std::vector<Frame>& frames) {
+        // enough decimal places that the values are read back exactly
+        auto number = [](double value) {
+            return juce::String(value, 20);
+        };
+
+        juce::String json = "{\"frames\": [";
+        for (int f = 0; f < frames.size(); f++) {
+            json += juce::String(f > 0 ? ", " : "") + "{\"focalLength\": " + number(frames[f].focalLength) + ", \"objects\": [";
+            for (int i = 0; i < frames[f].objects.size(); i++) {
+                auto& object = frames[f].objects[i];
+                json += juce::String(i > 0 ? ", " : "") + "{\"matrix\": [";
+                for (int k = 0; k < object.matrix.size(); k++) {
+                    json += juce::String(k > 0 ? ", " : "") + number(object.matrix[k]);
+                }
+                json += "], \"vertices\": [";
+                for (int s = 0; s < object.strokes.size(); s++) {
+                    json += juce::String(s > 0 ? ", " : "") + "[";
+                    for (int v = 0; v < object.strokes[s].size(); v++) {
+                        auto& vertex = object.strokes[s][v];
+                        json += juce::String(v > 0 ? ", " : "") + "{\"x\": " + number(vertex.x) + ", \"y\": " + number(vertex.y) + ", \"z\": " + number(vertex.z) + "}";
+                    }
+                    json += "]";
+                }
+                json += "]}";
+            }
+            json += "]}";
+        }
+        return json + "]}";
+    }
+
+    // decodes every frame of the file the way they are when played
+    std::vector<std::vector<Line>> drawFrames(const juce::MemoryBlock& data) {
+        LineArtParser parser(std::make_shared<juce::MemoryBlock>(data));
+        std::vector<std::vector<Line>> frames(parser.getNumFrames());
+        for (int i = 0; i < frames.size(); i++) {
+            parser.setFrame(i);
+            for (auto& shape : parser.draw()) {
+                frames[i].push_back(*dynamic_cast<Line*>(shape.get()));
+            }
+        }
+        return frames;
+    }
+
+    void expectFrames(const std::vector<std::vector<Line>>& actual, const std::vector<std::vector<Line>>& expected) {
+        expectEquals((int) actual.size(), (int) expected.size());
+        for (int i = 0; i < actual.size() && i < expected.size(); i++) {
+            expectLines(actual[i], expected[i]);
+        }
+    }
+
+    // writes the frames of a JSON file in the binary format that Blender exports
+    juce::MemoryBlock writeBinary(const juce::var& json) {
+        juce::MemoryOutputStream stream;
+        auto writeTag = [&](const char* tag) {
+            stream.write(tag, 8);
+        };
+
+        auto& frames = *json["frames"].getArray();
+        writeTag("GPLA    ");
+        // major, minor and patch versions
+        stream.writeInt64(1);
+        stream.writeInt64(0);
+        stream.writeInt64(0);
+        writeTag("FILE    ");
+        writeTag("fCount  ");
+        stream.writeInt64(frames.size());
+        writeTag("fRate   ");
+        stream.writeInt64(24);
+        writeTag("DONE    ");
+
+        for (auto& frame : frames) {
+            writeTag("FRAME   ");
+            writeTag("focalLen");
+            stream.writeDouble(frame["focalLength"]);
+            writeTag("OBJECTS ");
+            for (auto& object : *frame["objects"].getArray()) {
+                writeTag("OBJECT  ");
+                writeTag("MATRIX  ");
+                for (auto& value : *object["matrix"].getArray()) {
+                    stream.writeDouble(value);
+                }
+                writeTag("DONE    ");
+                writeTag("STROKES ");
+                for (auto& stroke : *object["vertices"].getArray()) {
+                    writeTag("STROKE  ");
+                    writeTag("vertexCt");
+                    stream.writeInt64(stroke.size());
+                    writeTag("VERTICES");
+                    for (auto& vertex : *stroke.getArray()) {
+                        stream.writeDouble(vertex["x"]);
+                        stream.writeDouble(vertex["y"]);
+                        stream.writeDouble(vertex["z"]);
+                    }
+                    writeTag("DONE    ");
+                    writeTag("DONE    ");
+                }
+                writeTag("DONE    ");
+                writeTag("DONE    ");
+            }
+            writeTag("DONE    ");
+            writeTag("DONE    ");
+        }
+        writeTag("END GPLA");
+        return stream.getMemoryBlock();
+    }
+
+    void expectLines(const std::vector<Line>& actual, const std::vector<Line>& expected) {
+        expectEquals((int) actual.size(), (int) expected.size());
+        for (int i = 0; i < actual.size() && i < expected.size(); i++) {
+            expectWithinAbsoluteError(actual[i].x1, expected[i].x1, 1e-9);
+            expectWithinAbsoluteError(actual[i].y1, expected[i].y1, 1e-9);
+            expectWithinAbsoluteError(actual[i].z1, expected[i].z1, 1e-9);
+            expectWithinAbsoluteError(actual[i].x2, expected[i].x2, 1e-9);
+            expectWithinAbsoluteError(actual[i].y2, expected[i].y2, 1e-9);
+            expectWithinAbsoluteError(actual[i].z2, expected[i].z2, 1e-9);
+        }
+    }
+};
+
+class LuaExpressionTest : public juce::UnitTest {
+public:
+    LuaExpressionTest() : juce::UnitTest("Lua Expressions") {}
+
+    void runTest() override {
+        beginTest("Precedence");
+
+        expectSameAsLua("return { 1 + 2 * 3 - 4 / 5, 2 ^ 3 ^ 2, -2 ^ 2 }");
+        expectSameAsLua("return { x + y * z, (x + y) * z - -y, -x ^ 2 }");
+        expectSameAsLua("return { 2 * x ^ 2 / 3 % 5, x - y - z, x / y / z }");
+
+        beginTest("Floor division");
+
+        expectSameAsLua("return { 7 // 2, -7 // 2, 7.5 // -2 }");
+        expectSameAsLua("return { x // y, -x // 0.3, z // -y }");
+
+        beginTest("Modulo");
+
+        expectSameAsLua("return { -7 % 3, 7 % -3, 5.5 % 2 }");
+        expectSameAsLua("return { x % y, -x % 0.7, x % -0.7 }");
+
+        beginTest("Math library");
+
+        expectSameAsLua("return { math.sin(x), math.cos(y), math.tan(z) }");
+        expectSameAsLua("return { math.asin(slider_a), math.acos(-slider_b), math.atan(x) }");
+        expectSameAsLua("return { math.atan(y, x), math.sqrt(slider_c), math.abs(x) }");
+        expectSameAsLua("return { math.floor(x), math.ceil(y), math.exp(z) }");
+        expectSameAsLua("return { math.log(slider_c + 1), math.log(slider_c + 1, 2), math.min(x, y, z) }");
+        expectSameAsLua("return { math.max(x, y, z), math.fmod(x, y), math.fmod(-x, 0.7) }");
+        expectSameAsLua("return { math.pi * x, math.min(x, 1), math.max(-1, y) }");
+
+        beginTest("Waves");
+
+        expectSameAsLua("return { osci_square_wave(phase), osci_saw_wave(phase), osci_triangle_wave(phase) }");
+        expectSameAsLua("return { osci_square_wave(-phase), osci_saw_wave(-phase), osci_triangle_wave(-phase) }");
+        expectSameAsLua("return { osci_square_wave(x * 10), osci_saw_wave(step), osci_triangle_wave(frequency / sample_rate) }");
+
+        beginTest("Locals");
+
+        expectSameAsLua("local r = math.sqrt(x * x + y * y)\nlocal s = r * slider_a\nreturn { x * (1 + s), y - s, z }");
+        expectSameAsLua("local t = phase * 2\nreturn { math.sin(t), math.cos(t) }");
+    }
+
+private:
+    // The same script is run through Lua by starting it with control flow,
+    // which LuaExpression doesn't compile
+    void expectSameAsLua(const juce::String& script) {
+        std::unique_ptr<LuaExpression> expression = LuaExpression::compile(script);
+        expect(expression != nullptr, "Could not compile " + script);
+        if (expression == nullptr) {
+            return;
+        }
+
+        LuaParser parser("test", "if false then end\n" + script, [this](int line, juce::String fileName, juce::String error) {
+            expect(line == -1, error);
+        });
+        lua_State* L = nullptr;
+
+        for (double x : { -1.5, 0.25, 3.0 }) {
+            for (double phase : { 0.0, 2.0, 7.5, -4.0 }) {
+                LuaVariables vars;
+                vars.isEffect = true;
+                vars.x = x;
+                vars.y = 0.75 - x;
+                vars.z = 1.25;
+                vars.phase = phase;
+                vars.step = phase * 100;
+                vars.sampleRate = 48000;
+                vars.frequency = 440;
+                vars.sliders[0] = 0.3;
+                vars.sliders[1] = 0.9;
+                vars.sliders[2] = 2.5;
+
+                // run moves phase and step on to the next sample
+                LuaVariables luaVars = vars;
+                float expected[LuaParser::MAX_VALUES];
+                int numExpected = parser.run(L, luaVars, expected);
+                float actual[LuaParser::MAX_VALUES];
+                int numActual = expression->evaluate(vars, actual, LuaParser::MAX_VALUES);
+
+                expectEquals(numActual, numExpected, script);
+                for (int i = 0; i < numActual && i < numExpected; i++) {
+                    expectWithinAbsoluteError(actual[i], expected[i], 1e-6f * std::max(1.0f, std::abs(expected[i])), script);
+                }
+            }
+        }
+
+        LuaParser::close(L);
+    }
+};
+
 static FrustumTest frustumTest;
 static BufferConsumerTest bufferConsumerTest;
+static VideoStreamTest videoStreamTest;
+static LineArtTest lineArtTest;
+static LuaExpressionTest luaExpressionTest;
 
 int main(int argc, char* argv[]) {
+    // held for the whole run so that the tests use parallelFor's threads
+    juce::SharedResourcePointer<ParallelForPool> parallelForPool;
     juce::UnitTestRunner runner;
     runner.setAssertOnFailure(false);
     
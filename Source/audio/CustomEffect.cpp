@@ -5,7 +5,7 @@
 const juce::String CustomEffect::UNIQUE_ID = "6a3580b0-c5fc-4b28-a33e-e26a487f052f";
 const juce::String CustomEffect::FILE_NAME = "Custom Lua Effect";
 
-CustomEffect::CustomEffect(std::function<void(int, juce::String, juce::String)> errorCallback, std::atomic<double>* luaValues) : errorCallback(errorCallback), luaValues(luaValues) {
+CustomEffect::CustomEffect(std::function<void(int, juce::String, juce::String)> errorCallback, std::atomic<double>* luaValues, LuaDiagnostics* diagnostics) : errorCallback(errorCallback), diagnostics(diagnostics), luaValues(luaValues) {
 	vars.isEffect = true;
 }
 
@@ -32,11 +32,12 @@ OsciPoint CustomEffect::apply(int index, OsciPoint input, const std::vector<std:
 
 			std::copy(luaValues, luaValues + 26, std::begin(vars.sliders));
 
-			auto result = parser->run(L, vars);
-			if (result.size() >= 2) {
+			float result[LuaParser::MAX_VALUES];
+			int numValues = parser->run(L, vars, result);
+			if (numValues >= 2) {
 				x = result[0];
 				y = result[1];
-				if (result.size() >= 3) {
+				if (numValues >= 3) {
 					z = result[2];
 				}
 			}
@@ -56,7 +57,7 @@ void CustomEffect::updateCode(const juce::String& newCode) {
 	juce::SpinLock::ScopedLockType lock(codeLock);
 	defaultScript = newCode == DEFAULT_SCRIPT;
     code = newCode;
-	parser = std::make_unique<LuaParser>(FILE_NAME, code, errorCallback);
+	parser = std::make_unique<LuaParser>(FILE_NAME, code, errorCallback, diagnostics);
 }
 
 juce::String CustomEffect::getCode() {
@@ -6,7 +6,7 @@
 
 class CustomEffect : public EffectApplication {
 public:
-	CustomEffect(std::function<void(int, juce::String, juce::String)> errorCallback, std::atomic<double>* luaValues);
+	CustomEffect(std::function<void(int, juce::String, juce::String)> errorCallback, std::atomic<double>* luaValues, LuaDiagnostics* diagnostics = nullptr);
 	~CustomEffect();
 
 	// arbitrary UUID
@@ -24,7 +24,8 @@ private:
 	const juce::String DEFAULT_SCRIPT = "return { x, y, z }";
 	juce::String code = DEFAULT_SCRIPT;
 	std::function<void(int, juce::String, juce::String)> errorCallback;
-	std::unique_ptr<LuaParser> parser = std::make_unique<LuaParser>(FILE_NAME, code, errorCallback);
+	LuaDiagnostics* diagnostics;
+	std::unique_ptr<LuaParser> parser = std::make_unique<LuaParser>(FILE_NAME, code, errorCallback, diagnostics);
 	juce::SpinLock codeLock;
 
 	bool defaultScript = true;
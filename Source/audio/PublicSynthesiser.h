@@ -1,9 +1,70 @@
 #pragma once
 #include <JuceHeader.h>
+#include "../concurrency/AudioThreadPool.h"
 
 class PublicSynthesiser : public juce::Synthesiser {
 public:
 	void publicHandleMidiEvent(const juce::MidiMessage& m) {
         handleMidiEvent(m);
     }
-};
\ No newline at end of file
+
+    // Voices for which canRenderInParallel returns true are rendered
+    // concurrently on the pool, each into its own buffer, and then mixed.
+    // These voices must not share any mutable state. It is called at most
+    // once per voice for each block, just before the voice renders it, so
+    // voices must render the block in the way they said they would, even if
+    // what they're playing changes in the meantime.
+    void setParallelRendering(std::shared_ptr<AudioThreadPool> pool, std::function<bool(juce::SynthesiserVoice*)> canRenderInParallel) {
+        threadPool = pool;
+        this->canRenderInParallel = canRenderInParallel;
+    }
+
+    // must be called before rendering, and whenever the block size changes
+    void prepareParallelRendering(int numChannels, int maxVoices, int samplesPerBlock) {
+        voiceBuffers.clear();
+        for (int i = 0; i < maxVoices; i++) {
+            voiceBuffers.emplace_back(numChannels, samplesPerBlock);
+        }
+        parallelVoices.ensureStorageAllocated(maxVoices);
+    }
+
+protected:
+    void renderVoices(juce::AudioBuffer<float>& outputAudio, int startSample, int numSamples) override {
+        bool fitsBuffers = !voiceBuffers.empty() && voiceBuffers[0].getNumSamples() >= numSamples && voiceBuffers[0].getNumChannels() == outputAudio.getNumChannels();
+        if (threadPool == nullptr || canRenderInParallel == nullptr || !fitsBuffers) {
+            juce::Synthesiser::renderVoices(outputAudio, startSample, numSamples);
+            return;
+        }
+
+        parallelVoices.clearQuick();
+        for (auto* voice : voices) {
+            if (voice->isVoiceActive() && parallelVoices.size() < voiceBuffers.size() && canRenderInParallel(voice)) {
+                parallelVoices.add(voice);
+            } else {
+                voice->renderNextBlock(outputAudio, startSample, numSamples);
+            }
+        }
+
+        if (parallelVoices.size() == 1) {
+            parallelVoices[0]->renderNextBlock(outputAudio, startSample, numSamples);
+            return;
+        }
+
+        threadPool->run(parallelVoices.size(), [this, numSamples](int i) {
+            voiceBuffers[i].clear(0, numSamples);
+            parallelVoices[i]->renderNextBlock(voiceBuffers[i], 0, numSamples);
+        });
+
+        for (int i = 0; i < parallelVoices.size(); i++) {
+            for (int channel = 0; channel < outputAudio.getNumChannels(); channel++) {
+                outputAudio.addFrom(channel, startSample, voiceBuffers[i], channel, 0, numSamples);
+            }
+        }
+    }
+
+private:
+    std::shared_ptr<AudioThreadPool> threadPool;
+    std::function<bool(juce::SynthesiserVoice*)> canRenderInParallel;
+    std::vector<juce::AudioBuffer<float>> voiceBuffers;
+    juce::Array<juce::SynthesiserVoice*> parallelVoices;
+};
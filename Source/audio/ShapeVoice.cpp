@@ -67,6 +67,24 @@ double ShapeVoice::getFrequency() {
     return actualFrequency;
 }
 
+// voices rendering Lua samples only use their own lua_State, so they can be
+// rendered concurrently with each other
+bool ShapeVoice::isRenderingLuaSamples() {
+    startBlock();
+    return blockLua != nullptr;
+}
+
+void ShapeVoice::startBlock() {
+    if (blockStarted) {
+        return;
+    }
+    blockStarted = true;
+    blockSound = sound.load();
+    auto parser = blockSound != nullptr ? blockSound->parser : nullptr;
+    blockRenderingSample = blockSound == nullptr || (parser != nullptr && parser->isSample());
+    blockLua = blockRenderingSample && parser != nullptr ? parser->getSampleLua() : nullptr;
+}
+
 // should be called if the current file is changed so that we interrupt
 // any currently playing sounds / voices
 void ShapeVoice::updateSound(juce::SynthesiserSound* sound) {
@@ -78,6 +96,10 @@ void ShapeVoice::updateSound(juce::SynthesiserSound* sound) {
 void ShapeVoice::renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int startSample, int numSamples) {
     juce::ScopedNoDenormals noDenormals;
 
+    startBlock();
+    // ready for the next block to be decided on
+    blockStarted = false;
+
     int numChannels = outputBuffer.getNumChannels();
 
     if (audioProcessor.midiEnabled->getBoolValue()) {
@@ -100,18 +122,18 @@ void ShapeVoice::renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int star
         double y = 0.0;
         double z = 0.0;
 
-        bool renderingSample = true;
+        bool renderingSample = blockRenderingSample;
 
-        if (sound.load() != nullptr) {
-            auto parser = sound.load()->parser;
-            renderingSample = parser != nullptr && parser->isSample();
+        if (blockSound != nullptr) {
+            auto& parser = blockSound->parser;
 
             if (renderingSample) {
                 vars.sampleRate = audioProcessor.currentSampleRate;
                 vars.frequency = actualFrequency;
                 std::copy(std::begin(audioProcessor.luaValues), std::end(audioProcessor.luaValues), std::begin(vars.sliders));
 
-                channels = parser->nextSample(L, vars);
+                // parallel voices must only run Lua, even if the file changes
+                channels = blockLua != nullptr ? FileParser::nextLuaSample(*blockLua, L, vars) : parser->nextSample(L, vars);
             } else if (currentShape < frame.size()) {
                 auto& shape = frame[currentShape];
                 double length = shape->length();
@@ -172,8 +194,8 @@ void ShapeVoice::renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int star
             if (currentShape < frame.size()) {
                 currentShapeLength = frame[currentShape]->len;
             }
-            if (sound.load() != nullptr && currentlyPlaying) {
-                frameLength = sound.load()->updateFrame(frame);
+            if (blockSound != nullptr && currentlyPlaying) {
+                frameLength = blockSound->updateFrame(frame);
             }
             frameDrawn -= drawnFrameLength;
             if (traceEnabled) {
@@ -193,6 +215,9 @@ void ShapeVoice::renderNextBlock(juce::AudioSampleBuffer& outputBuffer, int star
             }
         }
     }
+
+    // the file keeps its own reference, so this never destroys the parser
+    blockLua = nullptr;
 }
 
 void ShapeVoice::stopNote(float velocity, bool allowTailOff) {
@@ -19,6 +19,10 @@ public:
 
 	void incrementShapeDrawing();
 	double getFrequency();
+	// Decides what the voice renders for the next block, and returns true if
+	// it only runs Lua samples. The decision holds until the block has been
+	// rendered, so it can be made before rendering starts.
+	bool isRenderingLuaSamples();
 
 private:
 	const double MIN_TRACE = 0.005;
@@ -27,6 +31,12 @@ private:
 	OscirenderAudioProcessor& audioProcessor;
 	std::vector<std::unique_ptr<Shape>> frame;
 	std::atomic<ShapeSound*> sound = nullptr;
+	// what the current block is rendered from, which doesn't change part of
+	// the way through the block even if the sound or file does
+	ShapeSound* blockSound = nullptr;
+	bool blockRenderingSample = true;
+	std::shared_ptr<LuaParser> blockLua;
+	bool blockStarted = false;
 	double actualTraceStart;
 	double actualTraceLength;
 
@@ -52,4 +62,5 @@ private:
 	bool waitingForRelease = false;
 
 	void noteStopped();
+	void startBlock();
 };
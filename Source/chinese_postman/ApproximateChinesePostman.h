@@ -0,0 +1,243 @@
+#pragma once
+
+#include "./ChinesePostman.h"
+#include "../parser/ParseProgress.h"
+#include <chrono>
+#include <queue>
+#include <cmath>
+
+/*
+Approximately solves the chinese postman problem, for graphs that have too many
+odd degree vertices to find the minimum cost perfect matching in a reasonable time
+
+Each odd degree vertex is greedily joined to the nearest unmatched odd degree vertex,
+using a Dijkstra search that stops as soon as it finds one. If the deadline passes,
+the remaining odd degree vertices are joined through a spanning tree instead, which
+only takes linear time. The duplicated edges are then improved locally until the
+deadline, by flipping which edges of a triangle are duplicated when that is cheaper.
+If progress is cancelled, the deadline is treated as having passed
+
+returns the same as ChinesePostman
+lowerBound is set to a lower bound on the cost of the optimal solution, so that
+the quality of the approximation can be reported
+*/
+pair< vector<int>, double > ApproximateChinesePostman(Graph& G, vector<double>& cost, chrono::steady_clock::time_point deadline, double& lowerBound, const ParseProgress* progress = nullptr)
+{
+	//Check if the graph if connected
+	if(not Connected(G))
+		throw "Error: Graph is not connected";
+
+	int n = G.GetNumVertices();
+	auto edgeCost = [&](int e) { return cost.empty() ? 1.0 : cost[e]; };
+	auto outOfTime = [&]() { return chrono::steady_clock::now() >= deadline or (progress != nullptr and progress->isCancelled()); };
+
+	//The cost of any solution is at least the cost of traversing every edge once
+	lowerBound = 0;
+	for(int e = 0; e < G.GetNumEdges(); e++)
+		lowerBound += edgeCost(e);
+
+	//Find vertices with odd degree
+	//nearest is a lower bound on the cost of the path from each one to any other odd degree vertex,
+	//which is at least the cost of its cheapest edge until a search finds the real value
+	vector<int> odd;
+	vector<bool> isOdd(n, false);
+	vector<double> nearest(n, 0);
+	for(int u = 0; u < n; u++)
+	{
+		if(G.AdjList(u).size() % 2)
+		{
+			odd.push_back(u);
+			isOdd[u] = true;
+			nearest[u] = numeric_limits<double>::infinity();
+			for(int e : G.AdjEdges(u))
+				nearest[u] = min(nearest[u], edgeCost(e));
+		}
+	}
+
+	//Number of extra times each edge has to be traversed
+	vector<int> extra(G.GetNumEdges(), 0);
+	vector<bool> matched(n, false);
+
+	//Greedily match odd degree vertices until the deadline
+	vector<double> pathCost(n, numeric_limits<double>::infinity());
+	vector<int> father(n, -1);
+	vector<bool> permanent(n, false);
+	vector<int> touched;
+	for(int u : odd)
+	{
+		if(outOfTime())
+			break;
+		if(matched[u])
+			continue;
+
+		priority_queue< pair<double, int>, vector< pair<double, int> >, greater< pair<double, int> > > heap;
+		heap.push(make_pair(0, u));
+		pathCost[u] = 0;
+		touched.push_back(u);
+
+		int partner = -1;
+		bool foundNearest = false;
+		while(not heap.empty())
+		{
+			int v = heap.top().second;
+			double c = heap.top().first;
+			heap.pop();
+
+			if(permanent[v])
+				continue;
+			permanent[v] = true;
+
+			if(v != u and isOdd[v])
+			{
+				//The first odd degree vertex we reach is the nearest one
+				if(not foundNearest)
+				{
+					nearest[u] = c;
+					foundNearest = true;
+				}
+				if(not matched[v])
+				{
+					partner = v;
+					break;
+				}
+			}
+
+			Graph::Range adjacent = G.AdjList(v);
+			Graph::Range adjacentEdges = G.AdjEdges(v);
+			for(int j = 0; j < adjacent.size(); j++)
+			{
+				int w = adjacent[j];
+				if(permanent[w])
+					continue;
+
+				double cw = c + edgeCost(adjacentEdges[j]);
+				if(LESS(cw, pathCost[w]))
+				{
+					if(isinf(pathCost[w]))
+						touched.push_back(w);
+					father[w] = v;
+					pathCost[w] = cw;
+					heap.push(make_pair(cw, w));
+				}
+			}
+		}
+
+		//There is always another unmatched odd degree vertex, as there are an even number of them
+		if(partner == -1)
+			throw "Error: no vertex to match with";
+
+		matched[u] = matched[partner] = true;
+		for(int v = partner; v != u; v = father[v])
+			extra[G.GetEdgeIndex(v, father[v])]++;
+
+		//Only reset the vertices this search reached, so that each search is local
+		for(int v : touched)
+		{
+			pathCost[v] = numeric_limits<double>::infinity();
+			father[v] = -1;
+			permanent[v] = false;
+		}
+		touched.clear();
+	}
+
+	//Join any vertices we didn't have time to match through a breadth first spanning tree
+	//Going from the leaves up, the edge to a vertex's father is duplicated when an odd
+	//number of unmatched vertices are below it
+	vector<int> order;
+	order.reserve(n);
+	vector<bool> visited(n, false);
+	order.push_back(0);
+	visited[0] = true;
+	for(int i = 0; i < (int)order.size(); i++)
+	{
+		int u = order[i];
+		for(int v : G.AdjList(u))
+		{
+			if(not visited[v])
+			{
+				visited[v] = true;
+				father[v] = u;
+				order.push_back(v);
+			}
+		}
+	}
+
+	vector<bool> unmatched(n, false);
+	for(int u : odd)
+		unmatched[u] = not matched[u];
+	for(int i = n-1; i > 0; i--)
+	{
+		int u = order[i];
+		if(unmatched[u])
+		{
+			extra[G.GetEdgeIndex(u, father[u])]++;
+			unmatched[father[u]] = not unmatched[father[u]];
+		}
+	}
+
+	//Traversing an edge two more times doesn't change the parity of any vertex, so it is never needed
+	for(int e = 0; e < G.GetNumEdges(); e++)
+		extra[e] %= 2;
+
+	//Flipping whether each edge of a triangle is duplicated keeps every vertex's parity the same,
+	//so do it whenever the duplicated edges of a triangle cost more than the others
+	//edgeTo[w] is the index of the edge from the current vertex u to w, or -1
+	vector<int> edgeTo(n, -1);
+	bool improved = true;
+	while(improved and not outOfTime())
+	{
+		improved = false;
+		for(int u = 0; u < n; u++)
+		{
+			Graph::Range adjacent = G.AdjList(u);
+			Graph::Range adjacentEdges = G.AdjEdges(u);
+			for(int j = 0; j < adjacent.size(); j++)
+				edgeTo[adjacent[j]] = adjacentEdges[j];
+
+			for(int j = 0; j < adjacent.size(); j++)
+			{
+				int v = adjacent[j];
+				int e = adjacentEdges[j];
+				if(v < u or extra[e] == 0)
+					continue;
+
+				//w is in a triangle with u and v if it is adjacent to both
+				Graph::Range adjacentToV = G.AdjList(v);
+				Graph::Range adjacentEdgesToV = G.AdjEdges(v);
+				for(int k = 0; k < adjacentToV.size(); k++)
+				{
+					int w = adjacentToV[k];
+					if(edgeTo[w] == -1)
+						continue;
+
+					int triangle[3] = { e, edgeTo[w], adjacentEdgesToV[k] };
+					double duplicated = 0, single = 0;
+					for(int f : triangle)
+						(extra[f] ? duplicated : single) += edgeCost(f);
+
+					if(GREATER(duplicated, single))
+					{
+						for(int f : triangle)
+							extra[f] = 1 - extra[f];
+						improved = true;
+						break;
+					}
+				}
+			}
+
+			for(int w : adjacent)
+				edgeTo[w] = -1;
+		}
+	}
+
+	//Any solution has to join each odd degree vertex to another one
+	for(int u : odd)
+		lowerBound += nearest[u] / 2;
+
+	//Every edge is traversed once, plus the extra times needed
+	vector<int> multiplicity(G.GetNumEdges());
+	for(int e = 0; e < G.GetNumEdges(); e++)
+		multiplicity[e] = 1 + extra[e];
+
+	return EulerianCycle(G, multiplicity, cost);
+}
@@ -1,11 +1,15 @@
+#pragma once
+
 #include "Dijkstra.h"
 #include "./Matching.h"
 #include "./Graph.h"
+#include "../concurrency/ParallelFor.h"
+#include <algorithm>
 
 bool Connected(Graph & G)
 {
     vector<bool> visited(G.GetNumVertices(), false);
-    list<int> L;
+    vector<int> L;
     
     int n = 0;
     L.push_back(0);
@@ -26,124 +30,125 @@ bool Connected(Graph & G)
     return G.GetNumVertices() == n;
 }
 
+/*
+Finds an Eulerian cycle in the multigraph where edge e of G appears multiplicity[e] times,
+which must be at least once for every edge, giving every vertex an even degree
+Uses Hierholzer's algorithm, with a stack of vertices and the position reached in each
+vertex's neighbours, so that every edge is only looked at a constant number of times
+returns the sequence of vertices in the cycle and its cost
+*/
+pair< vector<int>, double > EulerianCycle(Graph& G, vector<int>& multiplicity, vector<double>& cost)
+{
+	int n = G.GetNumVertices();
+
+	//This is to keep track of how many times we can still traverse an edge
+	vector<int> remaining = multiplicity;
+	//The neighbour of each vertex to look at next
+	vector<int> next(n, 0);
+
+	vector<int> cycle;
+	vector<int> stack;
+	stack.push_back(0);
+	double obj = 0;
+	while(not stack.empty())
+	{
+		int u = stack.back();
+		Graph::Range adjacent = G.AdjList(u);
+		Graph::Range adjacentEdges = G.AdjEdges(u);
+
+		while(next[u] < adjacent.size() and remaining[ adjacentEdges[next[u]] ] == 0)
+			next[u]++;
+
+		//if there are non-traversed edges incident to u, follow one of them
+		//otherwise u is finished, and is the next vertex of the cycle, going backwards
+		if(next[u] < adjacent.size())
+		{
+			int e = adjacentEdges[next[u]];
+			remaining[e]--;
+			obj += cost.empty() ? 1.0 : cost[e];
+			stack.push_back(adjacent[next[u]]);
+		}
+		else
+		{
+			cycle.push_back(u);
+			stack.pop_back();
+		}
+	}
+
+	reverse(cycle.begin(), cycle.end());
+
+	return pair< vector<int>, double >(cycle, obj);
+}
+
 /*
 Solves the chinese postman problem
-returns a pair containing a list and a double
-the list is the sequence of vertices in the solution
+returns a pair containing a vector and a double
+the vector is the sequence of vertices in the solution
 the double is the solution cost
 */
-pair< list<int>, double > ChinesePostman(Graph& G, vector<double>& cost)
+pair< vector<int>, double > ChinesePostman(Graph& G, vector<double>& cost)
 {
 	//Check if the graph if connected
 	if(not Connected(G))
 		throw "Error: Graph is not connected";
 
-	//Build adjacency lists using edges in the graph
-	vector<vector<int>> A(G.GetNumVertices(), vector<int>());
-	for(int u = 0; u < G.GetNumVertices(); u++)
-	    A[u] = G.AdjList(u);
+	//Every edge is traversed at least once
+	vector<int> multiplicity(G.GetNumEdges(), 1);
 
 	//Find vertices with odd degree
 	vector<int> odd;
 	for(int u = 0; u < G.GetNumVertices(); u++)
-		if(A[u].size() % 2)
+		if(G.AdjList(u).size() % 2)
 			odd.push_back(u);
 
     //If there are odd degree vertices
 	if(not odd.empty())
 	{
-		//Create a graph with the odd degree vertices
-		auto edges = list<pair<int, int>>();
-		Graph O(odd.size(), edges);
+		//Create a complete graph with the odd degree vertices
+		vector< pair<int, int> > edges;
+		edges.reserve(odd.size() * (odd.size() - 1) / 2);
 		for(int u = 0; u < (int)odd.size(); u++)
 			for(int v = u+1; v < (int)odd.size(); v++)
-				O.AddEdge(u, v);
+				edges.push_back(make_pair(u, v));
+		Graph O(odd.size(), edges);
 
         vector<double> costO(O.GetNumEdges());
         
         //Find the shortest paths between all odd degree vertices
-		vector< vector<int> > shortestPath(O.GetNumVertices());
-		for(int u = 0; u < (int)odd.size(); u++)
+        //Each search is independent, so they are run in parallel
+		parallelFor((int)odd.size(), [&](int u)
 		{
 			pair< vector<int>, vector<double> > sp = Dijkstra(G, odd[u], cost);
 			
-			shortestPath[u] = sp.first ;
-			
 			//The cost of an edge uv in O will be the cost of the corresponding shortest path in G
-			for(int v = 0; v < (int)odd.size(); v++)
-			    if(v != u)
-    			    costO[ O.GetEdgeIndex(u, v) ] = sp.second[odd[v]];
-		}
+			//Only the search from the larger of u and v sets it, so the result is deterministic
+			for(int v = 0; v < u; v++)
+    			costO[ O.GetEdgeIndex(u, v) ] = sp.second[odd[v]];
+		});
 
 	    //Find the minimum cost perfect matching of the graph of the odd degree vertices
 	    Matching M(O);
 	    pair< list<int>, double > p = M.SolveMinimumCostPerfectMatching(costO);
-	    list<int> matching = p.first;
+	    vector<int> matching(p.first.begin(), p.first.end());
 	    
 	    //If an edge uv is in the matching, the edges in the shortest path from u to v should be duplicated in G
-	    for(list<int>::iterator it = matching.begin(); it != matching.end(); it++)
+	    //The paths are found again rather than keeping every search's tree, which would take O(n) memory per odd vertex
+	    vector< vector<int> > pathEdges(matching.size());
+	    parallelFor((int)matching.size(), [&](int i)
 	    {
-		    pair<int, int> p = O.GetEdge(*it);
-		    int u = p.first, v = odd[p.second];
+		    pair<int, int> p = O.GetEdge(matching[i]);
+		    int u = odd[p.first], v = odd[p.second];
+		    vector<int> father = Dijkstra(G, u, cost, v).first;
 		    
-		    //Go through the path adding the edges
-		    int w = shortestPath[u][v];
-		    while(w != -1)
-		    {
-		        A[w].push_back(v);
-		        A[v].push_back(w);
-		        v = w;
-		        w = shortestPath[u][v];
-		    }
-	    }
-	}
-
-	//Find an Eulerian cycle in the graph implied by A
-	list<int> cycle;
-	//This is to keep track of how many times we can traverse an edge
-	vector<int> traversed(G.GetNumEdges(), 0);
-	for(int u = 0; u < G.GetNumVertices(); u++)
-	{
-		for(int v : A[u]) {
-			//we do this so that the edge is not counted twice
-			if(v < u) continue;
-
-			traversed[G.GetEdgeIndex(u, v)]++;
-		}
-	}
-
-	cycle.push_back(0);
-	list<int>::iterator itp = cycle.begin();
-	double obj = 0;
-	while(itp != cycle.end())
-	{
-		//Let u be the current vertex in the cycle, starting at the first
-		int u = *itp;
-		list<int>::iterator jtp = itp;
-		jtp++;
-
-		//if there are non-traversed edges incident to u, find a subcycle starting at u
-		//replace u in the cycle by the subcycle
-		while(not A[u].empty())
-		{
-			while(not A[u].empty() and traversed[ G.GetEdgeIndex(u, A[u].back()) ] == 0)
-				A[u].pop_back();
-
-			if(not A[u].empty())
-			{
-				int v = A[u].back();
-				A[u].pop_back();
-				cycle.insert(jtp, v);
-				traversed[G.GetEdgeIndex(u, v)]--;
-
-		        obj += cost.empty() ? 1.0 : cost[ G.GetEdgeIndex(u, v) ];
-				u = v;
-			}
-		}
+		    //Go through the path collecting the edges
+		    for(int w = father[v]; w != -1; v = w, w = father[v])
+		        pathEdges[i].push_back(G.GetEdgeIndex(w, v));
+	    });
 
-		//go to the next vertex in the cycle and do the same
-		itp++;
+	    for(vector<int>& path : pathEdges)
+		    for(int e : path)
+			    multiplicity[e]++;
 	}
 
-	return pair< list<int>, double >(cycle, obj);
+	return EulerianCycle(G, multiplicity, cost);
 }
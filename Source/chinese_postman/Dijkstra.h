@@ -10,7 +10,8 @@ using namespace std;
 //Returns a pair (vector<int>, vector<double>)
 //vector<double> gives the cost of the optimal path to each vertex
 //vector<int> gives the parent of each vertex in the tree of optimal paths
-pair< vector<int>, vector<double> > Dijkstra(Graph & G, int origin, vector<double> & cost)
+//If target is given, the search stops once the optimal path to target is found
+pair< vector<int>, vector<double> > Dijkstra(Graph & G, int origin, vector<double> & cost, int target = -1)
 {
 	BinaryHeap B;
 
@@ -35,13 +36,19 @@ pair< vector<int>, vector<double> > Dijkstra(Graph & G, int origin, vector<doubl
 
 		permanent[u] = true;
 
+		if(u == target)
+			return make_pair(father, pathCost);
+
 		//Update the heap with vertices adjacent to u
-		for (int v : G.AdjList(u)) {
+		Graph::Range adjacent = G.AdjList(u);
+		Graph::Range adjacentEdges = G.AdjEdges(u);
+		for (int j = 0; j < adjacent.size(); j++) {
+			int v = adjacent[j];
 			
 			if(permanent[v])
 				continue;
 
-			double c = pathCost[u] + (cost.empty() ? 1.0 : cost[G.GetEdgeIndex(u,v)]);
+			double c = pathCost[u] + (cost.empty() ? 1.0 : cost[adjacentEdges[j]]);
 
 			//v has not been discovered yet
 			if(father[v] == -1)
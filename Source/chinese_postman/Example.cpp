@@ -24,9 +24,8 @@ pair< Graph, vector<double> > ReadWeightedGraph(string filename)
 	int m;
 	ss >> m;
 
-	auto edges = list<pair<int, int>>();
-	Graph G(n, edges);
-	vector<double> cost(m);
+	vector< pair<int, int> > edges;
+	vector<double> edgeCost;
 	for(int i = 0; i < m; i++)
 	{
 		getline(file, s);
@@ -36,11 +35,22 @@ pair< Graph, vector<double> > ReadWeightedGraph(string filename)
 		double c;
 		ss >> u >> v >> c;
 
-		G.AddEdge(u, v);
-		cost[G.GetEdgeIndex(u, v)] = c;
+		edges.push_back(make_pair(u, v));
+		edgeCost.push_back(c);
 	}
 
 	file.close();
+
+	//The graph numbers its edges itself, so the costs are put in its order
+	Graph G(n, edges);
+	vector<double> cost(G.GetNumEdges());
+	for(int i = 0; i < m; i++)
+	{
+		int e = G.GetEdgeIndex(edges[i].first, edges[i].second);
+		if(e != -1)
+			cost[e] = edgeCost[i];
+	}
+
 	return make_pair(G, cost);
 }
 
@@ -80,16 +90,16 @@ int main(int argc, char * argv[])
 	    cost = p.second;
 
 	    //Solve the problem
-     	pair< list<int> , double > sol = ChinesePostman(G, cost);
+     	pair< vector<int> , double > sol = ChinesePostman(G, cost);
 
 		cout << "Solution cost: " << sol.second << endl;
 
-		list<int> s = sol.first;
+		vector<int> s = sol.first;
 
         //Print edges in the solution
 		cout << "Solution:" << endl;
-		for(list<int>::iterator it = s.begin(); it != s.end(); it++)
-			cout << *it << " ";
+		for(int v : s)
+			cout << v << " ";
 		cout << endl;
 	}
 	catch(const char * msg)
@@ -1,55 +1,85 @@
 #include "Graph.h"
+#include <algorithm>
 
-Graph::Graph(int n, list< pair<int, int> > & edges):
+Graph::Graph(int n, const vector< pair<int, int> > & edgeList):
 	n(n),
-	m(edges.size()),
-	adjMat(n * n),
-	adjList(n),
-	edges(),
-	edgeIndex()
+	m(0),
+	offset(n + 1, 0),
+	adjacent(),
+	adjacentEdge(),
+	edges()
 {
-	for(list< pair<int, int> >::const_iterator it = edges.begin(); it != edges.end(); it++)
+	//Store each edge once, with the smaller endpoint first
+	edges.reserve(edgeList.size());
+	for(const pair<int, int>& edge : edgeList)
 	{
-		int u = (*it).first;
-		int v = (*it).second;
-        
-        if (v < n && u < n) {
-            AddEdge(u, v);
-        }
+		int u = min(edge.first, edge.second);
+		int v = max(edge.first, edge.second);
+
+		if(u >= 0 and v < n and u != v)
+			edges.push_back(make_pair(u, v));
+	}
+	//The edges are often already sorted, e.g. when they come from another graph
+	if(not is_sorted(edges.begin(), edges.end()))
+		sort(edges.begin(), edges.end());
+	edges.erase(unique(edges.begin(), edges.end()), edges.end());
+	m = edges.size();
+
+	//Count the degree of each vertex, then turn the counts into offsets
+	for(const pair<int, int>& edge : edges)
+	{
+		offset[edge.first + 1]++;
+		offset[edge.second + 1]++;
+	}
+	for(int v = 0; v < n; v++)
+		offset[v + 1] += offset[v];
+
+	//As the edges are sorted, every vertex sees its smaller neighbours in increasing
+	//order before its larger ones, so each vertex's neighbours end up sorted
+	adjacent.resize(2 * m);
+	adjacentEdge.resize(2 * m);
+	vector<int> next(offset.begin(), offset.end() - 1);
+	for(int e = 0; e < m; e++)
+	{
+		int u = edges[e].first;
+		int v = edges[e].second;
+
+		adjacent[next[u]] = v;
+		adjacentEdge[next[u]++] = e;
+		adjacent[next[v]] = u;
+		adjacentEdge[next[v]++] = e;
 	}
 }
 
-pair<int, int> Graph::GetEdge(int e)
+pair<int, int> Graph::GetEdge(int e) const
 {
 	return edges[e];
 }
 
-int Graph::GetEdgeIndex(int u, int v) {
-	return edgeIndex[u * n + v];
-}
-
-void Graph::AddEdge(int u, int v)
+//Binary search through the neighbours of u
+int Graph::GetEdgeIndex(int u, int v) const
 {
-	if(adjMat[u * n + v]) return;
-
-	adjMat[u * n + v] = adjMat[v * n + u] = true;
-	adjList[u].push_back(v);
-	adjList[v].push_back(u);
+	const int* first = adjacent.data() + offset[u];
+	const int* last = adjacent.data() + offset[u + 1];
+	const int* it = lower_bound(first, last, v);
+	if(it == last or *it != v)
+		return -1;
 
-	edges.push_back(pair<int, int>(u, v));
-	edgeIndex[u * n + v] = edgeIndex[v * n + u] = m++;
+	return adjacentEdge[it - adjacent.data()];
 }
 
-const vector<int>& Graph::AdjList(int v)
+Graph::Range Graph::AdjList(int v) const
 {
-	if(v > n)
+	if(v < 0 or v >= n)
 		throw "Error: vertex does not exist";
 
-	return adjList[v];
+	return Range(adjacent.data() + offset[v], adjacent.data() + offset[v + 1]);
 }
 
-const vector<bool> & Graph::AdjMat()
+Graph::Range Graph::AdjEdges(int v) const
 {
-	return adjMat;
-}
+	if(v < 0 or v >= n)
+		throw "Error: vertex does not exist";
 
+	return Range(adjacentEdge.data() + offset[v], adjacentEdge.data() + offset[v + 1]);
+}
@@ -2,52 +2,67 @@
 
 #include <list>
 #include <vector>
-#include <unordered_map>
 using namespace std;
 
+/*
+An undirected graph stored in compressed sparse row form, so it takes O(n + m) memory
+The neighbours of each vertex are stored contiguously in increasing order, alongside
+the index of the edge to each neighbour
+Edges are numbered in increasing order of their endpoints (u, v) with u < v
+ */
 class Graph
 {
 public:
+	//A contiguous range of vertex or edge indices
+	class Range
+	{
+	public:
+		Range(const int* first, const int* last): first(first), last(last) {};
+
+		const int* begin() const { return first; };
+		const int* end() const { return last; };
+		int size() const { return (int)(last - first); };
+		bool empty() const { return first == last; };
+		int operator[](int i) const { return first[i]; };
+	private:
+		const int* first;
+		const int* last;
+	};
+
 	//n is the number of vertices
-	//edges is a list of pairs representing the edges (default = empty list)
-	Graph(int n, list< pair<int, int> > & edges);
+	//edges is a list of pairs representing the edges, in any order
+	//Repeated edges, self loops and edges to vertices that don't exist are ignored
+	Graph(int n, const vector< pair<int, int> > & edges);
 
 	//Default constructor creates an empty graph
-	Graph(): n(0), m(0) {};
+	Graph(): n(0), m(0), offset(1, 0) {};
 
 	//Returns the number of vertices
-	int GetNumVertices() { return n; };
+	int GetNumVertices() const { return n; };
 	//Returns the number of edges
-	int GetNumEdges() { return m; };
-
-	//Given the edge's index, returns its endpoints as a pair
-	pair<int, int> GetEdge(int e);
-	//Given the endpoints, returns the index
-	int GetEdgeIndex(int u, int v);
+	int GetNumEdges() const { return m; };
 
-	//Adds a new edge to the graph
-	void AddEdge(int u, int v);
+	//Given the edge's index, returns its endpoints as a pair, with the smaller one first
+	pair<int, int> GetEdge(int e) const;
+	//Given the endpoints, returns the index, or -1 if they aren't adjacent
+	int GetEdgeIndex(int u, int v) const;
 
-	//Returns the adjacency list of a vertex
-	const vector<int>& AdjList(int v);
-
-	//Returns the graph's adjacency matrix
-	const vector<bool>& AdjMat();
+	//Returns the neighbours of a vertex, in increasing order
+	Range AdjList(int v) const;
+	//Returns the indices of the edges to each neighbour of a vertex, in the same order as AdjList
+	Range AdjEdges(int v) const;
 private:
 	//Number of vertices
 	int n;
 	//Number of edges
 	int m;
 
-	//Adjacency matrix
-	vector<bool> adjMat;
-
-	//Adjacency lists
-	vector<vector<int> > adjList;
+	//The neighbours of vertex v are adjacent[offset[v]] to adjacent[offset[v+1] - 1]
+	vector<int> offset;
+	vector<int> adjacent;
+	//adjacentEdge[i] is the index of the edge to adjacent[i]
+	vector<int> adjacentEdge;
 
 	//Array of edges
 	vector<pair<int, int> > edges;
-
-	//Indices of the edges
-	unordered_map<int, int> edgeIndex;
 };
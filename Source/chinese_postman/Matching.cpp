@@ -38,9 +38,12 @@ void Matching::Grow()
 		for(int u : deep[w]) {
 
 			int cont = false;
-			for(int v : G.AdjList(u)) {
+			Graph::Range adjacent = G.AdjList(u);
+			Graph::Range adjacentEdges = G.AdjEdges(u);
+			for(int j = 0; j < adjacent.size(); j++) {
+				int v = adjacent[j];
 
-				if(IsEdgeBlocked(u, v)) continue;
+				if(IsEdgeBlocked(adjacentEdges[j])) continue;
 
 				//u is even and v is odd
 				if(type[outer[v]] == ODD) continue;	
@@ -100,7 +103,8 @@ void Matching::Grow()
 
 bool Matching::IsAdjacent(int u, int v)
 {
-	return (G.AdjMat()[u * G.GetNumVertices() + v] and not IsEdgeBlocked(u, v));
+	int e = G.GetEdgeIndex(u, v);
+	return (e != -1 and not IsEdgeBlocked(e));
 }
 
 bool Matching::IsEdgeBlocked(int u, int v)
@@ -141,8 +145,11 @@ void Matching::Heuristic()
 		if(mate[outer[u]] == -1)
 		{
 			int min = -1;
-			for (int v : G.AdjList(u)) {
-				if(IsEdgeBlocked(u, v) or
+			Graph::Range adjacent = G.AdjList(u);
+			Graph::Range adjacentEdges = G.AdjEdges(u);
+			for (int j = 0; j < adjacent.size(); j++) {
+				int v = adjacent[j];
+				if(IsEdgeBlocked(adjacentEdges[j]) or
 					(outer[u] == outer[v]) or
 					(mate[outer[v]] != -1) )
 					continue;
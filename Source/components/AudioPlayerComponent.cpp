@@ -17,7 +17,7 @@ AudioPlayerComponent::AudioPlayerComponent(CommonAudioProcessor& processor) : au
     slider.onValueChange = [this]() {
         juce::SpinLock::ScopedLockType sl(audioProcessor.wavParserLock);
 
-        audioProcessor.wavParser.setProgress(slider.getValue());
+        audioProcessor.wavParser->setProgress(slider.getValue());
     };
 
     addChildComponent(playButton);
@@ -27,16 +27,16 @@ AudioPlayerComponent::AudioPlayerComponent(CommonAudioProcessor& processor) : au
     pauseButton.setTooltip("Pause audio file");
 
     playButton.onClick = [this]() {
-        audioProcessor.wavParser.setPaused(false);
-        if (audioProcessor.wavParser.isInitialised()) {
+        audioProcessor.wavParser->setPaused(false);
+        if (audioProcessor.wavParser->isInitialised()) {
             playButton.setVisible(false);
             pauseButton.setVisible(true);
         }
     };
 
     pauseButton.onClick = [this]() {
-        audioProcessor.wavParser.setPaused(true);
-        if (audioProcessor.wavParser.isInitialised()) {
+        audioProcessor.wavParser->setPaused(true);
+        if (audioProcessor.wavParser->isInitialised()) {
             playButton.setVisible(true);
             pauseButton.setVisible(false);
         }
@@ -47,7 +47,7 @@ AudioPlayerComponent::AudioPlayerComponent(CommonAudioProcessor& processor) : au
     repeatButton.setTooltip("Repeat audio file once it finishes playing");
 
     repeatButton.onClick = [this]() {
-        audioProcessor.wavParser.setLooping(repeatButton.getToggleState());
+        audioProcessor.wavParser->setLooping(repeatButton.getToggleState());
     };
 
     addAndMakeVisible(stopButton);
@@ -58,37 +58,29 @@ AudioPlayerComponent::AudioPlayerComponent(CommonAudioProcessor& processor) : au
         audioProcessor.stopAudioFile();
     };
 
-    {
-        juce::SpinLock::ScopedLockType sl(audioProcessor.wavParserLock);
-        setup();
-    }
+    setup();
 }
 
 AudioPlayerComponent::~AudioPlayerComponent() {
     audioProcessor.removeAudioPlayerListener(this);
-    audioProcessor.wavParser.onProgress = nullptr;
 }
 
-// must hold lock
+// the parser is only replaced on the message thread, so no lock is needed
 void AudioPlayerComponent::setup() {
-    repeatButton.setToggleState(audioProcessor.wavParser.isLooping(), juce::dontSendNotification);
+    repeatButton.setToggleState(audioProcessor.wavParser->isLooping(), juce::dontSendNotification);
 
-    if (audioProcessor.wavParser.isInitialised()) {
+    if (audioProcessor.wavParser->isInitialised()) {
         slider.setVisible(true);
         repeatButton.setVisible(true);
         stopButton.setVisible(true);
-        audioProcessor.wavParser.onProgress = [this](double progress) {
-            juce::WeakReference<AudioPlayerComponent> weakRef(this);
-            juce::MessageManager::callAsync([this, progress, weakRef]() {
-                if (weakRef) {
-                    slider.setValue(progress, juce::dontSendNotification);
-                    repaint();
-                }
-            });
-        };
-        playButton.setVisible(audioProcessor.wavParser.isPaused());
-        pauseButton.setVisible(!audioProcessor.wavParser.isPaused());
+        playButton.setVisible(audioProcessor.wavParser->isPaused());
+        pauseButton.setVisible(!audioProcessor.wavParser->isPaused());
+        overview = audioProcessor.wavParser->getOverview();
+        overviewProgress = -1;
+        startTimerHz(30);
     } else {
+        stopTimer();
+        overview = nullptr;
         slider.setVisible(false);
         repeatButton.setVisible(false);
         stopButton.setVisible(false);
@@ -114,6 +106,43 @@ void AudioPlayerComponent::parserChanged() {
     }
 }
 
+void AudioPlayerComponent::timerCallback() {
+    // the slider isn't moved while it is being dragged
+    if (!slider.isMouseButtonDown()) {
+        slider.setValue(audioProcessor.wavParser->getProgress(), juce::dontSendNotification);
+    }
+
+    // redraw the waveform as more of it is read
+    if (overview != nullptr && overview->getProgress() != overviewProgress) {
+        repaint(slider.getBounds());
+    }
+}
+
+void AudioPlayerComponent::paint(juce::Graphics& g) {
+    if (overview == nullptr || !slider.isVisible()) {
+        return;
+    }
+
+    overviewProgress = overview->getProgress();
+    // the track of the slider is inset by the thumb
+    auto area = slider.getBounds().reduced(timelineLookAndFeel.getSliderThumbRadius(slider), 0).toFloat();
+    int width = (int) area.getWidth();
+    if (width <= 0) {
+        return;
+    }
+    bins.resize(width);
+    overview->getBins(0, 1, bins);
+
+    g.setColour(juce::Colours::white.withAlpha(0.25f));
+    float centre = area.getCentreY();
+    float halfHeight = area.getHeight() / 2;
+    for (int i = 0; i < width; i++) {
+        float top = juce::jlimit(-1.0f, 1.0f, juce::jmax(bins[i].maxX, bins[i].maxY));
+        float bottom = juce::jlimit(-1.0f, 1.0f, juce::jmin(bins[i].minX, bins[i].minY));
+        g.fillRect(area.getX() + i, centre - top * halfHeight, 1.0f, juce::jmax(1.0f, (top - bottom) * halfHeight));
+    }
+}
+
 void AudioPlayerComponent::resized() {
     auto r = getLocalBounds();
 
@@ -54,16 +54,18 @@ public:
 };
 
 class CommonAudioProcessor;
-class AudioPlayerComponent : public juce::Component, public AudioPlayerListener {
+class AudioPlayerComponent : public juce::Component, public AudioPlayerListener, public juce::Timer {
 public:
     AudioPlayerComponent(CommonAudioProcessor& processor);
     ~AudioPlayerComponent() override;
 
+	void paint(juce::Graphics& g) override;
 	void resized() override;
+	void timerCallback() override;
     void setup();
     void parserChanged() override;
     void setPaused(bool paused);
-    bool isInitialised() const { return audioProcessor.wavParser.isInitialised(); }
+    bool isInitialised() const { return audioProcessor.wavParser->isInitialised(); }
 
     std::function<void()> onParserChanged;
 
@@ -78,6 +80,11 @@ private:
     SvgButton stopButton{ "Stop", BinaryData::stop_svg, juce::Colours::white, juce::Colours::white };
 	juce::Slider slider;
 
+	// the waveform drawn behind the slider, and how much of it was read when it was last drawn
+	std::shared_ptr<AudioOverview> overview;
+	double overviewProgress = 0;
+	std::vector<AudioOverview::Bin> bins;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioPlayerComponent)
     JUCE_DECLARE_WEAK_REFERENCEABLE(AudioPlayerComponent)
 };
@@ -0,0 +1,95 @@
+#include "AudioThreadPool.h"
+
+AudioThreadPool::AudioThreadPool(int numThreads) {
+    for (int i = 0; i < numThreads; i++) {
+        workers.push_back(std::make_unique<Worker>(*this));
+    }
+    // the audio thread waits for the workers, so they must not be preempted
+    // by lower priority threads while running a job
+    for (auto& worker : workers) {
+        if (!worker->startRealtimeThread(juce::Thread::RealtimeOptions().withPriority(10))) {
+            worker->startThread(juce::Thread::Priority::highest);
+        }
+    }
+}
+
+AudioThreadPool::~AudioThreadPool() {
+    for (auto& worker : workers) {
+        worker->signalThreadShouldExit();
+    }
+    wake.notify_all();
+    workers.clear();
+}
+
+void AudioThreadPool::run(int numJobs, const std::function<void(int)>& job) {
+    if (numJobs <= 0) {
+        return;
+    }
+
+    uint32_t batch = generation.load() + 1;
+    // close the previous batch before changing anything, so that a worker
+    // still holding a stale claim can't match it against the new job count
+    nextJob.store(((uint64_t) batch << 32) | 0xFFFFFFFF);
+
+    this->job = &job;
+    this->numJobs = numJobs;
+    jobsRemaining = numJobs;
+    // publishing the first index makes the jobs claimable
+    nextJob.store((uint64_t) batch << 32, std::memory_order_release);
+    generation = batch;
+
+    // we don't take the mutex here, so a worker might miss this. That only
+    // means it doesn't help with this batch, as we run the jobs ourselves too.
+    wake.notify_all();
+
+    // this claims every job that no worker has claimed yet, including all of
+    // them if no worker woke up in time, so we only wait below for jobs that
+    // are already running on a worker
+    runJobs(batch);
+
+    while (jobsRemaining.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+int AudioThreadPool::getNumThreads() {
+    return workers.size();
+}
+
+void AudioThreadPool::runJobs(uint32_t batch) {
+    while (true) {
+        uint64_t claim = nextJob.load(std::memory_order_acquire);
+        uint32_t index = claim & 0xFFFFFFFF;
+        if ((claim >> 32) != batch || index >= numJobs.load()) {
+            return;
+        }
+        // the batch can't finish while we hold a claim on one of its jobs,
+        // so job is guaranteed to still be valid once this succeeds
+        if (nextJob.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel)) {
+            (*job)(index);
+            jobsRemaining.fetch_sub(1, std::memory_order_release);
+        }
+    }
+}
+
+AudioThreadPool::Worker::Worker(AudioThreadPool& pool) : juce::Thread("Audio Thread Pool Worker"), pool(pool) {}
+
+AudioThreadPool::Worker::~Worker() {
+    stopThread(1000);
+}
+
+void AudioThreadPool::Worker::run() {
+    uint32_t seenGeneration = pool.generation.load();
+
+    while (!threadShouldExit()) {
+        {
+            std::unique_lock<std::mutex> lock(pool.wakeMutex);
+            pool.wake.wait_for(lock, std::chrono::milliseconds(10), [this, seenGeneration] {
+                return threadShouldExit() || pool.generation.load() != seenGeneration;
+            });
+        }
+
+        seenGeneration = pool.generation.load();
+        pool.runJobs(seenGeneration);
+    }
+}
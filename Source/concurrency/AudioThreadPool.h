@@ -0,0 +1,46 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// A small pool of threads that the audio thread can hand work to, e.g. to
+// render several voices at once. The calling thread always takes part in
+// running the jobs, so run() finishes even if no workers wake up in time,
+// and it doesn't allocate or take any locks.
+class AudioThreadPool {
+public:
+    AudioThreadPool(int numThreads);
+    ~AudioThreadPool();
+
+    // Runs job(0) ... job(numJobs - 1) across the pool and the calling thread,
+    // returning once all of them have finished. Must not be called concurrently.
+    void run(int numJobs, const std::function<void(int)>& job);
+
+    int getNumThreads();
+
+private:
+    class Worker : public juce::Thread {
+    public:
+        Worker(AudioThreadPool& pool);
+        ~Worker() override;
+
+        void run() override;
+
+    private:
+        AudioThreadPool& pool;
+    };
+
+    void runJobs(uint32_t generation);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    // the generation of the current batch in the high 32 bits, and the index
+    // of the next job to claim in the low 32 bits
+    std::atomic<uint64_t> nextJob = 0;
+    std::atomic<uint32_t> generation = 0;
+    std::atomic<int> numJobs = 0;
+    std::atomic<int> jobsRemaining = 0;
+    const std::function<void(int)>* job = nullptr;
+
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// A bounded multi-producer, multi-consumer queue that never blocks or
+// allocates after construction, so it can be pushed to from the audio
+// thread. Pushing to a full queue fails rather than waiting.
+//
+// Each slot has a sequence number recording whether it is ready to be
+// written or read for the current lap around the ring.
+template <typename T>
+class LockFreeQueue {
+public:
+    LockFreeQueue(size_t minCapacity) {
+        capacity = 1;
+        while (capacity < minCapacity) {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        slots = std::make_unique<Slot[]>(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(const T& value) {
+        Slot* slot;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // the slot hasn't been read since the last lap, so we're full
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = value;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& value) {
+        Slot* slot;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) (pos + 1);
+            if (diff == 0) {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        value = slot->value;
+        slot->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t getCapacity() {
+        return capacity;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    size_t capacity;
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+
+    // kept on separate cache lines so producers and the consumer don't contend
+    alignas(64) std::atomic<size_t> enqueuePos = 0;
+    alignas(64) std::atomic<size_t> dequeuePos = 0;
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+};
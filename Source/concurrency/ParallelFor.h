@@ -0,0 +1,189 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The threads that parallelFor hands jobs to. They are kept for as long as
+// the pool exists, as parallelFor is called for every frame and for small
+// batches of work, where starting threads each time would cost more than the
+// work itself.
+//
+// Only one pool exists at a time, and it is shared by holding it in a
+// juce::SharedResourcePointer, so that its threads are stopped when the last
+// plugin instance is deleted rather than when the program exits, which isn't
+// safe to do while a plugin's library is being unloaded. The pool has to
+// outlive anything that calls parallelFor while it is held, and parallelFor
+// runs serially when no pool exists.
+class ParallelForPool {
+public:
+    // one parallelFor call that the pool's threads are helping with
+    struct Batch {
+        int numJobs;
+        const std::function<void(int)>& job;
+        std::atomic<int> nextJob = 0;
+        std::exception_ptr exception;
+        std::atomic<bool> failed = false;
+        // threads that have been asked to help and haven't finished yet,
+        // guarded by the pool's mutex
+        int helpers = 0;
+
+        Batch(int numJobs, const std::function<void(int)>& job) : numJobs(numJobs), job(job) {}
+
+        void runJobs() {
+            for (int i = nextJob++; i < numJobs; i = nextJob++) {
+                try {
+                    job(i);
+                } catch (...) {
+                    if (!failed.exchange(true)) {
+                        exception = std::current_exception();
+                    }
+                }
+            }
+        }
+    };
+
+    ParallelForPool() : ParallelForPool((int) std::max(1u, std::thread::hardware_concurrency()) - 1) {}
+
+    // the pool that currently exists, or nullptr if there isn't one
+    static ParallelForPool* getInstance() {
+        return instance;
+    }
+
+    ~ParallelForPool() {
+        instance = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // Runs the batch on the calling thread and up to maxHelpers of the pool's
+    // threads, returning once every job has finished.
+    void run(Batch& batch, int maxHelpers) {
+        int numHelpers = reserveThreads(maxHelpers);
+
+        if (numHelpers > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            batch.helpers = numHelpers;
+            for (int i = 0; i < numHelpers; i++) {
+                queue.push_back(&batch);
+            }
+        }
+        if (numHelpers > 1) {
+            work.notify_all();
+        } else if (numHelpers == 1) {
+            work.notify_one();
+        }
+
+        batch.runJobs();
+
+        if (numHelpers > 0) {
+            std::unique_lock<std::mutex> lock(mutex);
+            // every job has been claimed, so threads that haven't picked the
+            // batch up yet aren't needed
+            for (auto it = queue.begin(); it != queue.end();) {
+                if (*it == &batch) {
+                    it = queue.erase(it);
+                    batch.helpers--;
+                } else {
+                    it++;
+                }
+            }
+            finished.wait(lock, [&batch] { return batch.helpers == 0; });
+        }
+
+        spareThreads += numHelpers;
+    }
+
+private:
+    ParallelForPool(int numThreads) : spareThreads(numThreads) {
+        for (int i = 0; i < numThreads; i++) {
+            threads.emplace_back([this] { workerLoop(); });
+        }
+        instance = this;
+    }
+
+    // All calls share the pool's threads, so a parallel loop inside another
+    // parallel loop runs serially rather than waiting for threads that are
+    // busy with the outer loop.
+    int reserveThreads(int wanted) {
+        int available = spareThreads.load();
+        while (available > 0 && wanted > 0) {
+            int reserved = std::min(available, wanted);
+            if (spareThreads.compare_exchange_weak(available, available - reserved)) {
+                return reserved;
+            }
+        }
+        return 0;
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+
+            Batch* batch = queue.front();
+            queue.pop_front();
+
+            lock.unlock();
+            batch->runJobs();
+            lock.lock();
+
+            if (--batch->helpers == 0) {
+                finished.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> threads;
+    std::atomic<int> spareThreads;
+
+    std::mutex mutex;
+    std::condition_variable work;
+    std::condition_variable finished;
+    std::deque<Batch*> queue;
+    bool stopping = false;
+
+    static inline std::atomic<ParallelForPool*> instance = nullptr;
+};
+
+// Runs job(0) ... job(numJobs - 1) across several threads, including the
+// calling thread, and returns once they have all finished. Each job should
+// write its result to its own slot so that the output doesn't depend on
+// which thread ran it.
+//
+// The jobs run on the ParallelForPool's threads, which are shared by all
+// calls, so a parallel loop inside another parallel loop runs serially rather
+// than oversubscribing. If a job throws, the first exception is rethrown once
+// every job has finished.
+inline void parallelFor(int numJobs, const std::function<void(int)>& job) {
+    if (numJobs <= 0) {
+        return;
+    }
+
+    ParallelForPool::Batch batch(numJobs, job);
+    ParallelForPool* pool = ParallelForPool::getInstance();
+    if (numJobs == 1 || pool == nullptr) {
+        batch.runJobs();
+    } else {
+        pool->run(batch, numJobs - 1);
+    }
+
+    if (batch.exception != nullptr) {
+        std::rethrow_exception(batch.exception);
+    }
+}
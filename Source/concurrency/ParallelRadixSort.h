@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Sorts keys that only use their lowest `bits` bits with a least significant
+// digit radix sort. Each pass counts and then scatters fixed-size chunks of
+// keys in parallel, and chunks are written in order so the result doesn't
+// depend on the number of threads.
+inline void parallelRadixSort(std::vector<uint64_t>& keys, int bits) {
+    const int DIGIT_BITS = 8;
+    const int NUM_BUCKETS = 1 << DIGIT_BITS;
+    const size_t CHUNK_SIZE = 1 << 16;
+
+    size_t n = keys.size();
+    int numChunks = (int) ((n + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::vector<uint64_t> buffer(n);
+    // counts[chunk * NUM_BUCKETS + bucket]
+    std::vector<size_t> counts((size_t) numChunks * NUM_BUCKETS);
+
+    for (int shift = 0; shift < bits; shift += DIGIT_BITS) {
+        std::fill(counts.begin(), counts.end(), 0);
+
+        parallelFor(numChunks, [&](int chunk) {
+            size_t* count = &counts[(size_t) chunk * NUM_BUCKETS];
+            size_t end = std::min(n, (chunk + 1) * CHUNK_SIZE);
+            for (size_t i = chunk * CHUNK_SIZE; i < end; i++) {
+                count[(keys[i] >> shift) & (NUM_BUCKETS - 1)]++;
+            }
+        });
+
+        // turn the counts into the position each chunk starts writing each bucket to
+        size_t offset = 0;
+        for (int bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+            for (int chunk = 0; chunk < numChunks; chunk++) {
+                size_t& count = counts[(size_t) chunk * NUM_BUCKETS + bucket];
+                size_t bucketSize = count;
+                count = offset;
+                offset += bucketSize;
+            }
+        }
+
+        parallelFor(numChunks, [&](int chunk) {
+            size_t* position = &counts[(size_t) chunk * NUM_BUCKETS];
+            size_t end = std::min(n, (chunk + 1) * CHUNK_SIZE);
+            for (size_t i = chunk * CHUNK_SIZE; i < end; i++) {
+                buffer[position[(keys[i] >> shift) & (NUM_BUCKETS - 1)]++] = keys[i];
+            }
+        });
+
+        keys.swap(buffer);
+    }
+}
@@ -1,33 +1,325 @@
 #include "LineArtParser.h"
+#include "../concurrency/ParallelFor.h"
+
+// Binary tags are 8 characters padded with spaces, stored in a 64-bit word,
+// so they're compared as the integers they're read as.
+static constexpr int64_t makeTag(const char (&name)[9]) {
+    uint64_t tag = 0;
+    for (int i = 7; i >= 0; i--) {
+        tag = tag << 8 | (uint8_t) name[i];
+    }
+    return (int64_t) tag;
+}
+
+static constexpr int64_t GPLA_TAG = makeTag("GPLA    ");
+static constexpr int64_t FILE_TAG = makeTag("FILE    ");
+static constexpr int64_t FRAME_TAG = makeTag("FRAME   ");
+static constexpr int64_t FOCAL_LENGTH_TAG = makeTag("focalLen");
+static constexpr int64_t OBJECTS_TAG = makeTag("OBJECTS ");
+static constexpr int64_t OBJECT_TAG = makeTag("OBJECT  ");
+static constexpr int64_t MATRIX_TAG = makeTag("MATRIX  ");
+static constexpr int64_t STROKES_TAG = makeTag("STROKES ");
+static constexpr int64_t STROKE_TAG = makeTag("STROKE  ");
+static constexpr int64_t VERTEX_COUNT_TAG = makeTag("vertexCt");
+static constexpr int64_t VERTICES_TAG = makeTag("VERTICES");
+static constexpr int64_t DONE_TAG = makeTag("DONE    ");
+static constexpr int64_t END_TAG = makeTag("END GPLA");
+
+// The compact format is major version 3, as earlier versions of the Blender
+// add-on already wrote version 2 in the original format. It is
+// little-endian throughout:
+//
+//   "GPLA    ", then the major, minor and patch versions as 64-bit integers
+//   uint32 flags, where bit 0 means vertices are quantised to 16 bits
+//   uint32 frame count
+//   uint32 frame rate
+//   uint64 offset of each frame from the start of the file, then the end of
+//   the last frame
+//
+// Each frame is its uint32 size once decompressed, a uint8 compression
+// method (0 for none, 1 for zlib), then its contents:
+//
+//   float focal length
+//   varint object count
+//   for each object:
+//     uint8 flags, where bit 0 means the matrix is the same as in an earlier
+//     frame and bit 1 means the strokes are
+//     the varint frame the matrix is stored in if bit 0 is set, otherwise
+//     the top three rows of the matrix as 12 floats
+//     the varint frame the strokes are stored in if bit 1 is set, otherwise:
+//       if quantised, the smallest x, y and z, and the size of a step in x,
+//       y and z, as 6 floats
+//       varint stroke count
+//       for each stroke, a varint vertex count and its vertices, either as
+//       3 floats each, or if quantised as how many steps each of x, y and z
+//       moved from the last vertex of the object, as zigzag varints
+//
+// Varints are 7 bits at a time, lowest first, with the top bit set on every
+// byte but the last. Reused matrices and strokes always refer to the frame
+// that they're stored in, so that a frame never needs more than one earlier
+// frame for each object to be decoded.
+static const int COMPACT_VERSION = 3;
+static const int QUANTISED = 1;
+static const int SAME_MATRIX = 1;
+static const int SAME_STROKES = 2;
+static const int ZLIB = 1;
+
+class CompactReader {
+public:
+    CompactReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    template <typename T>
+    T read() {
+        T value{};
+        if (size - position < sizeof(T)) {
+            failed = true;
+            return value;
+        }
+        std::memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    juce::uint64 readVarint() {
+        juce::uint64 value = 0;
+        for (int shift = 0; shift < 64 && position < size; shift += 7) {
+            uint8_t byte = data[position++];
+            value |= (juce::uint64) (byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+
+    juce::int64 readSignedVarint() {
+        juce::uint64 value = readVarint();
+        return (juce::int64) (value >> 1) ^ -(juce::int64) (value & 1);
+    }
+
+    size_t remaining() {
+        return size - position;
+    }
+
+    bool failed = false;
+
+private:
+    const uint8_t* data;
+    size_t size;
+    size_t position = 0;
+};
+
+struct CompactObject {
+    int flags = 0;
+    // the frames that the matrix and strokes are stored in, if they're reused
+    juce::uint64 matrixFrame = 0;
+    juce::uint64 strokesFrame = 0;
+    std::vector<double> matrix;
+    std::vector<std::vector<OsciPoint>> strokes;
+};
+
+static bool isCompact(const char* data, size_t size) {
+    juce::int64 version = 0;
+    if (size >= 16) {
+        std::memcpy(&version, data + 8, sizeof(version));
+    }
+    return size >= 16 && std::memcmp(data, "GPLA    ", 8) == 0 && version == COMPACT_VERSION;
+}
 
+static bool readCompactChunk(const char* chunk, size_t chunkSize, std::vector<uint8_t>& contents) {
+    CompactReader reader((const uint8_t*) chunk, chunkSize);
+    juce::uint32 contentsSize = reader.read<juce::uint32>();
+    uint8_t method = reader.read<uint8_t>();
+    if (reader.failed) {
+        return false;
+    }
+    const char* payload = chunk + 5;
+    size_t payloadSize = chunkSize - 5;
 
-LineArtParser::LineArtParser(juce::String json) {
-    frames.clear();
-    numFrames = 0;
-    frames = parseJsonFrames(json);
-    numFrames = frames.size();
+    if (method == 0) {
+        if (payloadSize != contentsSize) {
+            return false;
+        }
+        contents.assign(payload, payload + payloadSize);
+        return true;
+    } else if (method == ZLIB) {
+        // zlib can't shrink anything by more than about 1000 times, so a
+        // bigger size means the frame is broken
+        if (contentsSize > payloadSize * 1032 + 64) {
+            return false;
+        }
+        contents.resize(contentsSize);
+        juce::MemoryInputStream input(payload, payloadSize, false);
+        juce::GZIPDecompressorInputStream decompressor(&input, false, juce::GZIPDecompressorInputStream::zlibFormat, contentsSize);
+        return contentsSize == 0 || decompressor.read(contents.data(), (int) contentsSize) == (int) contentsSize;
+    }
+    return false;
 }
 
-LineArtParser::LineArtParser(char* data, int dataLength) {
-    frames.clear();
-    numFrames = 0;
-    frames = parseBinaryFrames(data, dataLength);
-    numFrames = frames.size();
-    if (numFrames == 0) frames = epicFail();
+static bool readCompactStrokes(CompactReader& reader, bool quantised, std::vector<std::vector<OsciPoint>>& strokes) {
+    float origin[3] = {};
+    float step[3] = {};
+    if (quantised) {
+        for (auto& value : origin) {
+            value = reader.read<float>();
+        }
+        for (auto& value : step) {
+            value = reader.read<float>();
+        }
+    }
+
+    // every stroke takes at least a byte, and every vertex at least three
+    juce::uint64 numStrokes = reader.readVarint();
+    if (reader.failed || numStrokes > reader.remaining()) {
+        return false;
+    }
+    strokes.reserve(numStrokes);
+
+    juce::int64 steps[3] = {};
+    for (juce::uint64 i = 0; i < numStrokes; i++) {
+        juce::uint64 numVertices = reader.readVarint();
+        if (reader.failed || numVertices > reader.remaining() / 3) {
+            return false;
+        }
+        if (numVertices == 0) {
+            continue;
+        }
+
+        auto& stroke = strokes.emplace_back();
+        stroke.reserve(numVertices);
+        for (juce::uint64 j = 0; j < numVertices; j++) {
+            if (quantised) {
+                for (auto& value : steps) {
+                    // quantised vertices are 16 bits, so can't move further than this
+                    juce::int64 difference = reader.readSignedVarint();
+                    if (difference < -65535 || difference > 65535) {
+                        return false;
+                    }
+                    value += difference;
+                }
+                stroke.emplace_back(origin[0] + steps[0] * (double) step[0], origin[1] + steps[1] * (double) step[1], origin[2] + steps[2] * (double) step[2]);
+            } else {
+                double x = reader.read<float>();
+                double y = reader.read<float>();
+                double z = reader.read<float>();
+                stroke.emplace_back(x, y, z);
+            }
+        }
+    }
+    return !reader.failed;
+}
+
+static bool readCompactObjects(const std::vector<uint8_t>& contents, bool quantised, double& focalLength, std::vector<CompactObject>& objects) {
+    CompactReader reader(contents.data(), contents.size());
+    focalLength = reader.read<float>();
+
+    // every object takes at least a byte
+    juce::uint64 numObjects = reader.readVarint();
+    if (reader.failed || numObjects > reader.remaining()) {
+        return false;
+    }
+    objects.resize(numObjects);
+
+    for (auto& object : objects) {
+        object.flags = reader.read<uint8_t>();
+        if (object.flags & SAME_MATRIX) {
+            object.matrixFrame = reader.readVarint();
+        } else {
+            // the bottom row isn't used when drawing
+            object.matrix.assign(16, 0);
+            for (int i = 0; i < 12; i++) {
+                object.matrix[i] = reader.read<float>();
+            }
+            object.matrix[15] = 1;
+        }
+        if (object.flags & SAME_STROKES) {
+            object.strokesFrame = reader.readVarint();
+        } else if (!readCompactStrokes(reader, quantised, object.strokes)) {
+            return false;
+        }
+        if (reader.failed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LineArtParser::LineArtParser(juce::String json) : LineArtParser(std::make_shared<juce::MemoryBlock>(json.toRawUTF8(), json.getNumBytesAsUTF8())) {}
+
+LineArtParser::LineArtParser(std::shared_ptr<juce::MemoryBlock> data) : juce::Thread("Line Art Decoder"), data(data) {
+    const char tag[] = "GPLA    ";
+    binary = data->getSize() >= 8 && memcmp(data->getData(), tag, 8) == 0;
+
+    if (binary && isCompact((const char*) data->getData(), data->getSize())) {
+        compact = true;
+        if (indexCompactFrames((const char*) data->getData(), data->getSize(), compactFrames) && compactFrames.offsets.size() > 1) {
+            numFrames = compactFrames.offsets.size() - 1;
+        } else {
+            useFrames(epicFail());
+        }
+    } else if (binary) {
+        if (indexBinaryFrames((int64_t*) data->getData(), data->getSize() / 8, binaryFrames) && !binaryFrames.empty()) {
+            numFrames = binaryFrames.size();
+        } else {
+            useFrames(epicFail());
+        }
+    } else {
+        indexJson();
+    }
+
+    // fallback animations are already decoded
+    if (this->data != nullptr) {
+        startThread();
+    }
+}
+
+LineArtParser::LineArtParser(std::vector<std::vector<Line>> frames) : juce::Thread("Line Art Decoder") {
+    useFrames(std::move(frames));
 }
 
 LineArtParser::~LineArtParser() {
-    frames.clear();
+    signalThreadShouldExit();
+    notify();
+    stopThread(1000);
 }
 
-double LineArtParser::makeDouble(int64_t data) {
-    return *(double*)&data;
+void LineArtParser::useFrames(std::vector<std::vector<Line>> frames) {
+    data = nullptr;
+    this->frames.clear();
+    for (auto& frame : frames) {
+        this->frames.push_back(std::make_shared<const std::vector<Line>>(std::move(frame)));
+    }
+    numFrames = this->frames.size();
 }
 
-void LineArtParser::makeChars(int64_t data, char* chars) {
-    for (int i = 0; i < 8; i++) {
-        chars[i] = (data >> (i * 8)) & 0xFF;
+void LineArtParser::indexJson() {
+    // Files without any frames are parsed whole, which picks the right
+    // fallback depending on whether the file is valid JSON
+    if (!indexJsonFrames((const char*) data->getData(), data->getSize(), jsonFrames) || jsonFrames.empty()) {
+        useFrames(parseJsonFrames(juce::String::fromUTF8((const char*) data->getData(), data->getSize())));
+        return;
+    }
+    numFrames = jsonFrames.size();
+
+    // Frames without objects or a focal length are empty. If no frame at the
+    // start is valid, the file is probably invalid, so the invalid fallback
+    // is parsed instead once every frame has been checked. The first valid
+    // frame is cached as it'll be drawn straight away.
+    for (int f = 0; f < numFrames; f++) {
+        auto frame = std::make_shared<const std::vector<Line>>(decodeFrame(f));
+        if (frame->size() > 0) {
+            cache[0] = { f, frame, ++useCount };
+            return;
+        }
     }
+    useFrames(parseJsonFrames(juce::String(BinaryData::invalid_gpla, BinaryData::invalid_gplaSize)));
+}
+
+double LineArtParser::makeDouble(int64_t data) {
+    double value;
+    std::memcpy(&value, &data, sizeof(value));
+    return value;
 }
 
 std::vector<std::vector<Line>> LineArtParser::epicFail() {
@@ -35,211 +327,323 @@ std::vector<std::vector<Line>> LineArtParser::epicFail() {
 }
 
 std::vector<std::vector<Line>> LineArtParser::parseBinaryFrames(char* bytes, int bytesLength) {
-    int64_t* data = (int64_t*)bytes;
+    if (isCompact(bytes, bytesLength)) {
+        CompactIndex index;
+        if (!indexCompactFrames(bytes, bytesLength, index)) return epicFail();
+
+        std::vector<std::vector<Line>> tFrames(index.offsets.size() - 1);
+        parallelFor((int) tFrames.size(), [&](int f) {
+            readCompactFrame(bytes, bytesLength, index, f, tFrames[f]);
+        });
+        return tFrames;
+    }
+
+    const int64_t* data = (int64_t*)bytes;
     int dataLength = bytesLength / 8;
-    std::vector<std::vector<Line>> tFrames;
+    std::vector<int> frameStarts;
+    if (!indexBinaryFrames(data, dataLength, frameStarts)) return epicFail();
+
+    // the structure of every frame has been checked, so each can be decoded
+    // on its own
+    std::vector<std::vector<Line>> tFrames(frameStarts.size());
+    parallelFor((int) frameStarts.size(), [&](int f) {
+        int index = frameStarts[f];
+        readBinaryFrame(data, dataLength, index, &tFrames[f]);
+    });
+    return tFrames;
+}
 
-    if (dataLength < 4) return epicFail();
+bool LineArtParser::indexBinaryFrames(const int64_t* data, int dataLength, std::vector<int>& frameStarts) {
+    frameStarts.clear();
+    if (dataLength < 4) return false;
 
     int index = 0;
-    int64_t rawData = data[index];
-    index++;
-
-    char tag[9] = "        ";
-    makeChars(rawData, tag);
-
-    if (strcmp(tag, "GPLA    ") != 0) return epicFail();
-
-    // Major
-    if (index >= dataLength) return epicFail();
-    rawData = data[index];
-    index++;
-    // Minor
-    if (index >= dataLength) return epicFail();
-    rawData = data[index];
-    index++;
-    // Patch
-    if (index >= dataLength) return epicFail();
-    rawData = data[index];
-    index++;
-
-    if (index >= dataLength) return epicFail();
-    rawData = data[index];
-    index++;
-    makeChars(rawData, tag);
-    if (strcmp(tag, "FILE    ") != 0) return epicFail();
-
-    int reportedNumFrames = 0;
-    int frameRate = 0;
-
-    if (index >= dataLength) return epicFail();
-    rawData = data[index];
-    index++;
-    makeChars(rawData, tag);
-
-    while (strcmp(tag, "DONE    ") != 0) {
-        if (index >= dataLength) return epicFail();
-        rawData = data[index];
+    if (data[index++] != GPLA_TAG) return false;
+
+    // major, minor and patch versions
+    index += 3;
+
+    if (index >= dataLength) return false;
+    if (data[index++] != FILE_TAG) return false;
+
+    if (index >= dataLength) return false;
+    int64_t tag = data[index++];
+
+    // the file's settings, such as fCount and fRate, which aren't used
+    while (tag != DONE_TAG) {
         index++;
+        if (index >= dataLength) return false;
+        tag = data[index++];
+    }
+
+    if (index >= dataLength) return false;
+    tag = data[index++];
 
-        if (strcmp(tag, "fCount  ") == 0) {
-            reportedNumFrames = rawData;
-        } else if (strcmp(tag, "fRate   ") == 0) {
-            frameRate = rawData;
+    while (tag != END_TAG) {
+        if (tag == FRAME_TAG) {
+            frameStarts.push_back(index);
+            if (!readBinaryFrame(data, dataLength, index, nullptr)) return false;
         }
+        if (index >= dataLength) return false;
+        tag = data[index++];
+    }
+    return true;
+}
 
-        if (index >= dataLength) return epicFail();
-        rawData = data[index];
-        index++;
-        makeChars(rawData, tag);
-    }
-
-    if (index >= dataLength) return epicFail();
-    rawData = data[index];
-    index++;
-    makeChars(rawData, tag);
-    
-    while (strcmp(tag, "END GPLA") != 0) {
-        if (strcmp(tag, "FRAME   ") == 0) {
-            if (index >= dataLength) return epicFail();
-            rawData = data[index];
-            index++;
-            makeChars(rawData, tag);
-
-            double focalLength;
-            std::vector<std::vector<double>> allMatrices;
-            std::vector<std::vector<std::vector<OsciPoint>>> allVertices;
-            while (strcmp(tag, "OBJECTS ") != 0) {
-                if (index >= dataLength) return epicFail();
-                rawData = data[index];
-                index++;
-
-                if (strcmp(tag, "focalLen") == 0) {
-                    focalLength = makeDouble(rawData);
-                }
+bool LineArtParser::readBinaryFrame(const int64_t* data, int dataLength, int& index, std::vector<Line>* frame) {
+    if (index >= dataLength) return false;
+    int64_t tag = data[index++];
 
-                if (index >= dataLength) return epicFail();
-                rawData = data[index];
-                index++;
-                makeChars(rawData, tag);
-            }
+    double focalLength = 0;
+    while (tag != OBJECTS_TAG) {
+        if (index >= dataLength) return false;
+        int64_t value = data[index++];
+
+        if (tag == FOCAL_LENGTH_TAG) {
+            focalLength = makeDouble(value);
+        }
+
+        if (index >= dataLength) return false;
+        tag = data[index++];
+    }
 
-            if (index >= dataLength) return epicFail();
-            rawData = data[index];
-            index++;
-            makeChars(rawData, tag);
-            
-            while (strcmp(tag, "DONE    ") != 0) {
-                if (strcmp(tag, "OBJECT  ") == 0) {
-                    std::vector<std::vector<OsciPoint>> vertices;
-                    std::vector<double> matrix;
-                    if (index >= dataLength) return epicFail();
-                    int strokeNum = 0;
-                    rawData = data[index];
-                    index++;
-                    makeChars(rawData, tag);
-                    while (strcmp(tag, "DONE    ") != 0) {
-                        if (strcmp(tag, "MATRIX  ") == 0) {
-                            matrix.clear();
-                            for (int i = 0; i < 16; i++) {
-                                if (index >= dataLength) return epicFail();
-                                rawData = data[index];
-                                index++;
-                                matrix.push_back(makeDouble(rawData));
+    std::vector<std::vector<double>> allMatrices;
+    std::vector<std::vector<std::vector<OsciPoint>>> allVertices;
+    // vertices are copied here in bulk before being turned into points
+    std::vector<double> coordinates;
+
+    if (index >= dataLength) return false;
+    tag = data[index++];
+
+    while (tag != DONE_TAG) {
+        if (tag == OBJECT_TAG) {
+            std::vector<std::vector<OsciPoint>> vertices;
+            std::vector<double> matrix;
+            if (index >= dataLength) return false;
+            tag = data[index++];
+            while (tag != DONE_TAG) {
+                if (tag == MATRIX_TAG) {
+                    if (index + 16 >= dataLength) return false;
+                    matrix.resize(16);
+                    std::memcpy(matrix.data(), data + index, 16 * sizeof(double));
+                    // skip the matrix's DONE tag
+                    index += 17;
+                } else if (tag == STROKES_TAG) {
+                    if (index >= dataLength) return false;
+                    tag = data[index++];
+
+                    while (tag != DONE_TAG) {
+                        if (tag == STROKE_TAG) {
+                            if (frame != nullptr) {
+                                vertices.emplace_back();
                             }
-                            if (index >= dataLength) return epicFail();
-                            rawData = data[index];
-                            index++;
-                        } else if (strcmp(tag, "STROKES ") == 0) {
-                            if (index >= dataLength) return epicFail();
-                            rawData = data[index];
-                            index++;
-                            makeChars(rawData, tag);
-
-                            while (strcmp(tag, "DONE    ") != 0) {
-                                if (strcmp(tag, "STROKE  ") == 0) {
-                                    vertices.push_back(std::vector<OsciPoint>());
-                                    if (index >= dataLength) return epicFail();
-                                    rawData = data[index];
-                                    index++;
-                                    makeChars(rawData, tag);
-
-                                    int vertexCount = 0;
-                                    while (strcmp(tag, "DONE    ") != 0) {
-                                        if (strcmp(tag, "vertexCt") == 0) {
-                                            if (index >= dataLength) return epicFail();
-                                            rawData = data[index];
-                                            index++;
-                                            vertexCount = rawData;
+                            if (index >= dataLength) return false;
+                            tag = data[index++];
+
+                            int64_t vertexCount = 0;
+                            while (tag != DONE_TAG) {
+                                if (tag == VERTEX_COUNT_TAG) {
+                                    if (index >= dataLength) return false;
+                                    vertexCount = data[index++];
+                                } else if (tag == VERTICES_TAG) {
+                                    vertexCount = std::max((int64_t) 0, vertexCount);
+                                    if (vertexCount > (dataLength - index) / 3) return false;
+                                    if (frame != nullptr) {
+                                        coordinates.resize(3 * vertexCount);
+                                        std::memcpy(coordinates.data(), data + index, 3 * vertexCount * sizeof(double));
+                                        auto& stroke = vertices.back();
+                                        stroke.reserve(stroke.size() + vertexCount);
+                                        for (int64_t i = 0; i < 3 * vertexCount; i += 3) {
+                                            stroke.emplace_back(coordinates[i], coordinates[i + 1], coordinates[i + 2]);
                                         }
-                                        else if (strcmp(tag, "VERTICES") == 0) {
-                                            double x = 0;
-                                            double y = 0;
-                                            double z = 0;
-                                            for (int i = 0; i < vertexCount; i++) {
-                                                if (index + 2 >= dataLength) return epicFail();
-                                                rawData = data[index];
-                                                index++;
-                                                x = makeDouble(rawData);
-
-                                                rawData = data[index];
-                                                index++;
-                                                y = makeDouble(rawData);
-
-                                                rawData = data[index];
-                                                index++;
-                                                z = makeDouble(rawData);
-
-                                                vertices[strokeNum].push_back(OsciPoint(x, y, z));
-                                            }
-                                            if (index >= dataLength) return epicFail();
-                                            rawData = data[index];
-                                            index++;
-                                            makeChars(rawData, tag);
-                                            while (strcmp(tag, "DONE    ") != 0) {
-                                                if (index >= dataLength) return epicFail();
-                                                rawData = data[index];
-                                                index++;
-                                                makeChars(rawData, tag);
-                                            }
-                                        }
-                                        if (index >= dataLength) return epicFail();
-                                        rawData = data[index];
-                                        index++;
-                                        makeChars(rawData, tag);
                                     }
-                                    strokeNum++;
+                                    // when only the structure is being checked, the vertices are skipped
+                                    index += 3 * vertexCount;
+
+                                    if (index >= dataLength) return false;
+                                    tag = data[index++];
+                                    while (tag != DONE_TAG) {
+                                        if (index >= dataLength) return false;
+                                        tag = data[index++];
+                                    }
                                 }
-                                if (index >= dataLength) return epicFail();
-                                rawData = data[index];
-                                index++;
-                                makeChars(rawData, tag);
+                                if (index >= dataLength) return false;
+                                tag = data[index++];
                             }
                         }
-                        if (index >= dataLength) return epicFail();
-                        rawData = data[index];
-                        index++;
-                        makeChars(rawData, tag);
+                        if (index >= dataLength) return false;
+                        tag = data[index++];
                     }
-                    allVertices.push_back(reorderVertices(vertices));
-                    allMatrices.push_back(matrix);
-                    vertices.clear();
-                    matrix.clear();
                 }
-                if (index >= dataLength) return epicFail();
-                rawData = data[index];
-                index++;
-                makeChars(rawData, tag);
+                if (index >= dataLength) return false;
+                tag = data[index++];
+            }
+            if (frame != nullptr) {
+                allVertices.push_back(std::move(vertices));
+                allMatrices.push_back(std::move(matrix));
             }
-            std::vector<Line> frame = assembleFrame(allVertices, allMatrices, focalLength);
-            tFrames.push_back(frame);
         }
-        if (index >= dataLength) return epicFail();
-        rawData = data[index];
-        index++;
-        makeChars(rawData, tag);
+        if (index >= dataLength) return false;
+        tag = data[index++];
     }
-    return tFrames;
+
+    if (frame != nullptr) {
+        // ordering the strokes is the slowest part, so objects are ordered
+        // in parallel
+        parallelFor((int) allVertices.size(), [&](int i) {
+            allVertices[i] = reorderVertices(std::move(allVertices[i]));
+        });
+        *frame = assembleFrame(allVertices, allMatrices, focalLength);
+    }
+    return true;
+}
+
+bool LineArtParser::indexCompactFrames(const char* data, size_t size, CompactIndex& index) {
+    if (!isCompact(data, size)) return false;
+
+    // after the tag and the versions
+    CompactReader reader((const uint8_t*) data + 32, size - juce::jmin(size, (size_t) 32));
+    juce::uint32 flags = reader.read<juce::uint32>();
+    juce::uint32 numFrames = reader.read<juce::uint32>();
+    // the frame rate, which isn't used
+    reader.read<juce::uint32>();
+    if (reader.failed || numFrames >= reader.remaining() / 8) return false;
+
+    index.quantised = flags & QUANTISED;
+    index.offsets.resize(numFrames + 1);
+    for (auto& offset : index.offsets) {
+        offset = reader.read<juce::uint64>();
+    }
+
+    // frames have to be in order, and big enough for their size and method
+    juce::uint64 end = 44 + 8 * (juce::uint64) index.offsets.size();
+    for (juce::uint32 i = 0; i < numFrames; i++) {
+        if (index.offsets[i] < end || index.offsets[i + 1] < index.offsets[i] + 5) return false;
+        end = index.offsets[i + 1];
+    }
+    return end <= size;
+}
+
+bool LineArtParser::readCompactFrame(const char* data, size_t size, const CompactIndex& index, int frame, std::vector<Line>& lines) {
+    auto readFrame = [&](juce::uint64 f, double& focalLength, std::vector<CompactObject>& objects) {
+        std::vector<uint8_t> contents;
+        return readCompactChunk(data + index.offsets[f], index.offsets[f + 1] - index.offsets[f], contents)
+            && readCompactObjects(contents, index.quantised, focalLength, objects);
+    };
+
+    double focalLength;
+    std::vector<CompactObject> objects;
+    if (!readFrame(frame, focalLength, objects)) return false;
+
+    // earlier frames that this frame reuses parts of, each read only once
+    std::map<juce::uint64, std::vector<CompactObject>> earlierFrames;
+    auto findStored = [&](juce::uint64 f, int object, int part) -> CompactObject* {
+        if (f >= (juce::uint64) frame) return nullptr;
+        auto earlier = earlierFrames.find(f);
+        if (earlier == earlierFrames.end()) {
+            double unused;
+            std::vector<CompactObject> earlierObjects;
+            if (!readFrame(f, unused, earlierObjects)) {
+                earlierObjects.clear();
+            }
+            earlier = earlierFrames.emplace(f, std::move(earlierObjects)).first;
+        }
+        if (object >= (int) earlier->second.size() || (earlier->second[object].flags & part)) return nullptr;
+        return &earlier->second[object];
+    };
+
+    std::vector<std::vector<double>> allMatrices;
+    std::vector<std::vector<std::vector<OsciPoint>>> allVertices;
+    for (int i = 0; i < objects.size(); i++) {
+        auto& object = objects[i];
+        if (object.flags & SAME_MATRIX) {
+            auto stored = findStored(object.matrixFrame, i, SAME_MATRIX);
+            if (stored == nullptr) return false;
+            object.matrix = stored->matrix;
+        }
+        if (object.flags & SAME_STROKES) {
+            auto stored = findStored(object.strokesFrame, i, SAME_STROKES);
+            if (stored == nullptr) return false;
+            object.strokes = std::move(stored->strokes);
+        }
+        allMatrices.push_back(std::move(object.matrix));
+        allVertices.push_back(std::move(object.strokes));
+    }
+
+    parallelFor((int) allVertices.size(), [&](int i) {
+        allVertices[i] = reorderVertices(std::move(allVertices[i]));
+    });
+    lines = assembleFrame(allVertices, allMatrices, focalLength);
+    return true;
+}
+
+bool LineArtParser::indexJsonFrames(const char* text, size_t length, std::vector<juce::Range<size_t>>& frameRanges) {
+    frameRanges.clear();
+
+    // depth of objects and arrays, ignoring anything in strings
+    int depth = 0;
+    bool inString = false;
+    size_t stringStart = 0;
+    // whether the last string in the top level object was "frames", and
+    // whether we're in the frames array
+    bool framesKey = false;
+    bool inFrames = false;
+    bool foundFrames = false;
+    // where the frame we're in started, if we're in one
+    bool inFrame = false;
+    size_t frameStart = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (inString) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                inString = false;
+                if (depth == 1) {
+                    framesKey = i - stringStart == 6 && memcmp(text + stringStart, "frames", 6) == 0;
+                }
+            }
+            continue;
+        }
+
+        if (inFrames && depth == 2 && !inFrame && !std::isspace((unsigned char) c) && c != ',' && c != ']') {
+            inFrame = true;
+            frameStart = i;
+        }
+
+        if (c == '"') {
+            inString = true;
+            stringStart = i + 1;
+        } else if (c == '{' || c == '[') {
+            if (depth == 1 && c == '[' && framesKey) {
+                inFrames = true;
+                foundFrames = true;
+            }
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+            if (depth < 0) {
+                return false;
+            }
+            if (inFrames && depth == 1) {
+                inFrames = false;
+                if (inFrame) {
+                    frameRanges.push_back({ frameStart, i });
+                    inFrame = false;
+                }
+            }
+        } else if (c == ',') {
+            if (depth == 1) {
+                framesKey = false;
+            } else if (inFrames && depth == 2 && inFrame) {
+                frameRanges.push_back({ frameStart, i });
+                inFrame = false;
+            }
+        }
+    }
+
+    return foundFrames && depth == 0 && !inString;
 }
 
 std::vector<std::vector<Line>> LineArtParser::parseJsonFrames(juce::String jsonStr) {
@@ -307,16 +711,119 @@ std::vector<std::vector<Line>> LineArtParser::parseJsonFrames(juce::String jsonS
     return frames;
 }
 
+std::vector<Line> LineArtParser::parseJsonFrame(const juce::var& jsonFrame) {
+    auto objectsVar = jsonFrame.getProperty("objects", juce::Array<juce::var>());
+    juce::var focalLengthVar = jsonFrame.getProperty("focalLength", juce::var());
+
+    // Ensure that there actually are objects and that the focal length is defined
+    if (objectsVar.getArray() == nullptr || objectsVar.getArray()->size() == 0 || focalLengthVar.isVoid()) {
+        return std::vector<Line>();
+    }
+    return generateFrame(*objectsVar.getArray(), focalLengthVar);
+}
+
+std::vector<Line> LineArtParser::decodeFrame(int frame) {
+    if (compact) {
+        // frames that are broken are drawn empty
+        std::vector<Line> lines;
+        readCompactFrame((const char*) data->getData(), data->getSize(), compactFrames, frame, lines);
+        return lines;
+    } else if (binary) {
+        std::vector<Line> lines;
+        int index = binaryFrames[frame];
+        readBinaryFrame((int64_t*) data->getData(), data->getSize() / 8, index, &lines);
+        return lines;
+    }
+
+    const char* text = (const char*) data->getData();
+    auto range = jsonFrames[frame];
+    return parseJsonFrame(juce::JSON::parse(juce::String::fromUTF8(text + range.getStart(), range.getLength())));
+}
+
 void LineArtParser::setFrame(int fNum) {
     // Ensure that the frame number is within the bounds of the number of frames
     // This weird modulo trick is to handle negative numbers
     frameNumber = (numFrames + (fNum % numFrames)) % numFrames;
 }
 
+int LineArtParser::getNumFrames() {
+    return numFrames;
+}
+
+std::shared_ptr<const std::vector<Line>> LineArtParser::findCached(int frame) {
+    juce::SpinLock::ScopedLockType scope(cacheLock);
+    for (auto& cached : cache) {
+        if (cached.frame == frame) {
+            cached.lastUsed = ++useCount;
+            return cached.lines;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const std::vector<Line>> LineArtParser::getFrame(int frame) {
+    if (data == nullptr) {
+        return frames[frame];
+    }
+
+    auto lines = findCached(frame);
+    if (lines != nullptr) {
+        return lines;
+    }
+
+    lines = std::make_shared<const std::vector<Line>>(decodeFrame(frame));
+    juce::SpinLock::ScopedLockType scope(cacheLock);
+    // another thread may have decoded the frame in the meantime
+    for (auto& cached : cache) {
+        if (cached.frame == frame) {
+            return cached.lines;
+        }
+    }
+    CachedFrame* oldest = &cache[0];
+    for (auto& cached : cache) {
+        if (cached.lastUsed < oldest->lastUsed) {
+            oldest = &cached;
+        }
+    }
+    *oldest = { frame, lines, ++useCount };
+    return lines;
+}
+
+void LineArtParser::run() {
+    while (!threadShouldExit()) {
+        int frame = requested.exchange(-1);
+        if (frame == -1) {
+            wait(-1);
+            continue;
+        }
+
+        // decode the frames that will be drawn next, unless a different
+        // frame is requested in the meantime
+        int frameStep = step;
+        for (int i = 1; i <= PREFETCH && requested == -1 && !threadShouldExit(); i++) {
+            getFrame(((frame + i * frameStep) % numFrames + numFrames) % numFrames);
+        }
+    }
+}
+
 std::vector<std::unique_ptr<Shape>> LineArtParser::draw() {
+    int frame = frameNumber;
+    if (data != nullptr && frame != lastFrame) {
+        // the animation rate decides how far the frame moves between draws,
+        // and moving by more than half the animation is wrapping around
+        int difference = frame - lastFrame;
+        if (std::abs(difference) > numFrames / 2) {
+            difference -= difference > 0 ? numFrames : -numFrames;
+        }
+        step = difference;
+        lastFrame = frame;
+        requested = frame;
+        notify();
+    }
+
 	std::vector<std::unique_ptr<Shape>> tempShapes;
 	
-	for (Line shape : frames[frameNumber]) {
+	for (Line shape : *getFrame(frame)) {
 		tempShapes.push_back(shape.clone());
 	}
     return tempShapes;
@@ -355,13 +862,9 @@ std::vector<std::vector<OsciPoint>> LineArtParser::reorderVertices(std::vector<s
             endPoint = vertices[minPath].back();
         }
 
+        reorderedVertices.reserve(vertices.size());
         for (int i = 0; i < vertices.size(); i++) {
-            std::vector<OsciPoint> reorderedVertex;
-            int index = order[i];
-            for (int j = 0; j < vertices[index].size(); j++) {
-                reorderedVertex.push_back(vertices[index][j]);
-            }
-            reorderedVertices.push_back(reorderedVertex);
+            reorderedVertices.push_back(std::move(vertices[order[i]]));
         }
     }
     return reorderedVertices;
@@ -393,12 +896,12 @@ std::vector<Line> LineArtParser::generateFrame(juce::Array <juce::var> objects,
             allMatrices[i].push_back(value);
         }
 
-        allVertices.push_back(reorderVertices(vertices));
+        allVertices.push_back(reorderVertices(std::move(vertices)));
     }
     return assembleFrame(allVertices, allMatrices, focalLength);
 }
 
-std::vector<Line> LineArtParser::assembleFrame(std::vector<std::vector<std::vector<OsciPoint>>> allVertices, std::vector<std::vector<double>> allMatrices, double focalLength) {
+std::vector<Line> LineArtParser::assembleFrame(const std::vector<std::vector<std::vector<OsciPoint>>>& allVertices, const std::vector<std::vector<double>>& allMatrices, double focalLength) {
     // generate a frame from the vertices and matrix
     std::vector<Line> frame;
 
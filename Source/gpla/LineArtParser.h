@@ -2,29 +2,102 @@
 #include "../shape/OsciPoint.h"
 #include <JuceHeader.h>
 #include "../shape/Shape.h"
-#include "../svg/SvgParser.h"
 #include "../shape/Line.h"
 
-class LineArtParser {
+// Plays a Grease Pencil line art animation exported from Blender, in the
+// JSON, binary or compact binary GPLA format.
+//
+// Opening a file only finds where each frame starts, and frames are decoded
+// when they are drawn into a small cache. The frames that playback is heading
+// towards are decoded ahead of time on a background thread, so long
+// animations open quickly and never have to be in memory all at once.
+class LineArtParser : private juce::Thread {
 public:
 	LineArtParser(juce::String json);
-	LineArtParser(char* data, int dataLength);
-	~LineArtParser();
+	LineArtParser(std::shared_ptr<juce::MemoryBlock> data);
+	LineArtParser(std::vector<std::vector<Line>> frames);
+	~LineArtParser() override;
 
 	void setFrame(int fNum);
 	std::vector<std::unique_ptr<Shape>> draw();
+	int getNumFrames();
 
 	static std::vector<std::vector<Line>> parseJsonFrames(juce::String jsonStr);
 	static std::vector<std::vector<Line>> parseBinaryFrames(char* data, int dataLength);
 
 	static std::vector<Line> generateFrame(juce::Array < juce::var> objects, double focalLength);
 private:
+	// frames that are kept decoded
+	static const int CACHE_SIZE = 32;
+	// frames that are decoded ahead of the one being drawn
+	static const int PREFETCH = 8;
+
+	struct CachedFrame {
+		int frame = -1;
+		std::shared_ptr<const std::vector<Line>> lines;
+		juce::uint32 lastUsed = 0;
+	};
+
+	// where each frame of a compact file is, from its offset table
+	struct CompactIndex {
+		bool quantised = false;
+		// the offset of each frame, followed by the end of the last frame
+		std::vector<juce::uint64> offsets;
+	};
+
 	static std::vector<std::vector<Line>> epicFail();
 	static double makeDouble(int64_t data);
-	static void makeChars(int64_t data, char* chars);
 	static std::vector<std::vector<OsciPoint>> reorderVertices(std::vector<std::vector<OsciPoint>> vertices);
-	static std::vector<Line> assembleFrame(std::vector<std::vector<std::vector<OsciPoint>>> allVertices, std::vector<std::vector<double>> allMatrices, double focalLength);
-	int frameNumber = 0;
-	std::vector<std::vector<Line>> frames;
+	static std::vector<Line> assembleFrame(const std::vector<std::vector<std::vector<OsciPoint>>>& allVertices, const std::vector<std::vector<double>>& allMatrices, double focalLength);
+
+	// Finds where each frame of a binary file starts, checking the structure
+	// of the whole file without decoding any vertices. Returns false if the
+	// file is broken.
+	static bool indexBinaryFrames(const int64_t* data, int dataLength, std::vector<int>& frameStarts);
+	// Reads the frame whose FRAME tag is just before index, leaving index
+	// after the end of the frame. The frame is only decoded if frame isn't
+	// nullptr. Returns false if the file ends first.
+	static bool readBinaryFrame(const int64_t* data, int dataLength, int& index, std::vector<Line>* frame);
+	// Finds the start and end of each frame in the frames array of a JSON
+	// file, without parsing them. Returns false if there is no frames array.
+	static bool indexJsonFrames(const char* text, size_t length, std::vector<juce::Range<size_t>>& frameRanges);
+	// Reads the header and offset table of a compact file, checking that
+	// every frame is inside the file. Returns false if the file is broken.
+	static bool indexCompactFrames(const char* data, size_t size, CompactIndex& index);
+	// Decodes a frame of a compact file, along with the parts of earlier
+	// frames that it reuses. Returns false if the frame is broken.
+	static bool readCompactFrame(const char* data, size_t size, const CompactIndex& index, int frame, std::vector<Line>& lines);
+	// an empty frame if the JSON frame is missing its objects or focal length
+	static std::vector<Line> parseJsonFrame(const juce::var& frame);
+
+	void indexJson();
+	void useFrames(std::vector<std::vector<Line>> frames);
+	std::vector<Line> decodeFrame(int frame);
+	// returns the frame from the cache, decoding it if it isn't there
+	std::shared_ptr<const std::vector<Line>> getFrame(int frame);
+	std::shared_ptr<const std::vector<Line>> findCached(int frame);
+	void run() override;
+
+	std::atomic<int> frameNumber = 0;
 	int numFrames = 0;
+
+	// the file, and where each of its frames are
+	std::shared_ptr<juce::MemoryBlock> data;
+	bool binary = false;
+	std::vector<int> binaryFrames;
+	bool compact = false;
+	CompactIndex compactFrames;
+	std::vector<juce::Range<size_t>> jsonFrames;
+	// frames that are always in memory, such as the fallback animations
+	std::vector<std::shared_ptr<const std::vector<Line>>> frames;
+
+	juce::SpinLock cacheLock;
+	std::vector<CachedFrame> cache = std::vector<CachedFrame>(CACHE_SIZE);
+	juce::uint32 useCount = 0;
+
+	// the last frame drawn, and how far the frame moved since the one before
+	int lastFrame = -1;
+	std::atomic<int> step = 1;
+	// the frame to decode ahead of, or -1 if there's nothing to decode
+	std::atomic<int> requested = -1;
 };
@@ -0,0 +1,222 @@
+#include "FrameDecoder.h"
+
+FrameDecoder::FrameDecoder(const juce::String& threadName) : juce::Thread(threadName) {}
+
+FrameDecoder::~FrameDecoder() {
+    stopDecoding();
+}
+
+void FrameDecoder::startDecoding(int numFrames, int width, int height, int readAhead, bool live) {
+    this->numFrames = numFrames;
+    this->width = width;
+    this->height = height;
+    this->readAhead = readAhead;
+    this->live = live;
+    if (numFrames == 0) {
+        return;
+    }
+
+    // the frame being shown, the frames read ahead, and one being decoded
+    // into, with a spare so that there is always a slot to reuse
+    slots.resize(readAhead + 3);
+    for (auto& slot : slots) {
+        slot.pixels.resize(width * height);
+    }
+
+    // the first frame is needed straight away
+    if (decodeFrame(0, slots[0].pixels.data()) || !live) {
+        slots[0].frame = 0;
+    }
+
+    startThread();
+}
+
+void FrameDecoder::stopDecoding() {
+    signalThreadShouldExit();
+    notify();
+    stopThread(1000);
+}
+
+bool FrameDecoder::isStopping() {
+    return threadShouldExit();
+}
+
+bool FrameDecoder::isDecoderThread() {
+    return juce::Thread::getCurrentThread() == this;
+}
+
+int FrameDecoder::getNumFrames() {
+    return numFrames;
+}
+
+int FrameDecoder::getWidth() {
+    return width;
+}
+
+int FrameDecoder::getHeight() {
+    return height;
+}
+
+bool FrameDecoder::isLive() {
+    return live;
+}
+
+int FrameDecoder::findSlot(int frame) {
+    for (int i = 0; i < slots.size(); i++) {
+        if (slots[i].frame == frame) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int FrameDecoder::claimSlot() {
+    int slot = -1;
+    for (int i = 0; i < slots.size(); i++) {
+        // live frames that are being shown or haven't been shown yet are kept
+        bool needed = i == pinned || (live && slots[i].frame >= shown);
+        if (!needed && (slot == -1 || slots[i].lastUsed < slots[slot].lastUsed)) {
+            slot = i;
+        }
+    }
+    if (slot != -1) {
+        slots[slot].frame = -1;
+    }
+    return slot;
+}
+
+const uint8_t* FrameDecoder::getFrame(int index) {
+    if (numFrames == 0) {
+        return nullptr;
+    }
+
+    const uint8_t* pixels = nullptr;
+    if (live) {
+        bool advanced = false;
+        {
+            juce::SpinLock::ScopedLockType scope(lock);
+            if (index != lastIndex && shown < latest) {
+                shown++;
+                advanced = true;
+            }
+            lastIndex = index;
+            int slot = findSlot(shown);
+            if (slot != -1) {
+                pinned = slot;
+                slots[slot].lastUsed = ++useCount;
+                pixels = slots[slot].pixels.data();
+            }
+        }
+        // there is room to read another frame
+        if (advanced) {
+            notify();
+        }
+        return pixels;
+    }
+
+    if (index != lastIndex) {
+        int difference = index - lastIndex;
+        // moving by more than half the animation is wrapping around the end
+        if (std::abs(difference) > numFrames / 2) {
+            difference = -difference;
+        }
+        direction = difference > 0 ? 1 : -1;
+        lastIndex = index;
+    }
+    int ahead = (index + readAhead * direction % numFrames + numFrames) % numFrames;
+
+    bool aheadCached;
+    {
+        juce::SpinLock::ScopedLockType scope(lock);
+        int slot = findSlot(index);
+        if (slot != -1) {
+            pinned = slot;
+            slots[slot].lastUsed = ++useCount;
+            pixels = slots[slot].pixels.data();
+        }
+        aheadCached = findSlot(ahead) != -1;
+    }
+
+    if (pixels == nullptr || !aheadCached) {
+        if (requested.exchange(index) != index) {
+            notify();
+        }
+    }
+    return pixels;
+}
+
+bool FrameDecoder::copyFrame(int index, std::vector<uint8_t>& pixels) {
+    juce::SpinLock::ScopedLockType scope(lock);
+    int slot = findSlot(live ? shown : index);
+    if (slot == -1) {
+        return false;
+    }
+    pixels = slots[slot].pixels;
+    return true;
+}
+
+void FrameDecoder::run() {
+    if (live) {
+        readLive();
+        return;
+    }
+
+    while (!threadShouldExit()) {
+        int index = requested.exchange(-1);
+        if (index == -1) {
+            wait(-1);
+            continue;
+        }
+
+        // decode the requested frame and the frames after it, unless a
+        // different frame is requested in the meantime
+        int step = direction;
+        for (int i = 0; i <= readAhead && requested == -1 && !threadShouldExit(); i++) {
+            int frame = ((index + i * step) % numFrames + numFrames) % numFrames;
+            int slot;
+            {
+                juce::SpinLock::ScopedLockType scope(lock);
+                if (findSlot(frame) != -1) {
+                    continue;
+                }
+                slot = claimSlot();
+            }
+            if (slot == -1) {
+                break;
+            }
+
+            // a frame that can't be decoded is still cached, so that it
+            // isn't decoded again for every sample
+            decodeFrame(frame, slots[slot].pixels.data());
+
+            juce::SpinLock::ScopedLockType scope(lock);
+            slots[slot].frame = frame;
+            slots[slot].lastUsed = ++useCount;
+        }
+    }
+}
+
+void FrameDecoder::readLive() {
+    while (!threadShouldExit()) {
+        int slot = -1;
+        {
+            juce::SpinLock::ScopedLockType scope(lock);
+            if (latest - shown < readAhead) {
+                slot = claimSlot();
+            }
+        }
+        if (slot == -1) {
+            wait(-1);
+            continue;
+        }
+
+        if (!decodeFrame(latest + 1, slots[slot].pixels.data())) {
+            // the end of the stream, so the last frame stays on screen
+            break;
+        }
+
+        juce::SpinLock::ScopedLockType scope(lock);
+        slots[slot].frame = ++latest;
+        slots[slot].lastUsed = ++useCount;
+    }
+}
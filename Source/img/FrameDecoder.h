@@ -0,0 +1,92 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Decodes the frames of an animation on demand on a background thread, so
+// that only a few frames are ever in memory however long the animation is.
+//
+// Decoded frames are kept in a small least recently used cache. Frames that
+// aren't cached are decoded in the background, along with the frames after
+// them in the direction the animation is playing, so that playback rarely
+// has to wait.
+//
+// Live sources, such as pipes, can't seek. Their frames are read into the
+// cache as they arrive, up to the read ahead limit, and each time getFrame
+// is asked for a different frame it moves on to the next one that was read.
+class FrameDecoder : private juce::Thread {
+public:
+    FrameDecoder(const juce::String& threadName);
+    ~FrameDecoder() override;
+
+    // 0 if the frames couldn't be read, and 1 for live sources
+    int getNumFrames();
+    int getWidth();
+    int getHeight();
+    bool isLive();
+
+    // Returns the frame's grayscale pixels, from top to bottom, if it has been
+    // decoded, or nullptr while it is decoded in the background. The pixels
+    // stay valid until the next call. Must only be called by one thread.
+    const uint8_t* getFrame(int index);
+    // Copies the pixels of a frame that has been decoded, from any thread.
+    // Live sources copy the frame that getFrame last returned.
+    bool copyFrame(int index, std::vector<uint8_t>& pixels);
+
+protected:
+    // Called by the derived class's constructor once it has found the frames,
+    // which decodes the first frame straight away and starts decoding the rest
+    // in the background. readAhead is how many frames past the one being shown
+    // are decoded.
+    void startDecoding(int numFrames, int width, int height, int readAhead, bool live = false);
+    // Must be called by the derived class's destructor, so that decodeFrame
+    // isn't called after the derived class is destroyed.
+    void stopDecoding();
+    // True once stopDecoding has been called, so that decodeFrame can give up
+    // on a frame that is taking a long time to arrive.
+    bool isStopping();
+    // True when called from the background thread that decodes frames.
+    bool isDecoderThread();
+
+    // Decodes a frame into width * height grayscale pixels, where 0 is
+    // reserved for transparent pixels. Live sources ignore the index and read
+    // the next frame. Returns false if the frame can't be decoded, which ends
+    // a live source, and otherwise shows whatever was left in pixels.
+    virtual bool decodeFrame(int index, uint8_t* pixels) = 0;
+
+private:
+    struct Slot {
+        std::vector<uint8_t> pixels;
+        // -1 when empty or being decoded into. Live frames are numbered in
+        // the order that they were read.
+        int frame = -1;
+        juce::uint32 lastUsed = 0;
+    };
+
+    void run() override;
+    void readLive();
+    int findSlot(int frame);
+    // claims the least recently used slot that isn't pinned, or -1 if none
+    int claimSlot();
+
+    int numFrames = 0;
+    int width = 0;
+    int height = 0;
+    int readAhead = 1;
+    bool live = false;
+
+    // guards which frame is in each slot, and which slot is pinned
+    juce::SpinLock lock;
+    std::vector<Slot> slots;
+    // the slot returned by the last call to getFrame, which isn't reused until it changes
+    int pinned = -1;
+    juce::uint32 useCount = 0;
+    std::atomic<int> requested = -1;
+    // 1 when playing forwards, and -1 when playing backwards
+    std::atomic<int> direction = 1;
+    int lastIndex = 0;
+    // the live frame being shown, and the newest live frame that has been read
+    int shown = 0;
+    int latest = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FrameDecoder)
+};
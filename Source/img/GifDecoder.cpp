@@ -0,0 +1,95 @@
+#include "GifDecoder.h"
+#include "gifdec.h"
+
+GifDecoder::GifDecoder(std::shared_ptr<juce::MemoryBlock> data) : FrameDecoder("GIF Decoder"), data(data) {
+    gif = gd_open_gif_memory(data->getData(), data->getSize());
+    if (gif == nullptr) {
+        return;
+    }
+
+    // count the frames without decoding them
+    int numFrames = 0;
+    while (gd_skip_frame(gif) > 0) {
+        numFrames++;
+    }
+    gd_rewind(gif);
+
+    // snapshots are as close together as the memory allows
+    size_t maxSnapshots = juce::jmax((size_t) 1, SNAPSHOT_MEMORY / gd_state_size(gif));
+    snapshotInterval = juce::jmax(1, (int) ((numFrames + maxSnapshots - 1) / maxSnapshots));
+    snapshots.resize(numFrames / snapshotInterval + 1);
+
+    rgb.resize(gif->width * gif->height * 3);
+    startDecoding(numFrames, gif->width, gif->height, 1);
+}
+
+GifDecoder::~GifDecoder() {
+    stopDecoding();
+    if (gif != nullptr) {
+        gd_close_gif(gif);
+    }
+}
+
+bool GifDecoder::decodeFrame(int index, uint8_t* pixels) {
+    // start from the nearest snapshot before the frame, if decoding on from
+    // the last frame would mean going backwards or decoding more frames
+    int snapshot = index / snapshotInterval;
+    while (snapshot > 0 && snapshots[snapshot].empty()) {
+        snapshot--;
+    }
+    int snapshotFrame = snapshot * snapshotInterval;
+    if (index < nextFrame || snapshotFrame > nextFrame) {
+        if (snapshot == 0) {
+            gd_rewind(gif);
+        } else {
+            gd_restore_state(gif, snapshots[snapshot].data());
+        }
+        nextFrame = snapshotFrame;
+    }
+
+    // each frame is drawn over the frames before it
+    while (nextFrame <= index) {
+        if (nextFrame > 0 && nextFrame % snapshotInterval == 0 && snapshots[nextFrame / snapshotInterval].empty()) {
+            auto& state = snapshots[nextFrame / snapshotInterval];
+            state.resize(gd_state_size(gif));
+            gd_save_state(gif, state.data());
+        }
+        if (gd_get_frame(gif) <= 0) {
+            // a broken frame, so show whatever has been drawn so far
+            gd_rewind(gif);
+            nextFrame = 0;
+            break;
+        }
+        nextFrame++;
+    }
+    gd_render_frame(gif, rgb.data());
+    toGrayscale(rgb, pixels, gif->width * gif->height);
+    return true;
+}
+
+void GifDecoder::toGrayscale(const std::vector<uint8_t>& rgb, uint8_t* pixels, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        uint8_t avg = (rgb[3 * i] + rgb[3 * i + 1] + rgb[3 * i + 2]) / 3;
+        // value of 0 is reserved for transparent pixels
+        pixels[i] = juce::jmax(1, (int) avg);
+    }
+}
+
+void GifDecoder::forEachFrame(const juce::MemoryBlock& data, std::function<bool(int index, const uint8_t* pixels)> callback) {
+    gd_GIF* gif = gd_open_gif_memory(data.getData(), data.getSize());
+    if (gif == nullptr) {
+        return;
+    }
+
+    size_t frameSize = gif->width * gif->height;
+    std::vector<uint8_t> rgb(frameSize * 3);
+    std::vector<uint8_t> pixels(frameSize);
+    for (int index = 0; gd_get_frame(gif) > 0; index++) {
+        gd_render_frame(gif, rgb.data());
+        toGrayscale(rgb, pixels.data(), frameSize);
+        if (!callback(index, pixels.data())) {
+            break;
+        }
+    }
+    gd_close_gif(gif);
+}
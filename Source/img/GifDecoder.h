@@ -0,0 +1,43 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "FrameDecoder.h"
+
+struct gd_GIF;
+
+// Decodes the frames of a GIF on demand, straight from the file's data.
+// GIF frames build on the ones before them, so the decoder is snapshotted
+// every few frames as it goes forwards. Going backwards, or jumping, decodes
+// from the nearest snapshot before the frame rather than from the start.
+class GifDecoder : public FrameDecoder {
+public:
+    GifDecoder(std::shared_ptr<juce::MemoryBlock> data);
+    ~GifDecoder() override;
+
+    // Decodes every frame in order, separately from any GifDecoder, passing
+    // each frame's grayscale pixels to callback. Stops early if callback
+    // returns false.
+    static void forEachFrame(const juce::MemoryBlock& data, std::function<bool(int index, const uint8_t* pixels)> callback);
+
+protected:
+    bool decodeFrame(int index, uint8_t* pixels) override;
+
+private:
+    static void toGrayscale(const std::vector<uint8_t>& rgb, uint8_t* pixels, size_t size);
+
+    std::shared_ptr<juce::MemoryBlock> data;
+    gd_GIF* gif = nullptr;
+    // the frame that the decoder will read next, only used by the decoding thread
+    int nextFrame = 0;
+    std::vector<uint8_t> rgb;
+
+    // the most memory that snapshots of the decoder can use
+    static const size_t SNAPSHOT_MEMORY = 64 * 1024 * 1024;
+    // snapshots[i] is the decoder before frame i * snapshotInterval is
+    // decoded, or empty if it hasn't got that far yet. The first is never
+    // used, as that is the same as rewinding.
+    std::vector<std::vector<uint8_t>> snapshots;
+    int snapshotInterval = 1;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GifDecoder)
+};
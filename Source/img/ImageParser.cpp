@@ -1,82 +1,74 @@
 #include "ImageParser.h"
-#include "gifdec.h"
 #include "../PluginProcessor.h"
+#include "../concurrency/ParallelFor.h"
+#include "ImageTracer.h"
 
-ImageParser::ImageParser(OscirenderAudioProcessor& p, juce::String extension, juce::MemoryBlock image) : audioProcessor(p) {
-    juce::TemporaryFile temp{".gif"};
-    juce::File file = temp.getFile();
-
-    {
-        juce::FileOutputStream output(file);
-
-        if (output.openedOk()) {
-            output.write(image.getData(), image.getSize());
-            output.flush();
-        }
-    }
-    
+ImageParser::ImageParser(OscirenderAudioProcessor& p, juce::String extension, std::shared_ptr<juce::MemoryBlock> image) : audioProcessor(p), data(image) {
     if (extension.equalsIgnoreCase(".gif")) {
-        juce::String fileName = file.getFullPathName();
-        gd_GIF *gif = gd_open_gif(fileName.toRawUTF8());
-
-        if (gif != nullptr) {
-            width = gif->width;
-            height = gif->height;
-            int frameSize = width * height;
-            std::vector<uint8_t> tempBuffer = std::vector<uint8_t>(frameSize * 3);
-            visited = std::vector<bool>(frameSize, false);
-
-            int i = 0;
-            while (gd_get_frame(gif) > 0) {
-                gd_render_frame(gif, tempBuffer.data());
-
-                frames.emplace_back(std::vector<uint8_t>(frameSize));
-
-                uint8_t *pixels = tempBuffer.data();
-                for (int j = 0; j < tempBuffer.size(); j += 3) {
-                    uint8_t avg = (pixels[j] + pixels[j + 1] + pixels[j + 2]) / 3;
-                    // value of 0 is reserved for transparent pixels
-                    frames[i][j / 3] = juce::jmax(1, (int) avg);
-                }
-
-                i++;
-            }
+        // frames are decoded when they're needed, rather than all at once
+        decoder = std::make_unique<GifDecoder>(image);
+    } else if (VideoStream::isVideoFile(extension)) {
+        // videos are too big to load, so only their path is stored
+        decoder = std::make_unique<VideoStream>(juce::File(image->toString()));
+        video = true;
+    }
 
-            gd_close_gif(gif);
-        }
+    if (decoder != nullptr) {
+        numFrames = decoder->getNumFrames();
+        width = decoder->getWidth();
+        height = decoder->getHeight();
     } else {
-        juce::Image image = juce::ImageFileFormat::loadFrom(file);
-        image.desaturate();
+        juce::Image loaded = juce::ImageFileFormat::loadFrom(image->getData(), image->getSize());
+        loaded.desaturate();
         
-        width = image.getWidth();
-        height = image.getHeight();
+        width = loaded.getWidth();
+        height = loaded.getHeight();
         int frameSize = width * height;
         
-        visited = std::vector<bool>(frameSize, false);
-        frames.emplace_back(std::vector<uint8_t>(frameSize));
+        still = std::vector<uint8_t>(frameSize);
+        numFrames = frameSize > 0 ? 1 : 0;
         
         for (int x = 0; x < width; x++) {
             for (int y = 0; y < height; y++) {
-                juce::Colour pixel = image.getPixelAt(x, y);
+                juce::Colour pixel = loaded.getPixelAt(x, y);
                 int index = y * width + x;
                 // RGB should be equal since we have desaturated
                 int value = pixel.getRed();
                 // value of 0 is reserved for transparent pixels
-                frames[0][index] = pixel.isTransparent() ? 0 : juce::jmax(1, value);
+                still[index] = pixel.isTransparent() ? 0 : juce::jmax(1, value);
             }
         }
     }
     
-    if (frames.size() == 0) {
-        juce::MessageManager::callAsync([this] {
-            juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::AlertIconType::WarningIcon, "Invalid GIF", "The image could not be loaded. Please try optimising the GIF with https://ezgif.com/optimize.");
+    if (numFrames == 0) {
+        // this runs on a parsing thread, and the parser may be gone by the
+        // time the message thread shows the alert, so only strings are captured
+        juce::String title = video ? "Invalid video" : "Invalid GIF";
+        juce::String message = video
+            ? "The video could not be loaded. Only 8-bit YUV4MPEG2 (.y4m) and raw grayscale (.gray) videos are supported."
+            : "The image could not be loaded. Please try optimising the GIF with https://ezgif.com/optimize.";
+        juce::MessageManager::callAsync([title, message] {
+            juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::AlertIconType::WarningIcon, title, message);
         });
         
+        decoder = nullptr;
+        video = false;
         width = 1;
         height = 1;
-        frames.emplace_back(std::vector<uint8_t>(1));
+        numFrames = 1;
+        still = std::vector<uint8_t>(1);
     }
 
+    // the sampler copies the pixels on its own thread, which is stopped
+    // before the decoder is destroyed
+    sampler = std::make_unique<ImageSampler>(width, height, [this](int frame, std::vector<uint8_t>& pixels) {
+        if (decoder != nullptr) {
+            return decoder->copyFrame(frame, pixels);
+        }
+        pixels = still;
+        return true;
+    });
+    traces.resize(video ? 1 : numFrames);
     setFrame(0);
 }
 
@@ -85,92 +77,145 @@ ImageParser::~ImageParser() {}
 void ImageParser::setFrame(int index) {
     // Ensure that the frame number is within the bounds of the number of frames
     // This weird modulo trick is to handle negative numbers
-    frameIndex = (frames.size() + (index % frames.size())) % frames.size();
-    resetPosition();
-    std::fill(visited.begin(), visited.end(), false);
-}
-
-bool ImageParser::isOverThreshold(double pixel, double thresholdPow) {
-    float threshold = std::pow(pixel, thresholdPow);
-    return pixel > 0.2 && rng.nextFloat() < threshold;
-}
-
-void ImageParser::resetPosition() {
-    currentX = width > 0 ? rng.nextInt(width) : 0;
-    currentY = height > 0 ? rng.nextInt(height) : 0;
-}
-
-float ImageParser::getPixelValue(int x, int y, bool invert) {
-    int index = (height - y - 1) * width + x;
-    if (index < 0 || index >= frames[frameIndex].size()) {
-        return 0;
-    }
-    float pixel = frames[frameIndex][index] / (float) std::numeric_limits<uint8_t>::max();
-    // never traverse transparent pixels
-    if (invert && pixel > 0) {
-        pixel = 1 - pixel;
-    }
-    return pixel;
-}
-
-void ImageParser::findWhite(double thresholdPow, bool invert) {
-    for (int i = 0; i < 100; i++) {
-        resetPosition();
-        if (isOverThreshold(getPixelValue(currentX, currentY, invert), thresholdPow)) {
-            break;
-        }
+    // Live videos move on whenever the index changes, so it isn't wrapped
+    frameIndex = decoder != nullptr && decoder->isLive() ? index : (numFrames + (index % numFrames)) % numFrames;
+    // keep showing the last frame until this one has been decoded
+    if (decoder != nullptr && decoder->getFrame(frameIndex) == nullptr) {
+        return;
     }
+    // the pixels are grouped in the background when the frame changes
+    sampler->setFrame(frameIndex);
 }
 
 int ImageParser::jumpFrequency() {
     return audioProcessor.currentSampleRate * 0.005;
 }
 
-void ImageParser::findNearestNeighbour(int searchRadius, float thresholdPow, int stride, bool invert) {
-    int spiralSteps[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
-    int maxSteps = 2 * searchRadius; // Maximum steps outwards in the spiral
-    int x = currentX;
-    int y = currentY;
-    int dir = rng.nextInt(4);
-
-    for (int len = 1; len <= maxSteps; len++) { // Length of spiral arm
-        for (int i = 0 ; i < 2; i++) { // Repeat twice for each arm length
-            for (int step = 0 ; step < len; step++) { // Steps in the current direction
-                x += stride * spiralSteps[dir][0];
-                y += stride * spiralSteps[dir][1];
-
-                if (x < 0 || x >= width || y < 0 || y >= height) break;
-                
-                float pixel = getPixelValue(x, y, invert);
-
-                int index = (height - y - 1) * width + x;
-                if (isOverThreshold(pixel, thresholdPow) && !visited[index]) {
-                    visited[index] = true;
-                    currentX = x;
-                    currentY = y;
-                    return;
+void ImageParser::startTracing(int level, bool invert) {
+    juce::uint32 generation = ++traceGeneration;
+    std::weak_ptr<ImageParser> weakParser = weak_from_this();
+    auto& audioProcessor = this->audioProcessor;
+    auto data = this->data;
+    bool isGif = decoder != nullptr;
+    // a still image is traced from its pixels, as it isn't decoded again
+    std::vector<uint8_t> still = isGif ? std::vector<uint8_t>() : this->still;
+    int width = this->width;
+    int height = this->height;
+    int numFrames = this->numFrames;
+
+    audioProcessor.fileParsingPool.addJob([weakParser, generation, &audioProcessor, data, isGif, still, width, height, numFrames, level, invert]() {
+        auto job = juce::ThreadPoolJob::getCurrentThreadPoolJob();
+        // hands a traced frame to the parser, or returns false if the
+        // tracing is stale, the parser has been deleted, or the pool is
+        // stopping
+        auto publish = [&](int index, const std::vector<Line>& lines) {
+            if (job->shouldExit()) {
+                return false;
+            }
+            auto parser = weakParser.lock();
+            if (parser == nullptr || parser->traceGeneration != generation) {
+                return false;
+            }
+            juce::SpinLock::ScopedLockType scope(parser->traceLock);
+            parser->traces[index] = lines;
+            return true;
+        };
+
+        juce::String type = "img-trace-" + juce::String(level) + (invert ? "-invert" : "");
+        juce::String key = audioProcessor.parseCache.getKey(*data, type, TRACE_VERSION);
+        std::vector<std::vector<Line>> frames;
+        if (audioProcessor.parseCache.load(key, frames) && frames.size() == numFrames) {
+            for (int i = 0; i < numFrames; i++) {
+                if (!publish(i, frames[i])) {
+                    break;
+                }
+            }
+            return juce::ThreadPoolJob::jobHasFinished;
+        }
+
+        double threshold = level / (double) TRACE_LEVELS;
+        frames.resize(numFrames);
+        bool finished = true;
+        if (isGif) {
+            // GIF frames have to be decoded in order, so they are decoded a
+            // batch at a time and each batch is traced in parallel
+            std::vector<std::vector<uint8_t>> batch;
+            int first = 0;
+            auto traceBatch = [&]() {
+                parallelFor((int) batch.size(), [&](int i) {
+                    frames[first + i] = traceOutlines(batch[i].data(), width, height, threshold, invert);
+                });
+                for (int i = 0; i < (int) batch.size() && finished; i++) {
+                    finished = publish(first + i, frames[first + i]);
                 }
+                first += batch.size();
+                batch.clear();
+                return finished;
+            };
+            GifDecoder::forEachFrame(*data, [&](int index, const uint8_t* pixels) {
+                if (index >= numFrames) {
+                    return false;
+                }
+                batch.emplace_back(pixels, pixels + width * height);
+                return batch.size() < TRACE_BATCH || traceBatch();
+            });
+            if (finished && !batch.empty()) {
+                traceBatch();
             }
+        } else {
+            frames[0] = traceOutlines(still.data(), width, height, threshold, invert);
+            finished = publish(0, frames[0]);
+        }
+
+        if (finished) {
+            audioProcessor.parseCache.store(key, frames);
+        }
+        return juce::ThreadPoolJob::jobHasFinished;
+    });
+}
 
-            dir = (dir + 1) % 4; // Change direction after finishing one leg of the spiral
+std::vector<std::unique_ptr<Shape>> ImageParser::draw() {
+    int level = juce::roundToInt(audioProcessor.imageThreshold->getActualValue() * TRACE_LEVELS);
+    bool invert = audioProcessor.invertImage->getBoolValue();
+    bool changed = level != traceLevel || invert != traceInvert;
+    traceLevel = level;
+    traceInvert = invert;
+
+    if (video) {
+        // only the frame being shown is decoded, so it is traced here
+        int index = frameIndex;
+        if ((changed || index != tracedFrame) && decoder->copyFrame(index, tracedPixels)) {
+            tracedFrame = index;
+            std::vector<Line> lines = traceOutlines(tracedPixels.data(), width, height, level / (double) TRACE_LEVELS, invert);
+            juce::SpinLock::ScopedLockType scope(traceLock);
+            traces[0] = std::move(lines);
         }
+    } else if (changed) {
+        startTracing(level, invert);
     }
 
-    findWhite(thresholdPow, invert);
+    std::vector<std::unique_ptr<Shape>> shapes;
+    juce::SpinLock::ScopedLockType scope(traceLock);
+    for (Line& line : traces[video ? 0 : frameIndex.load()]) {
+        shapes.push_back(line.clone());
+    }
+    return shapes;
 }
 
 OsciPoint ImageParser::getSample() {
     if (count % jumpFrequency() == 0) {
-        resetPosition();
-    }
-    
-    if (count % 10 * jumpFrequency() == 0) {
-        std::fill(visited.begin(), visited.end(), false);
+        sampler->jump();
     }
 
     float thresholdPow = audioProcessor.imageThreshold->getActualValue() * 10 + 1;
+    sampler->setThreshold(thresholdPow, audioProcessor.invertImage->getValue());
 
-    findNearestNeighbour(10, thresholdPow, audioProcessor.imageStride->getActualValue(), audioProcessor.invertImage->getValue());
+    // stay on the last pixel if nothing is bright enough to draw
+    int pixel = sampler->nextPixel(audioProcessor.imageStride->getActualValue());
+    if (pixel >= 0) {
+        currentX = pixel % width;
+        currentY = height - pixel / width - 1;
+    }
     float maxDim = juce::jmax(width, height);
     count++;
     float widthDiff = (maxDim - width) / 2;
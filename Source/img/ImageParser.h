@@ -4,30 +4,59 @@
 #include "../shape/Shape.h"
 #include "../svg/SvgParser.h"
 #include "../shape/Line.h"
+#include "GifDecoder.h"
+#include "VideoStream.h"
+#include "ImageSampler.h"
 
 class OscirenderAudioProcessor;
-class ImageParser {
+class ImageParser : public std::enable_shared_from_this<ImageParser> {
 public:
-	ImageParser(OscirenderAudioProcessor& p, juce::String fileName, juce::MemoryBlock image);
+	ImageParser(OscirenderAudioProcessor& p, juce::String fileName, std::shared_ptr<juce::MemoryBlock> image);
 	~ImageParser();
 
+	// must be incremented whenever the traced outlines of an image change
+	static const int TRACE_VERSION = 1;
+
 	void setFrame(int index);
 	OsciPoint getSample();
+	// Returns the traced outlines of the current frame. Every frame is traced
+	// in the background when the threshold or inversion changes, and the
+	// previous outlines are drawn until the new ones are ready. Videos are
+	// traced a frame at a time instead.
+	std::vector<std::unique_ptr<Shape>> draw();
 
 private:
-	void findNearestNeighbour(int searchRadius, float thresholdPow, int stride, bool invert);
-	void resetPosition();
-    float getPixelValue(int x, int y, bool invert);
-    void findWhite(double thresholdPow, bool invert);
-    bool isOverThreshold(double pixel, double thresholdValue);
+	// threshold steps that the image is traced at
+	static const int TRACE_LEVELS = 20;
+	// frames that are traced in parallel
+	static const int TRACE_BATCH = 16;
+
 	int jumpFrequency();
+	void startTracing(int level, bool invert);
 
 	OscirenderAudioProcessor& audioProcessor;
-	juce::Random rng;
-	int frameIndex = 0;
-	std::vector<std::vector<uint8_t>> frames;
-	std::vector<bool> visited;
-	int currentX, currentY;
+	std::shared_ptr<juce::MemoryBlock> data;
+	std::atomic<int> frameIndex = 0;
+	int numFrames = 0;
+	// decodes the frames of a GIF or video, or nullptr for a still image
+	std::unique_ptr<FrameDecoder> decoder;
+	// videos are traced a frame at a time as they play, rather than all at once
+	bool video = false;
+	// the pixels of a still image
+	std::vector<uint8_t> still;
+	std::unique_ptr<ImageSampler> sampler;
+	int currentX = 0, currentY = 0;
 	int width, height;
 	int count = 0;
+
+	// the threshold step and inversion of the latest tracing, only used by draw
+	int traceLevel = -1;
+	bool traceInvert = false;
+	// incremented for every tracing, so that stale ones stop
+	std::atomic<juce::uint32> traceGeneration = 0;
+	juce::SpinLock traceLock;
+	std::vector<std::vector<Line>> traces;
+	// the video frame that traces holds, and its pixels, only used by draw
+	int tracedFrame = -1;
+	std::vector<uint8_t> tracedPixels;
 };
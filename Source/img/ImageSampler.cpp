@@ -0,0 +1,276 @@
+#include "ImageSampler.h"
+
+// pixels this dark or darker are never drawn
+static const double MIN_BRIGHTNESS = 0.2;
+// how far the threshold can move before the tile weights are recalculated
+static const double THRESHOLD_TOLERANCE = 0.05;
+
+// The position of (x, y) along a Hilbert curve filling an n by n grid, where
+// n is a power of two. Neighbouring positions on the curve are always
+// neighbouring cells in the grid.
+static juce::uint32 hilbertIndex(juce::uint32 n, juce::uint32 x, juce::uint32 y) {
+    juce::uint32 index = 0;
+    for (juce::uint32 s = n / 2; s > 0; s /= 2) {
+        juce::uint32 rx = (x & s) > 0;
+        juce::uint32 ry = (y & s) > 0;
+        index += s * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+ImageSampler::ImageSampler(int width, int height, PixelSource source) : juce::Thread("Image Sampler"), width(width), height(height), source(source) {
+    startThread();
+}
+
+ImageSampler::~ImageSampler() {
+    signalThreadShouldExit();
+    notify();
+    stopThread(1000);
+}
+
+void ImageSampler::setFrame(int frame) {
+    if (requestedFrame.exchange(frame) != frame) {
+        notify();
+    }
+}
+
+void ImageSampler::setThreshold(double thresholdPow, bool invert) {
+    double requested = requestedThresholdPow.load(std::memory_order_relaxed);
+    if (requested >= 0 && invert == requestedInvert.load(std::memory_order_relaxed) && std::abs(thresholdPow - requested) < THRESHOLD_TOLERANCE) {
+        return;
+    }
+    requestedInvert = invert;
+    requestedThresholdPow = thresholdPow;
+    notify();
+}
+
+void ImageSampler::run() {
+    std::vector<uint8_t> pixels;
+    std::shared_ptr<const Frame> builtFrame;
+    int builtIndex = -1;
+    double builtThresholdPow = -1;
+    bool builtInvert = false;
+
+    while (!threadShouldExit()) {
+        int index = requestedFrame;
+        double thresholdPow = requestedThresholdPow;
+        bool invert = requestedInvert;
+
+        bool frameChanged = index != -1 && index != builtIndex;
+        if (frameChanged) {
+            if (!source(index, pixels)) {
+                // the frame was replaced before we got to it, so we wait for
+                // the drawing thread to ask for the one that replaced it
+                wait(10);
+                continue;
+            }
+            builtFrame = buildFrame(pixels, width, height);
+            builtIndex = index;
+        }
+
+        bool weightsChanged = thresholdPow != builtThresholdPow || invert != builtInvert;
+        if (builtFrame != nullptr && thresholdPow >= 0 && (frameChanged || weightsChanged)) {
+            builtThresholdPow = thresholdPow;
+            builtInvert = invert;
+            publish({ builtFrame, buildWeights(*builtFrame, thresholdPow, invert) });
+        } else if (!frameChanged) {
+            wait(-1);
+        }
+    }
+}
+
+void ImageSampler::publish(const Tables& newTables) {
+    // the tables this replaces in the back buffer are released here, rather
+    // than on the drawing thread
+    tables[back] = newTables;
+    back = middle.exchange(back | FRESH) & ~FRESH;
+}
+
+std::shared_ptr<const ImageSampler::Frame> ImageSampler::buildFrame(const std::vector<uint8_t>& pixels, int width, int height) {
+    auto frame = std::make_shared<Frame>();
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    int gridSize = juce::nextPowerOfTwo(juce::jmax(tilesX, tilesY));
+
+    // counting sort of the visible pixels by tile, then by brightness band
+    auto bucket = [&](int x, int y, uint8_t value) {
+        return BANDS * ((y / TILE_SIZE) * tilesX + x / TILE_SIZE) + value * BANDS / 256;
+    };
+    std::vector<juce::uint32> counts(BANDS * tilesX * tilesY, 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t value = pixels[y * width + x];
+            if (value > 0) {
+                counts[bucket(x, y, value)]++;
+            }
+        }
+    }
+
+    // order the tiles that have any visible pixels along the curve
+    std::vector<std::pair<juce::uint32, int>> order;
+    for (int i = 0; i < tilesX * tilesY; i++) {
+        juce::uint32 count = 0;
+        for (int band = 0; band < BANDS; band++) {
+            count += counts[BANDS * i + band];
+        }
+        if (count > 0) {
+            order.push_back({ hilbertIndex(gridSize, i % tilesX, i / tilesX), i });
+        }
+    }
+    std::sort(order.begin(), order.end());
+    int numTiles = order.size();
+    frame->numTiles = numTiles;
+
+    // counts then becomes where each bucket's next pixel goes
+    auto& starts = frame->starts;
+    starts.resize(BANDS * numTiles + 1);
+    juce::uint32 start = 0;
+    for (int i = 0; i < numTiles; i++) {
+        for (int band = 0; band < BANDS; band++) {
+            starts[BANDS * i + band] = start;
+            juce::uint32& count = counts[BANDS * order[i].second + band];
+            start += count;
+            count = starts[BANDS * i + band];
+        }
+    }
+    starts.back() = start;
+
+    frame->entries.resize(start);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t value = pixels[y * width + x];
+            if (value > 0) {
+                frame->entries[counts[bucket(x, y, value)]++] = y * width + x;
+            }
+        }
+    }
+
+    return frame;
+}
+
+std::shared_ptr<const ImageSampler::Weights> ImageSampler::buildWeights(const Frame& frame, double thresholdPow, bool invert) {
+    auto result = std::make_shared<Weights>();
+    Weights& w = *result;
+    int numTiles = frame.numTiles;
+    auto& starts = frame.starts;
+
+    for (int band = 0; band < BANDS; band++) {
+        double brightness = (band + 0.5) / BANDS;
+        if (invert) {
+            brightness = 1 - brightness;
+        }
+        w.bandWeights[band] = brightness > MIN_BRIGHTNESS ? std::pow(brightness, thresholdPow) : 0;
+    }
+
+    std::vector<double> tileWeights(numTiles);
+    w.totalWeight = 0;
+    for (int i = 0; i < numTiles; i++) {
+        double weight = 0;
+        for (int band = 0; band < BANDS; band++) {
+            weight += w.bandWeights[band] * (starts[BANDS * i + band + 1] - starts[BANDS * i + band]);
+        }
+        tileWeights[i] = weight;
+        w.totalWeight += weight;
+    }
+
+    // Vose's alias method, so that a tile can be chosen by weight in constant time
+    w.aliasProbability.assign(numTiles, 0);
+    w.alias.assign(numTiles, 0);
+    if (w.totalWeight > 0) {
+        std::vector<int> small, large;
+        int anyTile = 0;
+        for (int i = 0; i < numTiles; i++) {
+            tileWeights[i] *= numTiles / w.totalWeight;
+            (tileWeights[i] < 1 ? small : large).push_back(i);
+            if (tileWeights[i] > 0) {
+                anyTile = i;
+            }
+        }
+        while (!small.empty() && !large.empty()) {
+            int less = small.back();
+            int more = large.back();
+            small.pop_back();
+            large.pop_back();
+            w.aliasProbability[less] = tileWeights[less];
+            w.alias[less] = more;
+            tileWeights[more] += tileWeights[less] - 1;
+            (tileWeights[more] < 1 ? small : large).push_back(more);
+        }
+        // whatever is left is only short of 1 because of rounding errors
+        for (int i : small) {
+            w.aliasProbability[i] = tileWeights[i] > 0 ? 1 : 0;
+            w.alias[i] = anyTile;
+        }
+        for (int i : large) {
+            w.aliasProbability[i] = 1;
+        }
+    }
+
+    return result;
+}
+
+void ImageSampler::jump() {
+    dwell = 0;
+    skips = MAX_SKIPS;
+}
+
+void ImageSampler::enterTile(int newTile) {
+    tile = newTile;
+    const auto& starts = frame->starts;
+    float weight = 0;
+    for (int band = 0; band < BANDS; band++) {
+        weight += weights->bandWeights[band] * (starts[BANDS * tile + band + 1] - starts[BANDS * tile + band]);
+        cumulativeWeights[band] = weight;
+    }
+    lastBand = std::lower_bound(cumulativeWeights, cumulativeWeights + BANDS, weight) - cumulativeWeights;
+    dwell += weight * frame->numTiles / weights->totalWeight * DWELL;
+}
+
+int ImageSampler::nextPixel(int stride) {
+    // take the newest tables, if any have been built since the last sample
+    if (middle.load() & FRESH) {
+        front = middle.exchange(front) & ~FRESH;
+        frame = tables[front].frame.get();
+        weights = tables[front].weights.get();
+        jump();
+    }
+
+    if (weights == nullptr || weights->totalWeight <= 0) {
+        return -1;
+    }
+    stride = juce::jmax(1, stride);
+    int numTiles = frame->numTiles;
+
+    // walk along the curve, spending longer in brighter tiles, unless there
+    // are several dark tiles in a row, which are skipped by jumping
+    while (dwell < stride) {
+        if (skips >= MAX_SKIPS) {
+            int next = rng.nextInt(numTiles);
+            if (rng.nextFloat() >= weights->aliasProbability[next]) {
+                next = weights->alias[next];
+            }
+            dwell = 0;
+            enterTile(next);
+            dwell = juce::jmax(dwell, (double) stride);
+        } else {
+            enterTile((tile + 1) % numTiles);
+            skips++;
+        }
+    }
+    dwell -= stride;
+    skips = 0;
+
+    float choice = rng.nextFloat() * cumulativeWeights[BANDS - 1];
+    int band = std::upper_bound(cumulativeWeights, cumulativeWeights + BANDS, choice) - cumulativeWeights;
+    band = juce::jmin(band, lastBand);
+    juce::uint32 start = frame->starts[BANDS * tile + band];
+    juce::uint32 count = frame->starts[BANDS * tile + band + 1] - start;
+    return frame->entries[start + rng.nextInt(count)];
+}
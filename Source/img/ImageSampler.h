@@ -0,0 +1,107 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Chooses which pixels of an image to draw, so that brighter pixels are drawn
+// more often, at a constant cost per pixel whatever the image looks like.
+//
+// The image is split into small tiles, ordered along a Hilbert curve, and the
+// pixels in each tile are grouped by brightness. Drawing walks along the curve
+// and stays in each tile for a number of samples proportional to how bright
+// it is, picking pixels within the tile by brightness. Dark stretches of the
+// curve are jumped over by choosing the next tile from an alias table of tile
+// brightnesses instead of walking through them.
+//
+// The tables are built on a background thread whenever the frame or the
+// threshold changes, and handed to the thread drawing the image through a
+// triple buffer, so drawing never allocates or waits. The previous tables
+// are drawn from until the new ones are ready.
+class ImageSampler : private juce::Thread {
+public:
+    // Copies the pixels of a frame, where 0 is a transparent pixel. Returns
+    // false if they aren't available yet. Called on the background thread.
+    using PixelSource = std::function<bool(int frame, std::vector<uint8_t>& pixels)>;
+
+    ImageSampler(int width, int height, PixelSource source);
+    ~ImageSampler() override;
+
+    // Groups the pixels of a new frame in the background.
+    void setFrame(int frame);
+    // Sets how much more often bright pixels are drawn than dark ones. Pixels
+    // are drawn in proportion to their brightness raised to thresholdPow.
+    void setThreshold(double thresholdPow, bool invert);
+    // Moves to a tile chosen at random, weighted by brightness.
+    void jump();
+    // Returns the index of the next pixel to draw, or -1 if no pixel is bright
+    // enough to draw. Larger strides move along the curve more quickly.
+    int nextPixel(int stride);
+
+private:
+    static const int TILE_SIZE = 8;
+    static const int BANDS = 32;
+    // samples spent in a tile of average brightness with a stride of 1
+    static const int DWELL = 64;
+    // dark tiles walked through before jumping instead
+    static const int MAX_SKIPS = 4;
+
+    // the pixels of a frame, grouped by tile and brightness
+    struct Frame {
+        int numTiles = 0;
+        // entries[starts[BANDS * tile + band]] onwards are the pixels of a tile
+        // in a brightness band, with tiles in the order they are on the curve
+        std::vector<juce::uint32> starts;
+        std::vector<juce::uint32> entries;
+    };
+
+    // how often each tile and band of a frame is drawn at a threshold
+    struct Weights {
+        float bandWeights[BANDS] = {};
+        double totalWeight = 0;
+        std::vector<float> aliasProbability;
+        std::vector<int> alias;
+    };
+
+    struct Tables {
+        std::shared_ptr<const Frame> frame;
+        std::shared_ptr<const Weights> weights;
+    };
+
+    static std::shared_ptr<const Frame> buildFrame(const std::vector<uint8_t>& pixels, int width, int height);
+    static std::shared_ptr<const Weights> buildWeights(const Frame& frame, double thresholdPow, bool invert);
+
+    void run() override;
+    void publish(const Tables& newTables);
+    void enterTile(int tile);
+
+    const int width;
+    const int height;
+    PixelSource source;
+
+    // what the drawing thread last asked for, or -1 if nothing yet
+    std::atomic<int> requestedFrame = -1;
+    std::atomic<double> requestedThresholdPow = -1;
+    std::atomic<bool> requestedInvert = false;
+
+    // The drawing thread only reads tables[front], and the background thread
+    // only writes tables[back]. Finished tables are swapped into the middle,
+    // with the FRESH bit set until the drawing thread swaps them out again.
+    static const int FRESH = 4;
+    Tables tables[3];
+    std::atomic<int> middle = 1;
+    int front = 0;
+    int back = 2;
+
+    // only used by the drawing thread
+    juce::Random rng;
+    const Frame* frame = nullptr;
+    const Weights* weights = nullptr;
+    int tile = 0;
+    // cumulative weight of each band in the current tile
+    float cumulativeWeights[BANDS] = {};
+    // the last band in the tile with any weight
+    int lastBand = 0;
+    double dwell = 0;
+    int skips = MAX_SKIPS;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ImageSampler)
+};
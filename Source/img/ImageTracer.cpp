@@ -0,0 +1,205 @@
+#include "ImageTracer.h"
+
+// how far, in pixels, a simplified outline can stray from the traced one
+static const double TOLERANCE = 0.6;
+// outlines shorter than this, in pixels, are noise
+static const double MIN_OUTLINE_LENGTH = 4.0;
+
+struct TracePoint {
+    double x, y;
+};
+
+// The segments of the outline in each combination of corners above the
+// level, as pairs of cell edges: 0 top, 1 right, 2 bottom, 3 left. Corners
+// are numbered top left 1, top right 2, bottom right 4, bottom left 8. The
+// two saddles (5 and 10) have a second pair that is used when the centre of
+// the cell is above the level.
+static const int SEGMENTS[16][4] = {
+    { -1, -1, -1, -1 },
+    { 3, 0, -1, -1 },
+    { 0, 1, -1, -1 },
+    { 3, 1, -1, -1 },
+    { 1, 2, -1, -1 },
+    { 3, 0, 1, 2 },
+    { 0, 2, -1, -1 },
+    { 3, 2, -1, -1 },
+    { 2, 3, -1, -1 },
+    { 2, 0, -1, -1 },
+    { 0, 1, 2, 3 },
+    { 2, 1, -1, -1 },
+    { 1, 3, -1, -1 },
+    { 1, 0, -1, -1 },
+    { 0, 3, -1, -1 },
+    { -1, -1, -1, -1 },
+};
+
+static const int SADDLE_SEGMENTS[16][4] = {
+    {}, {}, {}, {}, {},
+    { 3, 2, 1, 0 },
+    {}, {}, {}, {},
+    { 0, 3, 2, 1 },
+};
+
+static double distanceToSegment(TracePoint p, TracePoint a, TracePoint b) {
+    double dx = b.x - a.x;
+    double dy = b.y - a.y;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = lengthSquared == 0 ? 0 : juce::jlimit(0.0, 1.0, ((p.x - a.x) * dx + (p.y - a.y) * dy) / lengthSquared);
+    return std::hypot(p.x - a.x - t * dx, p.y - a.y - t * dy);
+}
+
+// Douglas-Peucker: keeps the point furthest from the line between the ends
+// if it is too far away, and simplifies either side of it
+static void simplify(const std::vector<TracePoint>& points, int start, int end, std::vector<char>& keep) {
+    double furthest = 0;
+    int index = -1;
+    for (int i = start + 1; i < end; i++) {
+        double distance = distanceToSegment(points[i], points[start], points[end]);
+        if (distance > furthest) {
+            furthest = distance;
+            index = i;
+        }
+    }
+    if (furthest > TOLERANCE) {
+        keep[index] = true;
+        simplify(points, start, index, keep);
+        simplify(points, index, end, keep);
+    }
+}
+
+std::vector<Line> traceOutlines(const uint8_t* pixels, int width, int height, double level, bool invert) {
+    // brightness at each pixel, with a border of dark pixels so that every
+    // outline is closed
+    int gridWidth = width + 2;
+    int gridHeight = height + 2;
+    std::vector<float> values(gridWidth * gridHeight, 0);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t pixel = pixels[y * width + x];
+            float value = pixel / 255.0f;
+            if (invert && pixel > 0) {
+                value = 1 - value;
+            }
+            values[(y + 1) * gridWidth + x + 1] = value;
+        }
+    }
+
+    // 3x3 box blur, so that outlines follow edges rather than single pixels
+    std::vector<float> blurred(values.size(), 0);
+    for (int y = 1; y < gridHeight - 1; y++) {
+        for (int x = 0; x < gridWidth; x++) {
+            int i = y * gridWidth + x;
+            blurred[i] = values[i - gridWidth] + values[i] + values[i + gridWidth];
+        }
+    }
+    for (int y = 1; y < gridHeight - 1; y++) {
+        for (int x = 1; x < gridWidth - 1; x++) {
+            int i = y * gridWidth + x;
+            values[i] = (blurred[i - 1] + blurred[i] + blurred[i + 1]) / 9;
+        }
+    }
+
+    // Each point where the outline crosses an edge between two neighbouring
+    // samples is on exactly two segments, so links holds the two points it
+    // is joined to. Horizontal edges come first, then vertical edges.
+    int numEdges = 2 * gridWidth * gridHeight;
+    std::vector<int> links(2 * numEdges, -1);
+    auto edgeId = [&](int x, int y, int side) {
+        switch (side) {
+            case 0: return y * gridWidth + x;
+            case 1: return gridWidth * gridHeight + y * gridWidth + x + 1;
+            case 2: return (y + 1) * gridWidth + x;
+            default: return gridWidth * gridHeight + y * gridWidth + x;
+        }
+    };
+    auto link = [&](int a, int b) {
+        links[2 * a + (links[2 * a] == -1 ? 0 : 1)] = b;
+        links[2 * b + (links[2 * b] == -1 ? 0 : 1)] = a;
+    };
+    auto above = [&](int x, int y) {
+        return values[y * gridWidth + x] > level;
+    };
+
+    for (int y = 0; y < gridHeight - 1; y++) {
+        for (int x = 0; x < gridWidth - 1; x++) {
+            int corners = above(x, y) | above(x + 1, y) << 1 | above(x + 1, y + 1) << 2 | above(x, y + 1) << 3;
+            const int* segments = SEGMENTS[corners];
+            if (corners == 5 || corners == 10) {
+                float centre = (values[y * gridWidth + x] + values[y * gridWidth + x + 1] + values[(y + 1) * gridWidth + x] + values[(y + 1) * gridWidth + x + 1]) / 4;
+                if (centre > level) {
+                    segments = SADDLE_SEGMENTS[corners];
+                }
+            }
+            for (int i = 0; i < 4 && segments[i] != -1; i += 2) {
+                link(edgeId(x, y, segments[i]), edgeId(x, y, segments[i + 1]));
+            }
+        }
+    }
+
+    // where the brightness crosses the level along an edge, in pixels
+    auto crossing = [&](int id) {
+        bool vertical = id >= gridWidth * gridHeight;
+        int cell = vertical ? id - gridWidth * gridHeight : id;
+        int x = cell % gridWidth;
+        int y = cell / gridWidth;
+        float a = values[cell];
+        float b = values[vertical ? cell + gridWidth : cell + 1];
+        double t = a == b ? 0.5 : (level - a) / (b - a);
+        // the border is at -1, so that the first pixel is at 0
+        return vertical ? TracePoint{ x - 1.0, y - 1.0 + t } : TracePoint{ x - 1.0 + t, y - 1.0 };
+    };
+
+    double maxDim = juce::jmax(width, height);
+    double widthDiff = (maxDim - width) / 2;
+    double heightDiff = (maxDim - height) / 2;
+    auto toOutput = [&](TracePoint p) {
+        return OsciPoint(2 * (p.x + widthDiff) / maxDim - 1, 2 * (height - p.y - 1 + heightDiff) / maxDim - 1);
+    };
+
+    std::vector<Line> lines;
+    std::vector<char> visited(numEdges, false);
+    std::vector<TracePoint> outline;
+    std::vector<char> keep;
+    for (int start = 0; start < numEdges; start++) {
+        if (links[2 * start] == -1 || visited[start]) {
+            continue;
+        }
+
+        outline.clear();
+        double length = 0;
+        int previous = -1;
+        int current = start;
+        while (!visited[current]) {
+            visited[current] = true;
+            outline.push_back(crossing(current));
+            if (outline.size() > 1) {
+                length += std::hypot(outline.back().x - outline[outline.size() - 2].x, outline.back().y - outline[outline.size() - 2].y);
+            }
+            int next = links[2 * current] == previous ? links[2 * current + 1] : links[2 * current];
+            previous = current;
+            current = next;
+        }
+        if (length < MIN_OUTLINE_LENGTH) {
+            continue;
+        }
+
+        // closed outlines are split in half so that both ends are fixed
+        outline.push_back(outline.front());
+        keep.assign(outline.size(), false);
+        int middle = outline.size() / 2;
+        keep[0] = keep[middle] = keep[outline.size() - 1] = true;
+        simplify(outline, 0, middle, keep);
+        simplify(outline, middle, outline.size() - 1, keep);
+
+        OsciPoint last = toOutput(outline[0]);
+        for (size_t i = 1; i < outline.size(); i++) {
+            if (keep[i]) {
+                OsciPoint point = toOutput(outline[i]);
+                lines.push_back(Line(last, point));
+                last = point;
+            }
+        }
+    }
+
+    return lines;
+}
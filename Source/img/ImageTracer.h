@@ -0,0 +1,16 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../shape/Line.h"
+
+// Traces the outlines in a grayscale image as lines, so that an image can be
+// drawn like an SVG rather than a pixel at a time.
+//
+// The image is lightly blurred and marching squares finds where its
+// brightness crosses level, giving closed outlines around every region
+// brighter than level. Each outline is then simplified with Douglas-Peucker,
+// and outlines around single pixels of noise are dropped. Transparent pixels
+// (0) are always treated as dark, even when invert is set.
+//
+// The lines are scaled so that the longer side of the image spans -1 to 1.
+std::vector<Line> traceOutlines(const uint8_t* pixels, int width, int height, double level, bool invert);
@@ -0,0 +1,228 @@
+#include "VideoStream.h"
+
+#if ! JUCE_WINDOWS
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+VideoStream::VideoStream(juce::File file) : FrameDecoder("Video Stream"), file(file) {
+    y4m = file.hasFileExtension("y4m");
+    bool isPipe = false;
+#if ! JUCE_WINDOWS
+    struct stat info;
+    isPipe = stat(file.getFullPathName().toRawUTF8(), &info) == 0 && S_ISFIFO(info.st_mode);
+    if (isPipe) {
+        // opening a pipe for reading normally blocks until something opens it for writing
+        pipe = open(file.getFullPathName().toRawUTF8(), O_RDONLY | O_NONBLOCK);
+        if (pipe == -1) {
+            return;
+        }
+    }
+#endif
+    if (!isPipe) {
+        stream = std::make_unique<juce::FileInputStream>(file);
+        if (stream->failedToOpen()) {
+            return;
+        }
+    }
+
+    int width, height;
+    if (!readHeader(width, height)) {
+        return;
+    }
+
+    // pipes have no size, and can only be read in order
+    juce::int64 fileSize = file.getSize();
+    bool live = fileSize == 0;
+    int numFrames = 1;
+    if (!live) {
+        firstFrame = stream->getPosition();
+        if (y4m) {
+            // every frame is assumed to have the same FRAME line as the first
+            juce::String frameHeader = readLine();
+            if (!frameHeader.startsWith("FRAME")) {
+                return;
+            }
+            frameHeaderSize = frameHeader.length() + 1;
+        }
+        numFrames = (fileSize - firstFrame) / (frameHeaderSize + frameSize);
+    }
+
+    startDecoding(numFrames, width, height, READ_AHEAD, live);
+}
+
+VideoStream::~VideoStream() {
+    stopDecoding();
+#if ! JUCE_WINDOWS
+    if (pipe != -1) {
+        close(pipe);
+    }
+#endif
+}
+
+bool VideoStream::isVideoFile(const juce::String& fileName) {
+    return fileName.endsWithIgnoreCase(".y4m") || fileName.endsWithIgnoreCase(".gray");
+}
+
+bool VideoStream::readHeader(int& width, int& height) {
+    width = 0;
+    height = 0;
+    juce::String chroma = "420";
+
+    juce::StringArray tokens;
+    if (y4m) {
+        tokens.addTokens(readLine(), " ", "");
+        if (tokens[0] != "YUV4MPEG2") {
+            return false;
+        }
+        for (auto& token : tokens) {
+            if (token.startsWith("W")) {
+                width = token.substring(1).getIntValue();
+            } else if (token.startsWith("H")) {
+                height = token.substring(1).getIntValue();
+            } else if (token.startsWith("C")) {
+                chroma = token.substring(1);
+            }
+        }
+    } else {
+        // raw frames have their size in the file name, e.g. video-640x480.gray
+        tokens.addTokens(file.getFileNameWithoutExtension(), "-_. ", "");
+        for (int i = tokens.size() - 1; i >= 0 && width == 0; i--) {
+            juce::String w = tokens[i].upToFirstOccurrenceOf("x", false, true);
+            juce::String h = tokens[i].fromFirstOccurrenceOf("x", false, true);
+            if (w.isNotEmpty() && h.isNotEmpty() && w.containsOnly("0123456789") && h.containsOnly("0123456789")) {
+                width = w.getIntValue();
+                height = h.getIntValue();
+            }
+        }
+        chroma = "mono";
+    }
+
+    if (width <= 0 || height <= 0 || width > MAX_SIZE || height > MAX_SIZE) {
+        return false;
+    }
+
+    // only the brightness plane is used, but the colour planes after it
+    // have to be skipped
+    juce::int64 halfWidth = (width + 1) / 2;
+    juce::int64 halfHeight = (height + 1) / 2;
+    brightnessSize = (juce::int64) width * height;
+    if (chroma == "420" || chroma == "420jpeg" || chroma == "420paldv" || chroma == "420mpeg2") {
+        frameSize = brightnessSize + 2 * halfWidth * halfHeight;
+    } else if (chroma == "422") {
+        frameSize = brightnessSize + 2 * halfWidth * height;
+    } else if (chroma == "411") {
+        frameSize = brightnessSize + 2 * ((width + 3) / 4) * height;
+    } else if (chroma == "444") {
+        frameSize = 3 * brightnessSize;
+    } else if (chroma == "444alpha") {
+        frameSize = 4 * brightnessSize;
+    } else if (chroma == "mono") {
+        frameSize = brightnessSize;
+    } else {
+        // higher bit depths, such as 420p10
+        return false;
+    }
+    return true;
+}
+
+juce::String VideoStream::readLine() {
+    juce::MemoryOutputStream line;
+    for (int i = 0; i < 1024; i++) {
+        char c;
+        if (readSome(&c, 1) != 1 || c == '\n') {
+            break;
+        }
+        line.writeByte(c);
+    }
+    return line.toString();
+}
+
+// Reads at least one byte, waiting for a pipe to be written to if need be.
+// Returns 0 at the end of the stream, or when it gives up waiting.
+int VideoStream::readSome(void* destination, int size) {
+#if ! JUCE_WINDOWS
+    if (pipe != -1) {
+        juce::uint32 waitStart = juce::Time::getMillisecondCounter();
+        while (true) {
+            ssize_t read = ::read(pipe, destination, size);
+            if (read > 0) {
+                pipeConnected = true;
+                return (int) read;
+            }
+            if (read == 0 && pipeConnected) {
+                // the program writing to the pipe has finished
+                return 0;
+            }
+            if (read == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                return 0;
+            }
+            if (shouldStopWaiting(waitStart)) {
+                return 0;
+            }
+
+            if (read == 0) {
+                // nothing has opened the pipe for writing yet, which poll
+                // doesn't wait for on every platform
+                juce::Thread::sleep(POLL_INTERVAL_MS);
+            } else {
+                pollfd request = { pipe, POLLIN, 0 };
+                poll(&request, 1, POLL_INTERVAL_MS);
+            }
+        }
+    }
+#endif
+    return stream->read(destination, size);
+}
+
+// The decoder thread waits until the video is closed, while the constructor,
+// which runs on a file parsing thread, gives up on a pipe nothing writes to.
+bool VideoStream::shouldStopWaiting(juce::uint32 waitStart) {
+    if (isDecoderThread()) {
+        return isStopping();
+    }
+    return juce::Time::getMillisecondCounter() - waitStart >= OPEN_TIMEOUT_MS;
+}
+
+// pipes can return less than was asked for, so keep reading until it is all there
+bool VideoStream::readFully(void* destination, juce::int64 size) {
+    char* bytes = (char*) destination;
+    while (size > 0) {
+        int read = readSome(bytes, (int) juce::jmin(size, (juce::int64) std::numeric_limits<int>::max()));
+        if (read <= 0) {
+            return false;
+        }
+        bytes += read;
+        size -= read;
+    }
+    return true;
+}
+
+bool VideoStream::decodeFrame(int index, uint8_t* pixels) {
+    if (!isLive() && !stream->setPosition(firstFrame + index * (frameHeaderSize + frameSize))) {
+        return false;
+    }
+    if (y4m) {
+        juce::String frameHeader = readLine();
+        if (!frameHeader.startsWith("FRAME") || (!isLive() && frameHeader.length() + 1 != frameHeaderSize)) {
+            return false;
+        }
+    }
+
+    if (!readFully(pixels, brightnessSize)) {
+        return false;
+    }
+    for (juce::int64 i = 0; i < brightnessSize; i++) {
+        // value of 0 is reserved for transparent pixels
+        pixels[i] = juce::jmax((uint8_t) 1, pixels[i]);
+    }
+
+    // the colour of the next frame in a pipe can't be skipped by seeking
+    if (isLive()) {
+        colour.resize(frameSize - brightnessSize);
+        return readFully(colour.data(), colour.size());
+    }
+    return true;
+}
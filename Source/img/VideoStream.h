@@ -0,0 +1,61 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "FrameDecoder.h"
+
+// Streams the frames of an uncompressed video from disk, or from a pipe that
+// another program such as ffmpeg is writing to, without ever loading the
+// whole video into memory.
+//
+// YUV4MPEG2 (.y4m) files with 8-bit samples are supported, of which only the
+// brightness is used. Raw files (.gray) are 8-bit grayscale frames one after
+// another, with the size of a frame in the file's name, such as
+// video-640x480.gray. Pipes are read as live sources, one frame each time the
+// animation moves on to a new frame. Opening a pipe waits for a program to
+// start writing to it, for up to OPEN_TIMEOUT_MS.
+class VideoStream : public FrameDecoder {
+public:
+    VideoStream(juce::File file);
+    ~VideoStream() override;
+
+    static bool isVideoFile(const juce::String& fileName);
+
+protected:
+    bool decodeFrame(int index, uint8_t* pixels) override;
+
+private:
+    static const int READ_AHEAD = 8;
+    static const int MAX_SIZE = 16384;
+    // how long the constructor waits for a pipe to be written to
+    static const int OPEN_TIMEOUT_MS = 5000;
+    // how often a read that is waiting for a pipe checks whether to give up
+    static const int POLL_INTERVAL_MS = 50;
+
+    bool readHeader(int& width, int& height);
+    int readSome(void* destination, int size);
+    bool readFully(void* destination, juce::int64 size);
+    juce::String readLine();
+    bool shouldStopWaiting(juce::uint32 waitStart);
+
+    juce::File file;
+    std::unique_ptr<juce::FileInputStream> stream;
+#if ! JUCE_WINDOWS
+    // Pipes are opened without blocking, and waited on with poll, as a
+    // blocking read can't be interrupted when the video is closed.
+    int pipe = -1;
+    // whether anything has been read from the pipe yet, after which reading
+    // nothing means the program writing to it has finished
+    bool pipeConnected = false;
+#endif
+    bool y4m = false;
+    // where the first frame starts, after the Y4M header
+    juce::int64 firstFrame = 0;
+    // the length of the FRAME line before each frame in a Y4M file
+    int frameHeaderSize = 0;
+    // the size of each frame, including the colour that isn't used
+    juce::int64 frameSize = 0;
+    juce::int64 brightnessSize = 0;
+    std::vector<uint8_t> colour;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VideoStream)
+};
@@ -5,13 +5,6 @@
 #include <string.h>
 
 #include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#ifdef _WIN32
-#include <io.h>
-#else
-#include <unistd.h>
-#endif
 
 #define MIN(A, B) ((A) < (B) ? (A) : (B))
 #define MAX(A, B) ((A) > (B) ? (A) : (B))
@@ -28,94 +21,110 @@ typedef struct Table {
     Entry *entries;
 } Table;
 
+/* Read from the in-memory file. Reading past the end gives zeros. */
+static void
+gd_read(gd_GIF *gif, void *buffer, size_t count)
+{
+    size_t available = gif->pos < gif->size ? gif->size - gif->pos : 0;
+    size_t n = MIN(count, available);
+    if (n > 0)
+        memcpy(buffer, gif->data + gif->pos, n);
+    memset((uint8_t *) buffer + n, 0, count - n);
+    gif->pos += count;
+}
+
+static off_t
+gd_seek(gd_GIF *gif, off_t offset, int whence)
+{
+    if (whence == SEEK_SET)
+        gif->pos = offset;
+    else
+        gif->pos += offset;
+    return (off_t) gif->pos;
+}
+
 static uint16_t
-read_num(int fd)
+read_num(gd_GIF *gif)
 {
     uint8_t bytes[2];
 
-    read(fd, bytes, 2);
+    gd_read(gif, bytes, 2);
     return bytes[0] + (((uint16_t) bytes[1]) << 8);
 }
 
-gd_GIF *
-gd_open_gif(const char *fname)
+/* Clear the canvas to the background color, as at the start of the animation. */
+static void
+reset_canvas(gd_GIF *gif)
 {
-    int fd;
-    uint8_t sigver[3];
-    uint16_t width, height, depth;
-    uint8_t fdsz, bgidx, aspect;
     int i;
     uint8_t *bgcolor;
-    int gct_sz;
+
+    memset(gif->frame, gif->bgindex, gif->width * gif->height);
+    memset(gif->canvas, 0, gif->width * gif->height * 3);
+    bgcolor = &gif->gct.colors[gif->bgindex*3];
+    if (bgcolor[0] || bgcolor[1] || bgcolor [2])
+        for (i = 0; i < gif->width * gif->height; i++)
+            memcpy(&gif->canvas[i*3], bgcolor, 3);
+    memset(&gif->gce, 0, sizeof(gif->gce));
+    gif->palette = &gif->gct;
+    gif->fx = gif->fy = gif->fw = gif->fh = 0;
+}
+
+gd_GIF *
+gd_open_gif_memory(const void *data, size_t size)
+{
+    uint8_t sigver[3];
+    uint8_t fdsz, aspect;
     gd_GIF *gif;
 
-    fd = open(fname, O_RDONLY);
-    if (fd == -1) return NULL;
-#ifdef _WIN32
-    setmode(fd, O_BINARY);
-#endif
+    /* The file is read in place, so data must outlive the gd_GIF. */
+    gif = calloc(1, sizeof(*gif));
+    if (!gif) return NULL;
+    gif->data = (const uint8_t *) data;
+    gif->size = size;
     /* Header */
-    read(fd, sigver, 3);
+    gd_read(gif, sigver, 3);
     if (memcmp(sigver, "GIF", 3) != 0) {
         fprintf(stderr, "invalid signature\n");
         goto fail;
     }
     /* Version */
-    read(fd, sigver, 3);
+    gd_read(gif, sigver, 3);
     if (memcmp(sigver, "89a", 3) != 0) {
         fprintf(stderr, "invalid version\n");
         goto fail;
     }
     /* Width x Height */
-    width  = read_num(fd);
-    height = read_num(fd);
+    gif->width  = read_num(gif);
+    gif->height = read_num(gif);
     /* FDSZ */
-    read(fd, &fdsz, 1);
+    gd_read(gif, &fdsz, 1);
     /* Presence of GCT */
     if (!(fdsz & 0x80)) {
         fprintf(stderr, "no global color table\n");
         goto fail;
     }
     /* Color Space's Depth */
-    depth = ((fdsz >> 4) & 7) + 1;
+    gif->depth = ((fdsz >> 4) & 7) + 1;
     /* Ignore Sort Flag. */
     /* GCT Size */
-    gct_sz = 1 << ((fdsz & 0x07) + 1);
+    gif->gct.size = 1 << ((fdsz & 0x07) + 1);
     /* Background Color Index */
-    read(fd, &bgidx, 1);
+    gd_read(gif, &gif->bgindex, 1);
     /* Aspect Ratio */
-    read(fd, &aspect, 1);
-    /* Create gd_GIF Structure. */
-    gif = calloc(1, sizeof(*gif));
-    if (!gif) goto fail;
-    gif->fd = fd;
-    gif->width  = width;
-    gif->height = height;
-    gif->depth  = depth;
+    gd_read(gif, &aspect, 1);
     /* Read GCT */
-    gif->gct.size = gct_sz;
-    read(fd, gif->gct.colors, 3 * gif->gct.size);
-    gif->palette = &gif->gct;
-    gif->bgindex = bgidx;
-    gif->frame = calloc(4, width * height);
-    if (!gif->frame) {
-        free(gif);
+    gd_read(gif, gif->gct.colors, 3 * gif->gct.size);
+    gif->frame = calloc(4, gif->width * gif->height);
+    if (!gif->frame)
         goto fail;
-    }
-    gif->canvas = &gif->frame[width * height];
-    if (gif->bgindex)
-        memset(gif->frame, gif->bgindex, gif->width * gif->height);
-    bgcolor = &gif->palette->colors[gif->bgindex*3];
-    if (bgcolor[0] || bgcolor[1] || bgcolor [2])
-        for (i = 0; i < gif->width * gif->height; i++)
-            memcpy(&gif->canvas[i*3], bgcolor, 3);
-    gif->anim_start = lseek(fd, 0, SEEK_CUR);
-    goto ok;
-fail:
-    close(fd);
-    return 0;
-ok:
+    gif->canvas = &gif->frame[gif->width * gif->height];
+    reset_canvas(gif);
+    gif->anim_start = gif->pos;
     return gif;
+fail:
+    free(gif);
+    return NULL;
 }
 
 static void
@@ -124,8 +133,8 @@ discard_sub_blocks(gd_GIF *gif)
     uint8_t size;
 
     do {
-        read(gif->fd, &size, 1);
-        lseek(gif->fd, size, SEEK_CUR);
+        gd_read(gif, &size, 1);
+        gd_seek(gif, size, SEEK_CUR);
     } while (size);
 }
 
@@ -136,21 +145,21 @@ read_plain_text_ext(gd_GIF *gif)
         uint16_t tx, ty, tw, th;
         uint8_t cw, ch, fg, bg;
         off_t sub_block;
-        lseek(gif->fd, 1, SEEK_CUR); /* block size = 12 */
-        tx = read_num(gif->fd);
-        ty = read_num(gif->fd);
-        tw = read_num(gif->fd);
-        th = read_num(gif->fd);
-        read(gif->fd, &cw, 1);
-        read(gif->fd, &ch, 1);
-        read(gif->fd, &fg, 1);
-        read(gif->fd, &bg, 1);
-        sub_block = lseek(gif->fd, 0, SEEK_CUR);
+        gd_seek(gif, 1, SEEK_CUR); /* block size = 12 */
+        tx = read_num(gif);
+        ty = read_num(gif);
+        tw = read_num(gif);
+        th = read_num(gif);
+        gd_read(gif, &cw, 1);
+        gd_read(gif, &ch, 1);
+        gd_read(gif, &fg, 1);
+        gd_read(gif, &bg, 1);
+        sub_block = gd_seek(gif, 0, SEEK_CUR);
         gif->plain_text(gif, tx, ty, tw, th, cw, ch, fg, bg);
-        lseek(gif->fd, sub_block, SEEK_SET);
+        gd_seek(gif, sub_block, SEEK_SET);
     } else {
         /* Discard plain text metadata. */
-        lseek(gif->fd, 13, SEEK_CUR);
+        gd_seek(gif, 13, SEEK_CUR);
     }
     /* Discard plain text sub-blocks. */
     discard_sub_blocks(gif);
@@ -162,24 +171,24 @@ read_graphic_control_ext(gd_GIF *gif)
     uint8_t rdit;
 
     /* Discard block size (always 0x04). */
-    lseek(gif->fd, 1, SEEK_CUR);
-    read(gif->fd, &rdit, 1);
+    gd_seek(gif, 1, SEEK_CUR);
+    gd_read(gif, &rdit, 1);
     gif->gce.disposal = (rdit >> 2) & 3;
     gif->gce.input = rdit & 2;
     gif->gce.transparency = rdit & 1;
-    gif->gce.delay = read_num(gif->fd);
-    read(gif->fd, &gif->gce.tindex, 1);
+    gif->gce.delay = read_num(gif);
+    gd_read(gif, &gif->gce.tindex, 1);
     /* Skip block terminator. */
-    lseek(gif->fd, 1, SEEK_CUR);
+    gd_seek(gif, 1, SEEK_CUR);
 }
 
 static void
 read_comment_ext(gd_GIF *gif)
 {
     if (gif->comment) {
-        off_t sub_block = lseek(gif->fd, 0, SEEK_CUR);
+        off_t sub_block = gd_seek(gif, 0, SEEK_CUR);
         gif->comment(gif);
-        lseek(gif->fd, sub_block, SEEK_SET);
+        gd_seek(gif, sub_block, SEEK_SET);
     }
     /* Discard comment sub-blocks. */
     discard_sub_blocks(gif);
@@ -192,21 +201,21 @@ read_application_ext(gd_GIF *gif)
     char app_auth_code[3];
 
     /* Discard block size (always 0x0B). */
-    lseek(gif->fd, 1, SEEK_CUR);
+    gd_seek(gif, 1, SEEK_CUR);
     /* Application Identifier. */
-    read(gif->fd, app_id, 8);
+    gd_read(gif, app_id, 8);
     /* Application Authentication Code. */
-    read(gif->fd, app_auth_code, 3);
+    gd_read(gif, app_auth_code, 3);
     if (!strncmp(app_id, "NETSCAPE", sizeof(app_id))) {
         /* Discard block size (0x03) and constant byte (0x01). */
-        lseek(gif->fd, 2, SEEK_CUR);
-        gif->loop_count = read_num(gif->fd);
+        gd_seek(gif, 2, SEEK_CUR);
+        gif->loop_count = read_num(gif);
         /* Skip block terminator. */
-        lseek(gif->fd, 1, SEEK_CUR);
+        gd_seek(gif, 1, SEEK_CUR);
     } else if (gif->application) {
-        off_t sub_block = lseek(gif->fd, 0, SEEK_CUR);
+        off_t sub_block = gd_seek(gif, 0, SEEK_CUR);
         gif->application(gif, app_id, app_auth_code);
-        lseek(gif->fd, sub_block, SEEK_SET);
+        gd_seek(gif, sub_block, SEEK_SET);
         discard_sub_blocks(gif);
     } else {
         discard_sub_blocks(gif);
@@ -218,7 +227,7 @@ read_ext(gd_GIF *gif)
 {
     uint8_t label;
 
-    read(gif->fd, &label, 1);
+    gd_read(gif, &label, 1);
     switch (label) {
     case 0x01:
         read_plain_text_ext(gif);
@@ -289,11 +298,11 @@ get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *by
         if (rpad == 0) {
             /* Update byte. */
             if (*sub_len == 0) {
-                read(gif->fd, sub_len, 1); /* Must be nonzero! */
+                gd_read(gif, sub_len, 1); /* Must be nonzero! */
                 if (*sub_len == 0)
                     return 0x1000;
             }
-            read(gif->fd, byte, 1);
+            gd_read(gif, byte, 1);
             (*sub_len)--;
         }
         frag_size = MIN(key_size - bits_read, 8 - rpad);
@@ -341,15 +350,15 @@ read_image_data(gd_GIF *gif, int interlace)
     Entry entry;
     off_t start, end;
 
-    read(gif->fd, &byte, 1);
+    gd_read(gif, &byte, 1);
     key_size = (int) byte;
     if (key_size < 2 || key_size > 8)
         return -1;
     
-    start = lseek(gif->fd, 0, SEEK_CUR);
+    start = gd_seek(gif, 0, SEEK_CUR);
     discard_sub_blocks(gif);
-    end = lseek(gif->fd, 0, SEEK_CUR);
-    lseek(gif->fd, start, SEEK_SET);
+    end = gd_seek(gif, 0, SEEK_CUR);
+    gd_seek(gif, start, SEEK_SET);
     clear = 1 << key_size;
     stop = clear + 1;
     table = new_table(key_size);
@@ -400,8 +409,8 @@ read_image_data(gd_GIF *gif, int interlace)
     }
     free(table);
     if (key == stop)
-        read(gif->fd, &sub_len, 1); /* Must be zero! */
-    lseek(gif->fd, end, SEEK_SET);
+        gd_read(gif, &sub_len, 1); /* Must be zero! */
+    gd_seek(gif, end, SEEK_SET);
     return 0;
 }
 
@@ -414,26 +423,26 @@ read_image(gd_GIF *gif)
     int interlace;
 
     /* Image Descriptor. */
-    gif->fx = read_num(gif->fd);
-    gif->fy = read_num(gif->fd);
+    gif->fx = read_num(gif);
+    gif->fy = read_num(gif);
     
     if (gif->fx >= gif->width || gif->fy >= gif->height)
         return -1;
     
-    gif->fw = read_num(gif->fd);
-    gif->fh = read_num(gif->fd);
+    gif->fw = read_num(gif);
+    gif->fh = read_num(gif);
     
     gif->fw = MIN(gif->fw, gif->width - gif->fx);
     gif->fh = MIN(gif->fh, gif->height - gif->fy);
     
-    read(gif->fd, &fisrz, 1);
+    gd_read(gif, &fisrz, 1);
     interlace = fisrz & 0x40;
     /* Ignore Sort Flag. */
     /* Local Color Table? */
     if (fisrz & 0x80) {
         /* Read LCT */
         gif->lct.size = 1 << ((fisrz & 0x07) + 1);
-        read(gif->fd, gif->lct.colors, 3 * gif->lct.size);
+        gd_read(gif, gif->lct.colors, 3 * gif->lct.size);
         gif->palette = &gif->lct;
     } else
         gif->palette = &gif->gct;
@@ -488,20 +497,51 @@ gd_get_frame(gd_GIF *gif)
     char sep;
 
     dispose(gif);
-    read(gif->fd, &sep, 1);
+    gd_read(gif, &sep, 1);
     while (sep != ',') {
         if (sep == ';')
             return 0;
         if (sep == '!')
             read_ext(gif);
         else return -1;
-        read(gif->fd, &sep, 1);
+        gd_read(gif, &sep, 1);
     }
     if (read_image(gif) == -1)
         return -1;
     return 1;
 }
 
+/* Move past the next frame without decoding it, to count frames quickly.
+ * Return 1 if skipped a frame; 0 if got GIF trailer; -1 if error. */
+int
+gd_skip_frame(gd_GIF *gif)
+{
+    char sep;
+    uint8_t fisrz, key_size;
+
+    gd_read(gif, &sep, 1);
+    while (sep != ',') {
+        if (sep == ';')
+            return 0;
+        if (sep == '!')
+            read_ext(gif);
+        else return -1;
+        gd_read(gif, &sep, 1);
+    }
+    /* Image Descriptor, checked as in read_image. */
+    if (read_num(gif) >= gif->width || read_num(gif) >= gif->height)
+        return -1;
+    gd_seek(gif, 4, SEEK_CUR);
+    gd_read(gif, &fisrz, 1);
+    if (fisrz & 0x80)
+        gd_seek(gif, 3 * (1 << ((fisrz & 0x07) + 1)), SEEK_CUR);
+    gd_read(gif, &key_size, 1);
+    if (key_size < 2 || key_size > 8)
+        return -1;
+    discard_sub_blocks(gif);
+    return gif->pos <= gif->size ? 1 : -1;
+}
+
 void
 gd_render_frame(gd_GIF *gif, uint8_t *buffer)
 {
@@ -518,13 +558,44 @@ gd_is_bgcolor(gd_GIF *gif, uint8_t color[3])
 void
 gd_rewind(gd_GIF *gif)
 {
-    lseek(gif->fd, gif->anim_start, SEEK_SET);
+    gd_seek(gif, gif->anim_start, SEEK_SET);
+    reset_canvas(gif);
+}
+
+/* The size of the buffer that gd_save_state writes to. */
+size_t
+gd_state_size(gd_GIF *gif)
+{
+    return sizeof(*gif) + gif->width * gif->height * 4;
+}
+
+/* Save how far through the animation the decoder is, along with the canvas,
+ * so that gd_restore_state can go back to this frame without decoding every
+ * frame before it again. */
+void
+gd_save_state(gd_GIF *gif, uint8_t *state)
+{
+    memcpy(state, gif, sizeof(*gif));
+    /* The canvas follows the frame in the same allocation. */
+    memcpy(state + sizeof(*gif), gif->frame, gif->width * gif->height * 4);
+}
+
+void
+gd_restore_state(gd_GIF *gif, const uint8_t *state)
+{
+    uint8_t *frame = gif->frame;
+
+    /* The palette points into the gd_GIF itself, so is still valid, but the
+     * buffers have to be the ones this gd_GIF allocated. */
+    memcpy(gif, state, sizeof(*gif));
+    gif->frame = frame;
+    gif->canvas = &frame[gif->width * gif->height];
+    memcpy(frame, state + sizeof(*gif), gif->width * gif->height * 4);
 }
 
 void
 gd_close_gif(gd_GIF *gif)
 {
-    close(gif->fd);
     free(gif->frame);    
     free(gif);
 }
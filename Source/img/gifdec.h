@@ -22,7 +22,8 @@ typedef struct gd_GCE {
 } gd_GCE;
 
 typedef struct gd_GIF {
-    int fd;
+    const uint8_t *data;
+    size_t size, pos;
     off_t anim_start;
     uint16_t width, height;
     uint16_t depth;
@@ -42,11 +43,15 @@ typedef struct gd_GIF {
     uint8_t *canvas, *frame;
 } gd_GIF;
 
-gd_GIF *gd_open_gif(const char *fname);
+gd_GIF *gd_open_gif_memory(const void *data, size_t size);
 int gd_get_frame(gd_GIF *gif);
+int gd_skip_frame(gd_GIF *gif);
 void gd_render_frame(gd_GIF *gif, uint8_t *buffer);
 int gd_is_bgcolor(gd_GIF *gif, uint8_t color[3]);
 void gd_rewind(gd_GIF *gif);
+size_t gd_state_size(gd_GIF *gif);
+void gd_save_state(gd_GIF *gif, uint8_t *state);
+void gd_restore_state(gd_GIF *gif, const uint8_t *state);
 void gd_close_gif(gd_GIF *gif);
 
 #ifdef __cplusplus
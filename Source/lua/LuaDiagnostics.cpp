@@ -0,0 +1,138 @@
+#include "LuaDiagnostics.h"
+
+static void copyString(char* destination, size_t size, const char* source, size_t length) {
+	length = std::min(length, size - 1);
+	std::memcpy(destination, source, length);
+	destination[length] = '\0';
+}
+
+LuaDiagnostics::LuaDiagnostics() {
+	startTimerHz(20);
+}
+
+LuaDiagnostics::~LuaDiagnostics() {
+	stopTimer();
+}
+
+void LuaDiagnostics::reportError(int lineNumber, const juce::String& fileId, const juce::String& error) {
+	Diagnostic diagnostic;
+	diagnostic.type = Type::Error;
+	diagnostic.lineNumber = lineNumber;
+	copyString(diagnostic.fileId, sizeof(diagnostic.fileId), fileId.toRawUTF8(), fileId.getNumBytesAsUTF8());
+	copyString(diagnostic.text, sizeof(diagnostic.text), error.toRawUTF8(), error.getNumBytesAsUTF8());
+	errors.tryPush(diagnostic);
+}
+
+void LuaDiagnostics::reportLuaError(const juce::String& fileId, const char* error) {
+	Diagnostic diagnostic;
+	diagnostic.type = Type::LuaError;
+	copyString(diagnostic.fileId, sizeof(diagnostic.fileId), fileId.toRawUTF8(), fileId.getNumBytesAsUTF8());
+	copyString(diagnostic.text, sizeof(diagnostic.text), error, std::strlen(error));
+	errors.tryPush(diagnostic);
+}
+
+void LuaDiagnostics::clearLuaError(const juce::String& fileId) {
+	Diagnostic diagnostic;
+	diagnostic.type = Type::Error;
+	copyString(diagnostic.fileId, sizeof(diagnostic.fileId), fileId.toRawUTF8(), fileId.getNumBytesAsUTF8());
+	errors.tryPush(diagnostic);
+}
+
+// nil errors about sliders are likely caused by other errors, e.g.
+// "attempt to perform arithmetic on a nil value (global 'slider_a')"
+static bool isSliderNilError(const std::string& error) {
+	size_t attempt = error.find("attempt to");
+	size_t nil = attempt == std::string::npos ? attempt : error.find("nil value", attempt);
+	size_t slider = nil == std::string::npos ? nil : error.find("'slider_", nil);
+	while (slider != std::string::npos) {
+		size_t end = slider + 9;
+		if (end < error.size() && error[end] == '\'' && (std::isalnum((unsigned char) error[end - 1]) || error[end - 1] == '_')) {
+			return true;
+		}
+		slider = error.find("'slider_", slider + 1);
+	}
+	return false;
+}
+
+bool LuaDiagnostics::parseLuaError(const std::string& rawError, int& lineNumber, std::string& error) {
+	if (isSliderNilError(rawError)) {
+		return false;
+	}
+
+	error = rawError;
+	// remove any newlines from error message
+	error.erase(std::remove_if(error.begin(), error.end(), [](char c) { return c == '\n' || c == '\r'; }), error.end());
+	// remove script content from error message, e.g. [string "return..."]:
+	size_t scriptEnd = error.rfind("\"]:");
+	if (error.rfind("[string \"", 0) == 0 && scriptEnd != std::string::npos) {
+		error.erase(0, scriptEnd + 3);
+	}
+	// extract line number from start of error message
+	size_t digits = 0;
+	while (digits < error.size() && std::isdigit((unsigned char) error[digits])) {
+		digits++;
+	}
+
+	if (digits > 0 && error.compare(digits, 2, ": ") == 0) {
+		lineNumber = std::stoi(error.substr(0, digits));
+		// remove line number from error message
+		error.erase(0, digits + 2);
+		return true;
+	}
+	return false;
+}
+
+void LuaDiagnostics::print(const char* text, size_t length) {
+	Diagnostic diagnostic;
+	diagnostic.type = Type::Print;
+	copyString(diagnostic.text, sizeof(diagnostic.text), text, length);
+	if (console.tryPush(diagnostic)) {
+		consoleCleared.store(false, std::memory_order_relaxed);
+	} else {
+		droppedMessages++;
+	}
+}
+
+void LuaDiagnostics::clearConsole() {
+	if (consoleCleared.exchange(true)) {
+		return;
+	}
+
+	Diagnostic diagnostic;
+	diagnostic.type = Type::ClearConsole;
+	if (!console.tryPush(diagnostic)) {
+		consoleCleared = false;
+	}
+}
+
+void LuaDiagnostics::timerCallback() {
+	Diagnostic diagnostic;
+
+	while (errors.tryPop(diagnostic)) {
+		int lineNumber = diagnostic.lineNumber;
+		std::string error = diagnostic.text;
+		if (diagnostic.type == Type::LuaError && !parseLuaError(diagnostic.text, lineNumber, error)) {
+			continue;
+		}
+		if (onError != nullptr) {
+			onError(lineNumber, juce::String::fromUTF8(diagnostic.fileId), juce::String::fromUTF8(error.c_str()));
+		}
+	}
+
+	// only drain what was there when we started, so a script that prints
+	// constantly can't keep the message thread busy
+	for (size_t i = 0; i < console.getCapacity() && console.tryPop(diagnostic); i++) {
+		if (diagnostic.type == Type::Print) {
+			if (onPrint != nullptr) {
+				onPrint(diagnostic.text);
+			}
+		} else if (onClear != nullptr) {
+			onClear();
+		}
+	}
+
+	int dropped = droppedMessages.exchange(0);
+	if (dropped > 0 && onPrint != nullptr) {
+		onPrint("(" + std::to_string(dropped) + " messages dropped)");
+	}
+}
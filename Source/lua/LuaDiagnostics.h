@@ -0,0 +1,59 @@
+#pragma once
+#include <JuceHeader.h>
+#include "../concurrency/LockFreeQueue.h"
+
+// Carries Lua errors, prints and console clears from the threads running
+// scripts, usually the audio thread, to the message thread. Posting only
+// copies the message into a fixed-size slot of a lock-free queue, and the
+// callbacks are called when the queues are drained on the message thread.
+//
+// Messages are dropped rather than waiting when a queue is full, and prints
+// longer than a slot are truncated.
+class LuaDiagnostics : private juce::Timer {
+public:
+	LuaDiagnostics();
+	~LuaDiagnostics() override;
+
+	// these can be called from any thread, and never block or allocate
+	void reportError(int lineNumber, const juce::String& fileId, const juce::String& error);
+	// the error is parsed with parseLuaError on the message thread
+	void reportLuaError(const juce::String& fileId, const char* error);
+	void clearLuaError(const juce::String& fileId);
+	void print(const char* text, size_t length);
+	void clearConsole();
+
+	// Extracts the line number and message from an error raised by Lua.
+	// Returns false if the error shouldn't be shown.
+	static bool parseLuaError(const std::string& rawError, int& lineNumber, std::string& error);
+
+	std::function<void(int, juce::String, juce::String)> onError;
+	std::function<void(const std::string&)> onPrint;
+	std::function<void()> onClear;
+
+private:
+	enum class Type {
+		Error,
+		LuaError,
+		Print,
+		ClearConsole,
+	};
+
+	struct Diagnostic {
+		Type type = Type::Print;
+		int lineNumber = -1;
+		char fileId[64] = { 0 };
+		char text[448] = { 0 };
+	};
+
+	void timerCallback() override;
+
+	// errors have their own queue so that a script printing every sample
+	// can't cause an error, or the clearing of one, to be dropped
+	LockFreeQueue<Diagnostic> errors = LockFreeQueue<Diagnostic>(64);
+	LockFreeQueue<Diagnostic> console = LockFreeQueue<Diagnostic>(256);
+	std::atomic<int> droppedMessages = 0;
+	// consecutive clears are only posted once
+	std::atomic<bool> consoleCleared = false;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LuaDiagnostics)
+};
@@ -0,0 +1,467 @@
+#include "LuaExpression.h"
+#include "LuaWaves.h"
+#include <map>
+
+class LuaExpressionCompiler {
+public:
+	LuaExpressionCompiler(const std::string& script) : script(script) {
+		expression = std::make_unique<LuaExpression>();
+		expression->registers.resize(LuaExpression::NUM_INPUTS, 0.0);
+	}
+
+	std::unique_ptr<LuaExpression> compile() {
+		next();
+		while (!failed && token == Token::Local) {
+			parseLocal();
+		}
+		parseReturn();
+
+		if (failed || token != Token::End || expression->outputs.empty()) {
+			return nullptr;
+		}
+		return std::move(expression);
+	}
+
+private:
+	enum class Token {
+		Number,
+		Name,
+		Local,
+		Return,
+		Symbol,
+		End,
+		Invalid,
+	};
+
+	const std::string& script;
+	size_t pos = 0;
+
+	Token token = Token::Invalid;
+	std::string text;
+	double number = 0.0;
+
+	bool failed = false;
+	std::unique_ptr<LuaExpression> expression;
+	std::map<std::string, int> locals;
+	std::map<double, int> constants;
+	// registers that are written by an instruction, rather than being an input or a constant
+	std::vector<bool> isTemporary = std::vector<bool>(LuaExpression::NUM_INPUTS, false);
+
+	void skipWhitespaceAndComments() {
+		while (pos < script.size()) {
+			if (std::isspace((unsigned char) script[pos])) {
+				pos++;
+			} else if (script.compare(pos, 4, "--[[") == 0) {
+				size_t end = script.find("]]", pos + 4);
+				pos = end == std::string::npos ? script.size() : end + 2;
+			} else if (script.compare(pos, 2, "--") == 0) {
+				size_t end = script.find('\n', pos);
+				pos = end == std::string::npos ? script.size() : end + 1;
+			} else {
+				break;
+			}
+		}
+	}
+
+	void next() {
+		skipWhitespaceAndComments();
+		text.clear();
+
+		if (pos >= script.size()) {
+			token = Token::End;
+			return;
+		}
+
+		char c = script[pos];
+		if (std::isdigit((unsigned char) c) || (c == '.' && pos + 1 < script.size() && std::isdigit((unsigned char) script[pos + 1]))) {
+			// hexadecimal literals are rare enough that we leave them to Lua
+			if (script.compare(pos, 2, "0x") == 0 || script.compare(pos, 2, "0X") == 0) {
+				token = Token::Invalid;
+				return;
+			}
+			// strtod depends on the locale, which a host may have changed to
+			// one that uses a decimal comma, so JUCE's parser is used instead
+			juce::CharPointer_ASCII start(script.c_str() + pos);
+			juce::CharPointer_ASCII end = start;
+			number = juce::CharacterFunctions::readDoubleValue(end);
+			pos += end.getAddress() - start.getAddress();
+			token = Token::Number;
+		} else if (std::isalpha((unsigned char) c) || c == '_') {
+			size_t start = pos;
+			while (pos < script.size() && (std::isalnum((unsigned char) script[pos]) || script[pos] == '_')) {
+				pos++;
+			}
+			text = script.substr(start, pos - start);
+			if (text == "local") {
+				token = Token::Local;
+			} else if (text == "return") {
+				token = Token::Return;
+			} else if (isKeyword(text)) {
+				token = Token::Invalid;
+			} else {
+				token = Token::Name;
+			}
+		} else if (script.compare(pos, 2, "//") == 0) {
+			text = "//";
+			pos += 2;
+			token = Token::Symbol;
+		} else if (std::string("+-*/%^(){},;=.").find(c) != std::string::npos) {
+			text = std::string(1, c);
+			pos++;
+			token = Token::Symbol;
+		} else {
+			token = Token::Invalid;
+		}
+	}
+
+	static bool isKeyword(const std::string& name) {
+		static const char* keywords[] = {
+			"and", "break", "do", "else", "elseif", "end", "false", "for", "function", "goto", "if",
+			"in", "nil", "not", "or", "repeat", "then", "true", "until", "while",
+		};
+		for (auto keyword : keywords) {
+			if (name == keyword) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool isSymbol(const char* symbol) {
+		return token == Token::Symbol && text == symbol;
+	}
+
+	void expect(const char* symbol) {
+		if (!isSymbol(symbol)) {
+			failed = true;
+		}
+		next();
+	}
+
+	void parseLocal() {
+		next();
+		if (token != Token::Name) {
+			failed = true;
+			return;
+		}
+		std::string name = text;
+		next();
+		expect("=");
+		int value = parseExpression(0);
+		// locals are bound after the expression so that "local a = a + 1" refers to the previous a
+		locals[name] = value;
+		if (isSymbol(";")) {
+			next();
+		}
+	}
+
+	void parseReturn() {
+		if (token != Token::Return) {
+			failed = true;
+			return;
+		}
+		next();
+		expect("{");
+		while (!failed && !isSymbol("}")) {
+			expression->outputs.push_back(parseExpression(0));
+			if (isSymbol(",") || isSymbol(";")) {
+				next();
+			} else if (!isSymbol("}")) {
+				failed = true;
+			}
+		}
+		expect("}");
+		if (isSymbol(";")) {
+			next();
+		}
+	}
+
+	static int binaryPrecedence(const std::string& op) {
+		if (op == "+" || op == "-") return 1;
+		if (op == "*" || op == "/" || op == "//" || op == "%") return 2;
+		if (op == "^") return 4;
+		return -1;
+	}
+
+	static const int UNARY_PRECEDENCE = 3;
+
+	// precedence climbing, using the same precedences as Lua
+	int parseExpression(int minPrecedence) {
+		int left;
+		if (isSymbol("-")) {
+			next();
+			left = emit(LuaExpression::Op::Neg, parseExpression(UNARY_PRECEDENCE));
+		} else {
+			left = parsePrimary();
+		}
+
+		while (!failed && token == Token::Symbol) {
+			std::string op = text;
+			int precedence = binaryPrecedence(op);
+			if (precedence < 0 || precedence < minPrecedence) {
+				break;
+			}
+			next();
+			// ^ is right associative
+			int right = parseExpression(op == "^" ? precedence : precedence + 1);
+			left = emit(binaryOp(op), left, right);
+		}
+
+		return left;
+	}
+
+	static LuaExpression::Op binaryOp(const std::string& op) {
+		if (op == "+") return LuaExpression::Op::Add;
+		if (op == "-") return LuaExpression::Op::Sub;
+		if (op == "*") return LuaExpression::Op::Mul;
+		if (op == "/") return LuaExpression::Op::Div;
+		if (op == "//") return LuaExpression::Op::IntDiv;
+		if (op == "%") return LuaExpression::Op::Mod;
+		return LuaExpression::Op::Pow;
+	}
+
+	int parsePrimary() {
+		if (token == Token::Number) {
+			int reg = constant(number);
+			next();
+			return reg;
+		} else if (isSymbol("(")) {
+			next();
+			int reg = parseExpression(0);
+			expect(")");
+			return reg;
+		} else if (token == Token::Name) {
+			std::string name = text;
+			next();
+			if (name == "math" && isSymbol(".")) {
+				next();
+				if (token != Token::Name) {
+					failed = true;
+					return 0;
+				}
+				name = "math." + text;
+				next();
+			}
+			if (isSymbol("(")) {
+				return parseCall(name);
+			}
+			return variable(name);
+		}
+
+		failed = true;
+		return 0;
+	}
+
+	int variable(const std::string& name) {
+		auto local = locals.find(name);
+		if (local != locals.end()) {
+			return local->second;
+		}
+		if (name == "x" || name == "y" || name == "z") {
+			expression->effectInputs = true;
+			return LuaExpression::X + (name[0] - 'x');
+		}
+		if (name == "phase") return LuaExpression::PHASE;
+		if (name == "step") return LuaExpression::STEP;
+		if (name == "sample_rate") return LuaExpression::SAMPLE_RATE;
+		if (name == "frequency") return LuaExpression::FREQUENCY;
+		if (name == "math.pi") return constant(std::numbers::pi);
+		if (name == "math.huge") return constant(HUGE_VAL);
+		for (int i = 0; i < NUM_SLIDERS; i++) {
+			if (name == SLIDER_NAMES[i]) {
+				return LuaExpression::FIRST_SLIDER + i;
+			}
+		}
+
+		// any other global could be state kept between samples
+		failed = true;
+		return 0;
+	}
+
+	int parseCall(const std::string& name) {
+		next();
+		std::vector<int> args;
+		while (!failed && !isSymbol(")")) {
+			args.push_back(parseExpression(0));
+			if (isSymbol(",")) {
+				next();
+			} else if (!isSymbol(")")) {
+				failed = true;
+			}
+		}
+		expect(")");
+		if (failed) {
+			return 0;
+		}
+
+		using Op = LuaExpression::Op;
+		static const std::map<std::string, Op> unaryFunctions = {
+			{"math.sin", Op::Sin},
+			{"math.cos", Op::Cos},
+			{"math.tan", Op::Tan},
+			{"math.asin", Op::Asin},
+			{"math.acos", Op::Acos},
+			{"math.atan", Op::Atan},
+			{"math.sqrt", Op::Sqrt},
+			{"math.abs", Op::Abs},
+			{"math.floor", Op::Floor},
+			{"math.ceil", Op::Ceil},
+			{"math.exp", Op::Exp},
+			{"math.log", Op::Log},
+			{"osci_square_wave", Op::SquareWave},
+			{"osci_saw_wave", Op::SawWave},
+			{"osci_triangle_wave", Op::TriangleWave},
+		};
+		static const std::map<std::string, Op> binaryFunctions = {
+			{"math.atan", Op::Atan2},
+			{"math.log", Op::LogBase},
+			{"math.fmod", Op::Fmod},
+			{"math.min", Op::Min},
+			{"math.max", Op::Max},
+		};
+
+		if (args.size() == 1 && unaryFunctions.count(name) > 0) {
+			return emit(unaryFunctions.at(name), args[0]);
+		}
+		if (args.size() >= 2 && binaryFunctions.count(name) > 0) {
+			Op op = binaryFunctions.at(name);
+			bool variadic = op == Op::Min || op == Op::Max;
+			if (args.size() > 2 && !variadic) {
+				failed = true;
+				return 0;
+			}
+			int result = emit(op, args[0], args[1]);
+			for (int i = 2; i < args.size(); i++) {
+				result = emit(op, result, args[i]);
+			}
+			return result;
+		}
+
+		failed = true;
+		return 0;
+	}
+
+	int constant(double value) {
+		// NaN can't be used as a map key, and can't be shared anyway
+		if (!std::isnan(value)) {
+			auto existing = constants.find(value);
+			if (existing != constants.end()) {
+				return existing->second;
+			}
+		}
+		int reg = expression->registers.size();
+		expression->registers.push_back(value);
+		isTemporary.push_back(false);
+		if (!std::isnan(value)) {
+			constants[value] = reg;
+		}
+		return reg;
+	}
+
+	bool isConstant(int reg) {
+		return reg >= LuaExpression::NUM_INPUTS && !isTemporary[reg];
+	}
+
+	int emit(LuaExpression::Op op, int a, int b = 0) {
+		LuaExpression::Instruction instruction = { op, 0, a, b };
+		// fold operations on constants at compile time
+		if (isConstant(a) && (isUnary(op) || isConstant(b))) {
+			double value = LuaExpression::apply(instruction, expression->registers.data());
+			return constant(value);
+		}
+
+		instruction.dst = expression->registers.size();
+		expression->registers.push_back(0.0);
+		isTemporary.push_back(true);
+		expression->instructions.push_back(instruction);
+		return instruction.dst;
+	}
+
+	static bool isUnary(LuaExpression::Op op) {
+		using Op = LuaExpression::Op;
+		switch (op) {
+			case Op::Add: case Op::Sub: case Op::Mul: case Op::Div: case Op::IntDiv: case Op::Mod: case Op::Pow:
+			case Op::Atan2: case Op::LogBase: case Op::Min: case Op::Max: case Op::Fmod:
+				return false;
+			default:
+				return true;
+		}
+	}
+};
+
+std::unique_ptr<LuaExpression> LuaExpression::compile(const juce::String& script) {
+	std::string source = script.toStdString();
+	LuaExpressionCompiler compiler(source);
+	return compiler.compile();
+}
+
+// matches the behaviour of the equivalent Lua operators and functions
+double LuaExpression::apply(const Instruction& instruction, const double* registers) {
+	double a = registers[instruction.a];
+	double b = registers[instruction.b];
+
+	switch (instruction.op) {
+		case Op::Add: return a + b;
+		case Op::Sub: return a - b;
+		case Op::Mul: return a * b;
+		case Op::Div: return a / b;
+		case Op::IntDiv: return std::floor(a / b);
+		case Op::Mod: {
+			double m = std::fmod(a, b);
+			return (m != 0 && (m < 0) != (b < 0)) ? m + b : m;
+		}
+		case Op::Pow: return std::pow(a, b);
+		case Op::Neg: return -a;
+		case Op::Sin: return std::sin(a);
+		case Op::Cos: return std::cos(a);
+		case Op::Tan: return std::tan(a);
+		case Op::Asin: return std::asin(a);
+		case Op::Acos: return std::acos(a);
+		case Op::Atan: return std::atan(a);
+		case Op::Atan2: return std::atan2(a, b);
+		case Op::Sqrt: return std::sqrt(a);
+		case Op::Abs: return std::abs(a);
+		case Op::Floor: return std::floor(a);
+		case Op::Ceil: return std::ceil(a);
+		case Op::Exp: return std::exp(a);
+		case Op::Log: return std::log(a);
+		case Op::LogBase: return b == 2 ? std::log2(a) : b == 10 ? std::log10(a) : std::log(a) / std::log(b);
+		case Op::Min: return std::min(a, b);
+		case Op::Max: return std::max(a, b);
+		case Op::Fmod: return std::fmod(a, b);
+		case Op::SquareWave: return squareWave(a);
+		case Op::SawWave: return sawWave(a);
+		case Op::TriangleWave: return triangleWave(a);
+	}
+	return 0.0;
+}
+
+int LuaExpression::evaluate(const LuaVariables& vars, float* values, int maxValues) {
+	// each thread evaluates into its own copy of the registers so that
+	// voices can share a compiled expression
+	thread_local std::vector<double> scratch;
+	scratch.assign(registers.begin(), registers.end());
+	double* r = scratch.data();
+	r[X] = vars.x;
+	r[Y] = vars.y;
+	r[Z] = vars.z;
+	r[PHASE] = vars.phase;
+	r[STEP] = vars.step;
+	r[SAMPLE_RATE] = vars.sampleRate;
+	r[FREQUENCY] = vars.frequency;
+	std::copy(std::begin(vars.sliders), std::end(vars.sliders), r + FIRST_SLIDER);
+
+	for (auto& instruction : instructions) {
+		r[instruction.dst] = apply(instruction, r);
+	}
+
+	int numValues = std::min((int) outputs.size(), maxValues);
+	for (int i = 0; i < numValues; i++) {
+		values[i] = r[outputs[i]];
+	}
+	return numValues;
+}
+
+bool LuaExpression::usesEffectInputs() {
+	return effectInputs;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <JuceHeader.h>
+#include "LuaParser.h"
+
+// Compiles Lua scripts that are a pure function of their inputs into a small
+// register bytecode, so they can be evaluated without the Lua VM. This covers
+// most custom effects, e.g.
+//
+//   local r = math.sqrt(x * x + y * y)
+//   return { x * (1 + slider_a * r), y, z }
+//
+// Only a sequence of local assignments followed by returning a table of
+// arithmetic expressions is supported. Expressions may use numbers, the
+// built-in variables, previously declared locals, + - * / // % ^, the math
+// library and the osci_*_wave functions. Anything else (globals, control flow,
+// strings, other function calls) makes compile return nullptr so that the
+// script runs through Lua as normal.
+class LuaExpression {
+public:
+	static std::unique_ptr<LuaExpression> compile(const juce::String& script);
+
+	// writes at most maxValues outputs into values and returns how many it wrote
+	int evaluate(const LuaVariables& vars, float* values, int maxValues);
+	// true if the script reads x, y or z, which are only defined for effects
+	bool usesEffectInputs();
+
+	enum class Op {
+		Add,
+		Sub,
+		Mul,
+		Div,
+		IntDiv,
+		Mod,
+		Pow,
+		Neg,
+		Sin,
+		Cos,
+		Tan,
+		Asin,
+		Acos,
+		Atan,
+		Atan2,
+		Sqrt,
+		Abs,
+		Floor,
+		Ceil,
+		Exp,
+		Log,
+		LogBase,
+		Min,
+		Max,
+		Fmod,
+		SquareWave,
+		SawWave,
+		TriangleWave,
+	};
+
+	struct Instruction {
+		Op op;
+		int dst;
+		int a;
+		int b;
+	};
+
+private:
+	friend class LuaExpressionCompiler;
+
+	static double apply(const Instruction& instruction, const double* registers);
+
+	// the inputs come first in the registers, followed by constants and
+	// temporaries. This holds the initial values, i.e. the constants.
+	static const int X = 0;
+	static const int Y = 1;
+	static const int Z = 2;
+	static const int PHASE = 3;
+	static const int STEP = 4;
+	static const int SAMPLE_RATE = 5;
+	static const int FREQUENCY = 6;
+	static const int FIRST_SLIDER = 7;
+	static const int NUM_INPUTS = FIRST_SLIDER + NUM_SLIDERS;
+
+	std::vector<double> registers;
+	std::vector<Instruction> instructions;
+	std::vector<int> outputs;
+	bool effectInputs = false;
+};
@@ -1,11 +1,35 @@
 #include "LuaParser.h"
+#include "LuaExpression.h"
+#include "LuaDiagnostics.h"
+#include "LuaWaves.h"
 #include "luaimport.h"
 #include "../shape/Line.h"
 #include "../shape/CircleArc.h"
 #include "../shape/QuadraticBezierCurve.h"
 
-std::function<void(const std::string&)> LuaParser::onPrint;
-std::function<void()> LuaParser::onClear;
+static const char* LUA_VEC3_METATABLE = "osci_vec3";
+static const char* LUA_SHAPE_METATABLE = "osci_shape";
+
+// Information about the script loaded into a particular lua_State, stored in
+// the state's extra space. Keeping this out of LuaParser means that several
+// states (e.g. one per voice) can run the same parser concurrently.
+struct LuaStateInfo {
+    int parserId;
+    juce::String script;
+    int functionRef = -1;
+    bool usingFallbackScript = false;
+    // where print() and clear() in the script send their output
+    LuaDiagnostics* diagnostics = nullptr;
+};
+
+static LuaStateInfo*& stateInfo(lua_State* L) {
+    return *(LuaStateInfo**) lua_getextraspace(L);
+}
+
+static std::atomic<int> nextParserId = 1;
+
+// new errors are reported at most this often, per parser
+static const uint32_t ERROR_REPORT_INTERVAL_MS = 100;
 
 void LuaParser::maximumInstructionsReached(lua_State* L, lua_Debug* D) {
     lua_getstack(L, 1, D);
@@ -24,48 +48,304 @@ void LuaParser::resetMaximumInstructions(lua_State*& L) {
     lua_sethook(L, LuaParser::maximumInstructionsReached, 0, 0);
 }
 
-static int pointToTable(lua_State* L, OsciPoint point, int numDims) {
-    lua_newtable(L);
-    if (numDims == 1) {
-        lua_pushnumber(L, point.x);
-        lua_rawseti(L, -2, 1);
-    } else if (numDims == 2) {
-        lua_pushnumber(L, point.x);
-        lua_rawseti(L, -2, 1);
-        lua_pushnumber(L, point.y);
-        lua_rawseti(L, -2, 2);
-    } else {
-        lua_pushnumber(L, point.x);
-        lua_rawseti(L, -2, 1);
-        lua_pushnumber(L, point.y);
-        lua_rawseti(L, -2, 2);
-        lua_pushnumber(L, point.z);
-        lua_rawseti(L, -2, 3);
-    }
+// Points are passed to and from Lua as a vec3 userdata rather than a table.
+// This avoids building a new table (and its array part) for every helper
+// call, and lets us read arguments without going through lua_gettable.
+// Tables are still accepted everywhere a point is expected so that
+// existing scripts keep working.
+struct LuaVec3 {
+    double x, y, z;
+    // number of components the point reports to Lua, e.g. through #v
+    int dims;
+};
+
+static LuaVec3* toVec3(lua_State* L, int index) {
+    return (LuaVec3*) luaL_testudata(L, index, LUA_VEC3_METATABLE);
+}
+
+static LuaVec3* pushVec3(lua_State* L, double x, double y, double z, int dims) {
+    LuaVec3* vec = (LuaVec3*) lua_newuserdatauv(L, sizeof(LuaVec3), 0);
+    vec->x = x;
+    vec->y = y;
+    vec->z = z;
+    vec->dims = dims;
+    luaL_setmetatable(L, LUA_VEC3_METATABLE);
+    return vec;
+}
 
+static int pointToTable(lua_State* L, OsciPoint point, int numDims) {
+    pushVec3(L, point.x, point.y, point.z, numDims);
     return 1;
 }
 
 static OsciPoint tableToPoint(lua_State* L, int index) {
+    LuaVec3* vec = toVec3(L, index);
+    if (vec != nullptr) {
+        return OsciPoint(vec->x, vec->y, vec->z);
+    }
+
     OsciPoint point;
-    lua_pushinteger(L, 1);
-    lua_gettable(L, index);
+    index = lua_absindex(L, index);
+    lua_geti(L, index, 1);
     point.x = lua_tonumber(L, -1);
-    lua_pop(L, 1);
-
-    lua_pushinteger(L, 2);
-    lua_gettable(L, index);
+    lua_geti(L, index, 2);
     point.y = lua_tonumber(L, -1);
-    lua_pop(L, 1);
-
-    lua_pushinteger(L, 3);
-    lua_gettable(L, index);
+    lua_geti(L, index, 3);
     point.z = lua_tonumber(L, -1);
-    lua_pop(L, 1);
+    lua_pop(L, 3);
 
     return point;
 }
 
+static int pointDims(lua_State* L, int index) {
+    LuaVec3* vec = toVec3(L, index);
+    if (vec != nullptr) {
+        return vec->dims;
+    } else if (lua_istable(L, index)) {
+        return juce::jlimit(1, 3, (int) lua_rawlen(L, index));
+    }
+    return 1;
+}
+
+// reads either a point or a number, which is broadcast to all components
+static OsciPoint operandToPoint(lua_State* L, int index) {
+    if (lua_type(L, index) == LUA_TNUMBER) {
+        double value = lua_tonumber(L, index);
+        return OsciPoint(value, value, value);
+    }
+    luaL_argexpected(L, toVec3(L, index) != nullptr || lua_istable(L, index), index, "vec3, table or number");
+    return tableToPoint(L, index);
+}
+
+static int operandDims(lua_State* L, int index) {
+    return lua_type(L, index) == LUA_TNUMBER ? 1 : pointDims(L, index);
+}
+
+static int componentIndex(lua_State* L, int keyIndex) {
+    if (lua_type(L, keyIndex) == LUA_TNUMBER) {
+        lua_Integer i = lua_tointeger(L, keyIndex);
+        return i >= 1 && i <= 3 ? (int) i : 0;
+    } else if (lua_type(L, keyIndex) == LUA_TSTRING) {
+        size_t len;
+        const char* key = lua_tolstring(L, keyIndex, &len);
+        if (len == 1 && key[0] >= 'x' && key[0] <= 'z') {
+            return key[0] - 'x' + 1;
+        }
+    }
+    return 0;
+}
+
+static double& vec3Component(LuaVec3* vec, int component) {
+    return component == 1 ? vec->x : component == 2 ? vec->y : vec->z;
+}
+
+static int luaVec3(lua_State* L) {
+    int nargs = lua_gettop(L);
+
+    if (nargs == 1 && lua_type(L, 1) != LUA_TNUMBER) {
+        return pointToTable(L, tableToPoint(L, 1), pointDims(L, 1));
+    }
+
+    double x = luaL_optnumber(L, 1, 0);
+    double y = luaL_optnumber(L, 2, 0);
+    double z = luaL_optnumber(L, 3, 0);
+    pushVec3(L, x, y, z, 3);
+    return 1;
+}
+
+static int vec3Index(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) lua_touserdata(L, 1);
+    int component = componentIndex(L, 2);
+
+    // numeric indices behave like the old table result, so v[3] is nil for 2D points
+    if (component != 0 && (lua_type(L, 2) == LUA_TSTRING || component <= vec->dims)) {
+        lua_pushnumber(L, vec3Component(vec, component));
+    } else if (lua_type(L, 2) == LUA_TSTRING) {
+        lua_pushvalue(L, 2);
+        lua_rawget(L, lua_upvalueindex(1));
+    } else {
+        lua_pushnil(L);
+    }
+    return 1;
+}
+
+static int vec3NewIndex(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) lua_touserdata(L, 1);
+    int component = componentIndex(L, 2);
+    luaL_argcheck(L, component != 0, 2, "vec3 only has components x, y, z (or 1, 2, 3)");
+
+    vec3Component(vec, component) = luaL_checknumber(L, 3);
+    vec->dims = juce::jmax(vec->dims, component);
+    return 0;
+}
+
+static int vec3Len(lua_State* L) {
+    lua_pushinteger(L, ((LuaVec3*) lua_touserdata(L, 1))->dims);
+    return 1;
+}
+
+static int vec3ToString(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) lua_touserdata(L, 1);
+    lua_pushfstring(L, "vec3(%f, %f, %f)", vec->x, vec->y, vec->z);
+    return 1;
+}
+
+static int vec3Eq(lua_State* L) {
+    LuaVec3* a = toVec3(L, 1);
+    LuaVec3* b = toVec3(L, 2);
+    lua_pushboolean(L, a != nullptr && b != nullptr && a->x == b->x && a->y == b->y && a->z == b->z);
+    return 1;
+}
+
+static int vec3Unm(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) lua_touserdata(L, 1);
+    pushVec3(L, -vec->x, -vec->y, -vec->z, vec->dims);
+    return 1;
+}
+
+template <typename Op>
+static int vec3Arithmetic(lua_State* L, Op op) {
+    OsciPoint a = operandToPoint(L, 1);
+    OsciPoint b = operandToPoint(L, 2);
+    int dims = juce::jmax(operandDims(L, 1), operandDims(L, 2));
+    pushVec3(L, op(a.x, b.x), op(a.y, b.y), op(a.z, b.z), dims);
+    return 1;
+}
+
+static int vec3Add(lua_State* L) { return vec3Arithmetic(L, std::plus<double>()); }
+static int vec3Sub(lua_State* L) { return vec3Arithmetic(L, std::minus<double>()); }
+static int vec3Mul(lua_State* L) { return vec3Arithmetic(L, std::multiplies<double>()); }
+static int vec3Div(lua_State* L) { return vec3Arithmetic(L, std::divides<double>()); }
+
+// In-place variants. These modify the vec3 they are called on and return
+// it, so calls can be chained without allocating, e.g. p:rotate(0, 0, a):add(offset)
+template <typename Op>
+static int vec3ArithmeticInPlace(lua_State* L, Op op) {
+    LuaVec3* vec = (LuaVec3*) luaL_checkudata(L, 1, LUA_VEC3_METATABLE);
+    OsciPoint other = operandToPoint(L, 2);
+    vec->x = op(vec->x, other.x);
+    vec->y = op(vec->y, other.y);
+    vec->z = op(vec->z, other.z);
+    vec->dims = juce::jmax(vec->dims, operandDims(L, 2));
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int vec3AddInPlace(lua_State* L) { return vec3ArithmeticInPlace(L, std::plus<double>()); }
+static int vec3SubInPlace(lua_State* L) { return vec3ArithmeticInPlace(L, std::minus<double>()); }
+static int vec3MulInPlace(lua_State* L) { return vec3ArithmeticInPlace(L, std::multiplies<double>()); }
+static int vec3DivInPlace(lua_State* L) { return vec3ArithmeticInPlace(L, std::divides<double>()); }
+
+static int vec3Set(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) luaL_checkudata(L, 1, LUA_VEC3_METATABLE);
+    if (lua_gettop(L) == 2 && lua_type(L, 2) != LUA_TNUMBER) {
+        OsciPoint point = tableToPoint(L, 2);
+        vec->x = point.x;
+        vec->y = point.y;
+        vec->z = point.z;
+        vec->dims = pointDims(L, 2);
+    } else {
+        vec->x = luaL_optnumber(L, 2, 0);
+        vec->y = luaL_optnumber(L, 3, 0);
+        vec->z = luaL_optnumber(L, 4, 0);
+        vec->dims = 3;
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int vec3Rotate(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) luaL_checkudata(L, 1, LUA_VEC3_METATABLE);
+    OsciPoint point = OsciPoint(vec->x, vec->y, vec->z);
+    if (lua_gettop(L) == 2) {
+        point.rotate(0, 0, luaL_checknumber(L, 2));
+    } else {
+        point.rotate(luaL_checknumber(L, 2), luaL_checknumber(L, 3), luaL_checknumber(L, 4));
+        vec->dims = 3;
+    }
+    vec->x = point.x;
+    vec->y = point.y;
+    vec->z = point.z;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int vec3Mix(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) luaL_checkudata(L, 1, LUA_VEC3_METATABLE);
+    OsciPoint other = tableToPoint(L, 2);
+    double weight = luaL_checknumber(L, 3);
+    vec->x = vec->x * (1 - weight) + other.x * weight;
+    vec->y = vec->y * (1 - weight) + other.y * weight;
+    vec->z = vec->z * (1 - weight) + other.z * weight;
+    vec->dims = 3;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int vec3Copy(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) luaL_checkudata(L, 1, LUA_VEC3_METATABLE);
+    pushVec3(L, vec->x, vec->y, vec->z, vec->dims);
+    return 1;
+}
+
+static int vec3Length(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) luaL_checkudata(L, 1, LUA_VEC3_METATABLE);
+    lua_pushnumber(L, std::sqrt(vec->x * vec->x + vec->y * vec->y + vec->z * vec->z));
+    return 1;
+}
+
+static int vec3Unpack(lua_State* L) {
+    LuaVec3* vec = (LuaVec3*) luaL_checkudata(L, 1, LUA_VEC3_METATABLE);
+    lua_pushnumber(L, vec->x);
+    lua_pushnumber(L, vec->y);
+    if (vec->dims < 3) {
+        return 2;
+    }
+    lua_pushnumber(L, vec->z);
+    return 3;
+}
+
+static const struct luaL_Reg vec3Methods[] = {
+    {"set", vec3Set},
+    {"add", vec3AddInPlace},
+    {"sub", vec3SubInPlace},
+    {"mul", vec3MulInPlace},
+    {"div", vec3DivInPlace},
+    {"translate", vec3AddInPlace},
+    {"scale", vec3MulInPlace},
+    {"rotate", vec3Rotate},
+    {"mix", vec3Mix},
+    {"copy", vec3Copy},
+    {"length", vec3Length},
+    {"unpack", vec3Unpack},
+    {NULL, NULL}
+};
+
+static const struct luaL_Reg vec3Metamethods[] = {
+    {"__newindex", vec3NewIndex},
+    {"__len", vec3Len},
+    {"__tostring", vec3ToString},
+    {"__eq", vec3Eq},
+    {"__unm", vec3Unm},
+    {"__add", vec3Add},
+    {"__sub", vec3Sub},
+    {"__mul", vec3Mul},
+    {"__div", vec3Div},
+    {NULL, NULL}
+};
+
+static void registerVec3(lua_State* L) {
+    luaL_newmetatable(L, LUA_VEC3_METATABLE);
+    luaL_setfuncs(L, vec3Metamethods, 0);
+
+    // __index closes over the methods table so method lookup is a single rawget
+    luaL_newlib(L, vec3Methods);
+    lua_pushcclosure(L, vec3Index, 1);
+    lua_setfield(L, -2, "__index");
+
+    lua_pop(L, 1);
+}
+
 static int luaLine(lua_State* L) {
     int nargs = lua_gettop(L);
 
@@ -229,21 +509,6 @@ static int luaLissajous(lua_State* L) {
     return pointToTable(L, OsciPoint(x, y), 2);
 }
 
-static double squareWave(double phase) {
-    double t = phase / juce::MathConstants<double>::twoPi;
-    return (t - (int) t < 0.5) ? 1 : 0;
-}
-
-static double sawWave(double phase) {
-    double t = phase / juce::MathConstants<double>::twoPi;
-    return t - std::floor(t);
-}
-
-static double triangleWave(double phase) {
-    double t = phase / juce::MathConstants<double>::twoPi;
-    return abs(2 * (t - std::floor(t)) - 1);
-}
-
 static int luaSquareWave(lua_State* L) {
     double phase = lua_tonumber(L, 1);
     lua_pushnumber(L, squareWave(phase));
@@ -321,11 +586,140 @@ static int luaRotate(lua_State* L) {
     }
 }
 
+// Shapes returned by frame-mode scripts. These are only descriptions of a
+// shape - they are converted to Shape objects once the script has returned.
+enum class LuaShapeType {
+    Line,
+    QuadraticBezier,
+    CubicBezier,
+    Arc,
+};
+
+// Lua owns the memory of a shape and never runs a destructor on it, so the
+// points are stored as plain coordinates rather than OsciPoints.
+struct LuaShape {
+    LuaShapeType type;
+    double points[4][3];
+
+    void setPoint(int i, OsciPoint point) {
+        points[i][0] = point.x;
+        points[i][1] = point.y;
+        points[i][2] = point.z;
+    }
+
+    OsciPoint getPoint(int i) {
+        return OsciPoint(points[i][0], points[i][1], points[i][2]);
+    }
+};
+
+static const char* shapeTypeName(LuaShapeType type) {
+    switch (type) {
+        case LuaShapeType::Line:
+            return "line";
+        case LuaShapeType::QuadraticBezier:
+            return "quadratic bezier";
+        case LuaShapeType::CubicBezier:
+            return "cubic bezier";
+        case LuaShapeType::Arc:
+            return "arc";
+    }
+    return "unknown";
+}
+
+static LuaShape* pushShape(lua_State* L, LuaShapeType type) {
+    LuaShape* shape = (LuaShape*) lua_newuserdatauv(L, sizeof(LuaShape), 0);
+    shape->type = type;
+    std::fill(&shape->points[0][0], &shape->points[0][0] + 12, 0.0);
+    luaL_setmetatable(L, LUA_SHAPE_METATABLE);
+    return shape;
+}
+
+static int shapeToString(lua_State* L) {
+    LuaShape* shape = (LuaShape*) luaL_checkudata(L, 1, LUA_SHAPE_METATABLE);
+    lua_pushfstring(L, "osci_shape(%s)", shapeTypeName(shape->type));
+    return 1;
+}
+
+static int luaShapeLine(lua_State* L) {
+    LuaShape* shape = pushShape(L, LuaShapeType::Line);
+    shape->setPoint(0, tableToPoint(L, 1));
+    shape->setPoint(1, tableToPoint(L, 2));
+    return 1;
+}
+
+static int luaShapeBezier(lua_State* L) {
+    int nargs = lua_gettop(L);
+    luaL_argcheck(L, nargs >= 3, nargs + 1, "a bezier curve needs 3 or 4 points");
+
+    LuaShape* shape = pushShape(L, nargs >= 4 ? LuaShapeType::CubicBezier : LuaShapeType::QuadraticBezier);
+    for (int i = 0; i < juce::jmin(nargs, 4); i++) {
+        shape->setPoint(i, tableToPoint(L, i + 1));
+    }
+    return 1;
+}
+
+static int luaShapeArc(lua_State* L) {
+    int nargs = lua_gettop(L);
+
+    OsciPoint centre = nargs >= 5 ? tableToPoint(L, 5) : OsciPoint(0, 0);
+    OsciPoint radius = OsciPoint(luaL_optnumber(L, 1, 1), luaL_optnumber(L, 2, 1));
+    OsciPoint angles = OsciPoint(luaL_optnumber(L, 3, 0), luaL_optnumber(L, 4, juce::MathConstants<double>::twoPi));
+
+    LuaShape* shape = pushShape(L, LuaShapeType::Arc);
+    shape->setPoint(0, centre);
+    shape->setPoint(1, radius);
+    shape->setPoint(2, angles);
+    return 1;
+}
+
+// returns a list of lines joining each point, which can be nested directly
+// in the list of shapes returned by the script
+static int luaShapePolyline(lua_State* L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    bool closed = lua_toboolean(L, 2);
+    int numPoints = (int) lua_rawlen(L, 1);
+    int numLines = closed ? numPoints : numPoints - 1;
+
+    lua_createtable(L, juce::jmax(numLines, 0), 0);
+    for (int i = 0; i < numLines; i++) {
+        LuaShape* shape = pushShape(L, LuaShapeType::Line);
+        lua_rawgeti(L, 1, i + 1);
+        shape->setPoint(0, tableToPoint(L, -1));
+        lua_rawgeti(L, 1, (i + 1) % numPoints + 1);
+        shape->setPoint(1, tableToPoint(L, -1));
+        lua_pop(L, 2);
+        lua_rawseti(L, -2, i + 1);
+    }
+    return 1;
+}
+
+static std::unique_ptr<Shape> luaShapeToShape(LuaShape* shape) {
+    OsciPoint p[4] = { shape->getPoint(0), shape->getPoint(1), shape->getPoint(2), shape->getPoint(3) };
+    switch (shape->type) {
+        case LuaShapeType::Line:
+            return std::make_unique<Line>(p[0], p[1]);
+        case LuaShapeType::QuadraticBezier:
+            return std::make_unique<QuadraticBezierCurve>(p[0].x, p[0].y, p[1].x, p[1].y, p[2].x, p[2].y);
+        case LuaShapeType::CubicBezier:
+            return std::make_unique<CubicBezierCurve>(p[0].x, p[0].y, p[1].x, p[1].y, p[2].x, p[2].y, p[3].x, p[3].y);
+        case LuaShapeType::Arc:
+            return std::make_unique<CircleArc>(p[0].x, p[0].y, p[1].x, p[1].y, p[2].x, p[2].y);
+    }
+    return nullptr;
+}
+
 static int luaPrint(lua_State* L) {
+    LuaDiagnostics* diagnostics = stateInfo(L)->diagnostics;
+    if (diagnostics == nullptr) {
+        return 0;
+    }
+
     int nargs = lua_gettop(L);
 
     for (int i = 1; i <= nargs; ++i) {
-        LuaParser::onPrint(luaL_tolstring(L, i, nullptr));
+        size_t length;
+        const char* text = luaL_tolstring(L, i, &length);
+        diagnostics->print(text, length);
         lua_pop(L, 1);
     }
 
@@ -333,7 +727,10 @@ static int luaPrint(lua_State* L) {
 }
 
 static int luaClear(lua_State* L) {
-    LuaParser::onClear();
+    LuaDiagnostics* diagnostics = stateInfo(L)->diagnostics;
+    if (diagnostics != nullptr) {
+        diagnostics->clearConsole();
+    }
     return 0;
 }
 
@@ -354,69 +751,96 @@ static const struct luaL_Reg luaLib[] = {
     {"osci_translate", luaTranslate},
     {"osci_scale", luaScale},
     {"osci_rotate", luaRotate},
+    {"osci_vec3", luaVec3},
+    {"osci_shape_line", luaShapeLine},
+    {"osci_shape_bezier", luaShapeBezier},
+    {"osci_shape_arc", luaShapeArc},
+    {"osci_shape_polyline", luaShapePolyline},
     {"print", luaPrint},
     {"clear", luaClear},
     {NULL, NULL} /* end of array */
 };
 
 extern int luaopen_customprintlib(lua_State* L) {
+    registerVec3(L);
+    // luaL_newmetatable also sets __name, so errors name the type
+    luaL_newmetatable(L, LUA_SHAPE_METATABLE);
+    lua_pushcfunction(L, shapeToString);
+    lua_setfield(L, -2, "__tostring");
+    lua_pop(L, 1);
     lua_getglobal(L, "_G");
     luaL_setfuncs(L, luaLib, 0);
     lua_pop(L, 1);
     return 0;
 }
 
-LuaParser::LuaParser(juce::String fileName, juce::String script, std::function<void(int, juce::String, juce::String)> errorCallback, juce::String fallbackScript) : script(script), fallbackScript(fallbackScript), errorCallback(errorCallback), fileName(fileName) {}
+LuaParser::LuaParser(juce::String fileName, juce::String script, std::function<void(int, juce::String, juce::String)> errorCallback, LuaDiagnostics* diagnostics, juce::String fallbackScript) : parserId(nextParserId++), script(script), fallbackScript(fallbackScript), errorCallback(errorCallback), fileName(fileName), diagnostics(diagnostics) {
+    frameMode = isFrameScript(script);
+    // a fallback written for the other mode would return the wrong kind of result
+    if (isFrameScript(fallbackScript) != frameMode) {
+        this->fallbackScript = frameMode ? "-- mode: frame\nreturn {}" : "return { 0.0, 0.0 }";
+    }
+    if (!frameMode) {
+        expression = LuaExpression::compile(script);
+    }
+}
+
+LuaParser::~LuaParser() {}
 
-void LuaParser::reset(lua_State*& L, juce::String script) {
-    functionRef = -1;
+bool LuaParser::isFrameScript(const juce::String& script) {
+    juce::String firstLine = script.trimStart().upToFirstOccurrenceOf("\n", false, false);
+    return firstLine.removeCharacters(" \t\r").equalsIgnoreCase("--mode:frame");
+}
 
-    if (L != nullptr) {
-        lua_close(L);
-    }
+void LuaParser::reset(lua_State*& L, juce::String script) {
+    close(L);
     
     L = luaL_newstate();
+    stateInfo(L) = new LuaStateInfo{ parserId, script, -1, false, diagnostics };
     luaL_openlibs(L);
 	luaopen_customprintlib(L);
     
-    this->script = script;
     parse(L);
 }
 
 void LuaParser::reportError(const char* errorChars) {
-    std::string error = errorChars;
-    std::regex nilRegex = std::regex(R"(attempt to.*nil value.*'slider_\w')");
-    // ignore nil errors about global variables, these are likely caused by other errors
-    if (std::regex_search(error, nilRegex)) {
+    // the same error is usually raised every sample, so only new errors are
+    // reported, and at a limited rate
+    uint32_t now = juce::Time::getMillisecondCounter();
+    if (hasError && now - lastErrorTime.load() < ERROR_REPORT_INTERVAL_MS) {
         return;
     }
-
-    // remove any newlines from error message
-    error = std::regex_replace(error, std::regex(R"(\n|\r)"), "");
-    // remove script content from error message
-    error = std::regex_replace(error, std::regex(R"(^\[string ".*"\]:)"), "");
-    // extract line number from start of error message
-    std::regex lineRegex(R"(^(\d+): )");
-    std::smatch lineMatch;
-    std::regex_search(error, lineMatch, lineRegex);
-
-    if (lineMatch.size() > 1) {
-        int line = std::stoi(lineMatch[1]);
-        // remove line number from error message
-        error = std::regex_replace(error, lineRegex, "");
-        errorCallback(line, fileName, error);
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* c = errorChars; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ull;
+    }
+    if (lastErrorHash.exchange(hash) == hash && hasError) {
+        return;
+    }
+    lastErrorTime = now;
+    hasError = true;
+
+    // the error is only copied here, and is parsed on the message thread
+    if (diagnostics != nullptr) {
+        diagnostics->reportLuaError(fileName, errorChars);
+    } else if (errorCallback != nullptr) {
+        int line;
+        std::string error;
+        if (LuaDiagnostics::parseLuaError(errorChars, line, error)) {
+            errorCallback(line, fileName, error);
+        }
     }
 }
 
 void LuaParser::parse(lua_State*& L) {
-    const int ret = luaL_loadstring(L, script.toUTF8());
+    const int ret = luaL_loadstring(L, stateInfo(L)->script.toUTF8());
     if (ret != 0) {
         const char* error = lua_tostring(L, -1);
         reportError(error);
         lua_pop(L, 1);
         revertToFallback(L);
     } else {
-        functionRef = luaL_ref(L, LUA_REGISTRYINDEX);
+        stateInfo(L)->functionRef = luaL_ref(L, LUA_REGISTRYINDEX);
     }
 }
 
@@ -460,40 +884,52 @@ void LuaParser::clearStack(lua_State*& L) {
 }
 
 void LuaParser::revertToFallback(lua_State*& L) {
-    functionRef = -1;
+    LuaStateInfo* info = stateInfo(L);
+    info->functionRef = -1;
+    info->usingFallbackScript = true;
     usingFallbackScript = true;
-    if (script != fallbackScript) {
+    if (info->script != fallbackScript) {
         reset(L, fallbackScript);
+        stateInfo(L)->usingFallbackScript = true;
     }
 }
 
-void LuaParser::readTable(lua_State*& L, std::vector<float>& values) {
-    auto length = lua_rawlen(L, -1);
+// reads at most MAX_VALUES values, as nothing uses any more than that
+int LuaParser::readTable(lua_State*& L, float (&values)[MAX_VALUES]) {
+    LuaVec3* vec = toVec3(L, -1);
+    if (vec != nullptr) {
+        values[0] = vec->x;
+        values[1] = vec->y;
+        if (vec->dims >= 3) {
+            values[2] = vec->z;
+            return 3;
+        }
+        return 2;
+    }
+
+    int length = std::min((int) lua_rawlen(L, -1), MAX_VALUES);
 
     for (int i = 1; i <= length; i++) {
         lua_pushinteger(L, i);
         lua_gettable(L, -2);
-        float value = lua_tonumber(L, -1);
+        values[i - 1] = lua_tonumber(L, -1);
         lua_pop(L, 1);
-        values.push_back(value);
     }
+
+    return length;
 }
 
-// only the audio thread runs this fuction
-std::vector<float> LuaParser::run(lua_State*& L, LuaVariables& vars) {
-    // if we haven't seen this state before, reset it
-    int stateIndex = std::find(seenStates.begin(), seenStates.end(), L) - seenStates.begin();
-    if (stateIndex == seenStates.size()) {
+// pushes the result of the script onto the stack and returns true if it ran successfully
+bool LuaParser::callFunction(lua_State*& L, LuaVariables& vars) {
+    // if this state wasn't set up by this parser, reset it
+    if (L == nullptr || stateInfo(L)->parserId != parserId) {
         reset(L, script);
-        seenStates.push_back(L);
     }
 
-    std::vector<float> values;
-	
 	setGlobalVariables(L, vars);
     
 	// Get the function from the registry
-	lua_geti(L, LUA_REGISTRYINDEX, functionRef);
+	lua_geti(L, LUA_REGISTRYINDEX, stateInfo(L)->functionRef);
 
     setMaximumInstructions(L, 5000000);
     
@@ -503,42 +939,126 @@ std::vector<float> LuaParser::run(lua_State*& L, LuaVariables& vars) {
             const char* error = lua_tostring(L, -1);
             reportError(error);
             revertToFallback(L);
-        } else {            
-            if (lua_istable(L, -1)) {
-                readTable(L, values);
-            }
+        } else {
+            return true;
         }
     } else {
         revertToFallback(L);
     }
 
+    return false;
+}
+
+void LuaParser::finishCall(lua_State*& L, LuaVariables& vars) {
     resetMaximumInstructions(L);
 
-    if (functionRef != -1 && !usingFallbackScript) {
+    LuaStateInfo* info = stateInfo(L);
+    if (info->functionRef != -1 && !info->usingFallbackScript) {
         resetErrors();
     }
 
 	clearStack(L);
+}
+
+// each lua_State must only be used by one thread at a time, but different
+// states can run the same parser concurrently
+int LuaParser::run(lua_State*& L, LuaVariables& vars, float (&values)[MAX_VALUES]) {
+    int numValues = 0;
+
+    // x, y and z are only defined for effects, so other scripts using them need Lua to report the error
+    if (expression != nullptr && (vars.isEffect || !expression->usesEffectInputs())) {
+        numValues = expression->evaluate(vars, values, MAX_VALUES);
+        resetErrors();
+        incrementVars(vars);
+        return numValues;
+    }
+
+    // anything else, such as a shape returned by a script that isn't in
+    // frame mode, is ignored
+    if (callFunction(L, vars) && (lua_istable(L, -1) || toVec3(L, -1) != nullptr)) {
+        numValues = readTable(L, values);
+    }
+
+    finishCall(L, vars);
+    incrementVars(vars);
     
-	incrementVars(vars);
-    
-	return values;
+	return numValues;
+}
+
+void LuaParser::readShapes(lua_State*& L, int index, std::vector<std::unique_ptr<Shape>>& shapes) {
+    index = lua_absindex(L, index);
+    auto length = lua_rawlen(L, index);
+
+    for (int i = 1; i <= length; i++) {
+        lua_rawgeti(L, index, i);
+        LuaShape* shape = (LuaShape*) luaL_testudata(L, -1, LUA_SHAPE_METATABLE);
+        if (shape != nullptr) {
+            shapes.push_back(luaShapeToShape(shape));
+        } else if (lua_istable(L, -1)) {
+            // nested lists, e.g. from osci_shape_polyline, are flattened
+            readShapes(L, -1, shapes);
+        }
+        lua_pop(L, 1);
+    }
+}
+
+// only the frame producer thread runs this function
+std::vector<std::unique_ptr<Shape>> LuaParser::draw(lua_State*& L, LuaVariables& vars) {
+    std::vector<std::unique_ptr<Shape>> shapes;
+
+    if (callFunction(L, vars) && lua_istable(L, -1)) {
+        readShapes(L, -1, shapes);
+    }
+
+    finishCall(L, vars);
+    // A frame is drawn once per period of the frequency, so the next frame
+    // starts that many samples later, at the same phase
+    if (vars.frequency > 0) {
+        vars.step += vars.sampleRate / vars.frequency;
+    } else {
+        vars.step++;
+    }
+
+    return shapes;
 }
 
 bool LuaParser::isFunctionValid() {
-    return functionRef != -1;
+    return !usingFallbackScript;
 }
 
 juce::String LuaParser::getScript() {
     return script;
 }
 
+bool LuaParser::isFrameMode() {
+    return frameMode;
+}
+
+// this is called after every successful run, so only notifies when there
+// is an error to clear. An error is shown for at least the report interval
+// before it is cleared, so that a script that only fails some of the time
+// doesn't report and clear its error every sample.
 void LuaParser::resetErrors() {
-    errorCallback(-1, fileName, "");
+    if (!hasError.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint32_t now = juce::Time::getMillisecondCounter();
+    if (now - lastErrorTime.load() < ERROR_REPORT_INTERVAL_MS || !hasError.exchange(false)) {
+        return;
+    }
+    lastErrorTime = now;
+
+    if (diagnostics != nullptr) {
+        diagnostics->clearLuaError(fileName);
+    } else if (errorCallback != nullptr) {
+        errorCallback(-1, fileName, "");
+    }
 }
 
 void LuaParser::close(lua_State*& L) {
     if (L != nullptr) {
+        delete stateInfo(L);
         lua_close(L);
+        L = nullptr;
     }
 }
@@ -1,6 +1,5 @@
 #pragma once
 #include <JuceHeader.h>
-#include <regex>
 #include <numbers>
 #include "../shape/Shape.h"
 
@@ -60,18 +59,35 @@ struct LuaVariables {
 
 struct lua_State;
 struct lua_Debug;
+class LuaExpression;
+class LuaDiagnostics;
 class LuaParser {
 public:
-	LuaParser(juce::String fileName, juce::String script, std::function<void(int, juce::String, juce::String)> errorCallback, juce::String fallbackScript = "return { 0.0, 0.0 }");
+	// Errors, and print() and clear() in scripts, go to diagnostics if it isn't
+	// nullptr, and otherwise errors go to errorCallback. diagnostics must
+	// outlive the parser and every state it has run in.
+	LuaParser(juce::String fileName, juce::String script, std::function<void(int, juce::String, juce::String)> errorCallback, LuaDiagnostics* diagnostics = nullptr, juce::String fallbackScript = "return { 0.0, 0.0 }");
+	~LuaParser();
 
-	std::vector<float> run(lua_State*& L, LuaVariables& vars);
+	// the most values run returns, i.e. x, y and z
+	static constexpr int MAX_VALUES = 3;
+
+	// writes the values the script returns into values, and returns how many
+	// there are
+	int run(lua_State*& L, LuaVariables& vars, float (&values)[MAX_VALUES]);
+	std::vector<std::unique_ptr<Shape>> draw(lua_State*& L, LuaVariables& vars);
 	bool isFunctionValid();
+	bool isFrameMode();
 	juce::String getScript();
 	void resetErrors();
-	void close(lua_State*& L);
+	static void close(lua_State*& L);
 
-	static std::function<void(const std::string&)> onPrint;
-	static std::function<void()> onClear;
+	// Scripts whose first line is "-- mode: frame" run once per frame and
+	// return a list of shapes, rather than running once per sample. step
+	// still counts samples, moving on by a frame's worth each frame, so
+	// step / sample_rate is the time in seconds in either mode. A frame lasts
+	// one period of the frequency, so phase is the same for every frame.
+	static bool isFrameScript(const juce::String& script);
 
 private:
 	static void maximumInstructionsReached(lua_State* L, lua_Debug* D);
@@ -85,15 +101,29 @@ private:
 	void incrementVars(LuaVariables& vars);
 	void clearStack(lua_State*& L);
 	void revertToFallback(lua_State*& L);
-	void readTable(lua_State*& L, std::vector<float>& values);
+	bool callFunction(lua_State*& L, LuaVariables& vars);
+	void finishCall(lua_State*& L, LuaVariables& vars);
+	int readTable(lua_State*& L, float (&values)[MAX_VALUES]);
+	void readShapes(lua_State*& L, int index, std::vector<std::unique_ptr<Shape>>& shapes);
 	void setMaximumInstructions(lua_State*& L, int count);
 	void resetMaximumInstructions(lua_State*& L);
 
-	int functionRef = -1;
-	bool usingFallbackScript = false;
+	// identifies the states this parser has set up, see LuaStateInfo
+	const int parserId;
+	std::atomic<bool> usingFallbackScript = false;
+	bool frameMode = false;
+	// native version of the script, if it is simple enough to not need Lua
+	std::unique_ptr<LuaExpression> expression;
+	// errors are only reported when they change, and cleared when the script
+	// next runs successfully. This starts true so that any error shown for a
+	// previous version of the script is cleared.
+	std::atomic<bool> hasError = true;
+	std::atomic<uint64_t> lastErrorHash = 0;
+	// when an error or its clearing was last reported
+	std::atomic<uint32_t> lastErrorTime = 0;
 	juce::String script;
 	juce::String fallbackScript;
 	std::function<void(int, juce::String, juce::String)> errorCallback;
 	juce::String fileName;
-	std::vector<lua_State*> seenStates;
+	LuaDiagnostics* diagnostics;
 };
\ No newline at end of file
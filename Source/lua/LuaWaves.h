@@ -0,0 +1,22 @@
+#pragma once
+#include <cmath>
+#include <numbers>
+
+// The osci_*_wave functions, shared by LuaParser and LuaExpression so that
+// scripts give the same result whether or not they run through Lua. Each has
+// a period of 2 pi and goes between 0 and 1.
+
+inline double squareWave(double phase) {
+    double t = phase / (2 * std::numbers::pi);
+    return (t - (int) t < 0.5) ? 1 : 0;
+}
+
+inline double sawWave(double phase) {
+    double t = phase / (2 * std::numbers::pi);
+    return t - std::floor(t);
+}
+
+inline double triangleWave(double phase) {
+    double t = phase / (2 * std::numbers::pi);
+    return std::abs(2 * (t - std::floor(t)) - 1);
+}
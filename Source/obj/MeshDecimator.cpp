@@ -0,0 +1,339 @@
+#include "MeshDecimator.h"
+#include "../concurrency/ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+
+static const int VERTICES_PER_JOB = 16384;
+// how much more it costs to move boundary edges than the surface itself
+static const double BOUNDARY_WEIGHT = 1000;
+
+namespace {
+
+struct Vec3 {
+    double x = 0, y = 0, z = 0;
+
+    Vec3 operator+(const Vec3& o) const { return { x + o.x, y + o.y, z + o.z }; }
+    Vec3 operator-(const Vec3& o) const { return { x - o.x, y - o.y, z - o.z }; }
+    Vec3 operator*(double s) const { return { x * s, y * s, z * s }; }
+    double dot(const Vec3& o) const { return x * o.x + y * o.y + z * o.z; }
+    Vec3 cross(const Vec3& o) const { return { y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x }; }
+    double length() const { return std::sqrt(dot(*this)); }
+};
+
+// the sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    // the plane through point with the given unit normal
+    static Quadric plane(Vec3 normal, Vec3 point, double weight) {
+        double d = -normal.dot(point);
+        Quadric q;
+        q.a2 = weight * normal.x * normal.x;
+        q.ab = weight * normal.x * normal.y;
+        q.ac = weight * normal.x * normal.z;
+        q.ad = weight * normal.x * d;
+        q.b2 = weight * normal.y * normal.y;
+        q.bc = weight * normal.y * normal.z;
+        q.bd = weight * normal.y * d;
+        q.c2 = weight * normal.z * normal.z;
+        q.cd = weight * normal.z * d;
+        q.d2 = weight * d * d;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& o) {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad; b2 += o.b2;
+        bc += o.bc; bd += o.bd; c2 += o.c2; cd += o.cd; d2 += o.d2;
+        return *this;
+    }
+
+    double error(Vec3 p) const {
+        return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+            + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+            + c2 * p.z * p.z + 2 * cd * p.z + d2;
+    }
+
+    // the point with the least error, if there is a single one
+    bool minimum(Vec3& p) const {
+        double det = a2 * (b2 * c2 - bc * bc) - ab * (ab * c2 - bc * ac) + ac * (ab * bc - b2 * ac);
+        double scale = std::max({ std::abs(a2), std::abs(b2), std::abs(c2) });
+        if (std::abs(det) <= 1e-9 * scale * scale * scale) {
+            return false;
+        }
+        // Cramer's rule on A p = -b
+        double bx = -ad, by = -bd, bz = -cd;
+        p.x = (bx * (b2 * c2 - bc * bc) - ab * (by * c2 - bc * bz) + ac * (by * bc - b2 * bz)) / det;
+        p.y = (a2 * (by * c2 - bc * bz) - bx * (ab * c2 - bc * ac) + ac * (ab * bz - by * ac)) / det;
+        p.z = (a2 * (b2 * bz - by * bc) - ab * (ab * bz - by * ac) + bx * (ab * bc - b2 * ac)) / det;
+        return true;
+    }
+};
+
+struct Collapse {
+    double cost;
+    int u, v;
+    // the versions of u and v when this was computed, so stale collapses are skipped
+    int versionU, versionV;
+    Vec3 position;
+
+    bool operator>(const Collapse& o) const {
+        return cost > o.cost;
+    }
+};
+
+}
+
+void decimateMesh(ObjMesh& mesh, int targetEdges, const ParseProgress* progress) {
+    int numVertices = mesh.vertices.size() / 3;
+    auto& faces = mesh.faces;
+
+    std::vector<Vec3> positions(numVertices);
+    for (int v = 0; v < numVertices; v++) {
+        positions[v] = { mesh.vertices[3 * v], mesh.vertices[3 * v + 1], mesh.vertices[3 * v + 2] };
+    }
+
+    // split faces into fans of triangles, skipping any that are degenerate
+    std::vector<int> triangles;
+    std::vector<int> groups;
+    for (int face = 0; face < faces.size(); face++) {
+        size_t first = faces.starts[face];
+        for (size_t i = first + 1; i + 1 < faces.starts[face + 1]; i++) {
+            int a = faces.vertices[first], b = faces.vertices[i], c = faces.vertices[i + 1];
+            if (a < 0 || b < 0 || c < 0 || a >= numVertices || b >= numVertices || c >= numVertices || a == b || b == c || a == c) {
+                continue;
+            }
+            triangles.insert(triangles.end(), { a, b, c });
+            groups.push_back(faces.groups[face]);
+        }
+    }
+    int numTriangles = groups.size();
+
+    // the triangles around each vertex
+    std::vector<std::vector<int>> vertexTriangles(numVertices);
+    for (int t = 0; t < numTriangles; t++) {
+        for (int i = 0; i < 3; i++) {
+            vertexTriangles[triangles[3 * t + i]].push_back(t);
+        }
+    }
+
+    auto triangleNormal = [&](int t, int moved, Vec3 position) {
+        Vec3 corners[3];
+        for (int i = 0; i < 3; i++) {
+            int v = triangles[3 * t + i];
+            corners[i] = v == moved ? position : positions[v];
+        }
+        return (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+    };
+
+    // find each edge from the triangles around its lower vertex, and whether
+    // it's a boundary, i.e. it doesn't have exactly two triangles in the same group
+    struct Edge {
+        int u, v;
+        // one of the edge's triangles
+        int triangle;
+        bool boundary;
+    };
+    int numJobs = (numVertices + VERTICES_PER_JOB - 1) / VERTICES_PER_JOB;
+    std::vector<std::vector<Edge>> jobEdges(numJobs);
+    parallelFor(numJobs, [&](int job) {
+        std::vector<std::pair<int, int>> neighbours;
+        int end = std::min((job + 1) * VERTICES_PER_JOB, numVertices);
+        for (int u = job * VERTICES_PER_JOB; u < end; u++) {
+            neighbours.clear();
+            for (int t : vertexTriangles[u]) {
+                for (int i = 0; i < 3; i++) {
+                    int v = triangles[3 * t + i];
+                    if (v > u) {
+                        neighbours.push_back({ v, t });
+                    }
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            for (size_t i = 0; i < neighbours.size();) {
+                size_t j = i + 1;
+                while (j < neighbours.size() && neighbours[j].first == neighbours[i].first) {
+                    j++;
+                }
+                int t = neighbours[i].second;
+                bool boundary = j - i != 2 || groups[t] != groups[neighbours[i + 1].second];
+                jobEdges[job].push_back({ u, neighbours[i].first, t, boundary });
+                i = j;
+            }
+        }
+    });
+
+    std::vector<Edge> edges;
+    for (auto& job : jobEdges) {
+        edges.insert(edges.end(), job.begin(), job.end());
+        job = std::vector<Edge>();
+    }
+
+    if (edges.size() <= (size_t) std::max(targetEdges, 0) || numTriangles == 0) {
+        return;
+    }
+
+    // each collapse removes about the same number of edges per triangle removed
+    int targetTriangles = (int) ((double) numTriangles * std::max(targetEdges, 0) / edges.size());
+
+    // each vertex's quadric measures the distance to the planes of its
+    // triangles, weighted by their area, and to planes through any boundary
+    // edges at right angles to the triangle, so boundaries don't move
+    std::vector<Quadric> quadrics(numVertices);
+    parallelFor(numJobs, [&](int job) {
+        int end = std::min((job + 1) * VERTICES_PER_JOB, numVertices);
+        for (int v = job * VERTICES_PER_JOB; v < end; v++) {
+            for (int t : vertexTriangles[v]) {
+                Vec3 normal = triangleNormal(t, -1, Vec3());
+                double area = normal.length();
+                if (area > 0) {
+                    quadrics[v] += Quadric::plane(normal * (1 / area), positions[v], area / 2);
+                }
+            }
+        }
+    });
+    for (auto& edge : edges) {
+        if (!edge.boundary) {
+            continue;
+        }
+        Vec3 direction = positions[edge.v] - positions[edge.u];
+        Vec3 normal = direction.cross(triangleNormal(edge.triangle, -1, Vec3()));
+        double length = normal.length();
+        if (length > 0) {
+            Quadric q = Quadric::plane(normal * (1 / length), positions[edge.u], BOUNDARY_WEIGHT * direction.dot(direction));
+            quadrics[edge.u] += q;
+            quadrics[edge.v] += q;
+        }
+    }
+
+    std::vector<int> versions(numVertices, 0);
+    std::vector<char> removed(numVertices, false);
+
+    auto findCollapse = [&](int u, int v) {
+        Quadric q = quadrics[u];
+        q += quadrics[v];
+        Collapse collapse;
+        collapse.u = u;
+        collapse.v = v;
+        collapse.versionU = versions[u];
+        collapse.versionV = versions[v];
+        Vec3 edge = positions[v] - positions[u];
+        bool found = q.minimum(collapse.position);
+        // an almost flat region can put the minimum far from the edge
+        if (found && (collapse.position - (positions[u] + positions[v]) * 0.5).length() > 2 * edge.length()) {
+            found = false;
+        }
+        if (!found) {
+            // no single best point, so pick the best of the ends and middle
+            Vec3 middle = (positions[u] + positions[v]) * 0.5;
+            collapse.position = middle;
+            for (Vec3 p : { positions[u], positions[v] }) {
+                if (q.error(p) < q.error(collapse.position)) {
+                    collapse.position = p;
+                }
+            }
+        }
+        collapse.cost = std::max(0.0, q.error(collapse.position));
+        return collapse;
+    };
+
+    std::vector<Collapse> initial(edges.size());
+    parallelFor((int) ((edges.size() + VERTICES_PER_JOB - 1) / VERTICES_PER_JOB), [&](int job) {
+        size_t end = std::min(edges.size(), (size_t) (job + 1) * VERTICES_PER_JOB);
+        for (size_t e = (size_t) job * VERTICES_PER_JOB; e < end; e++) {
+            initial[e] = findCollapse(edges[e].u, edges[e].v);
+        }
+    });
+    edges = std::vector<Edge>();
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue(std::greater<Collapse>(), std::move(initial));
+
+    std::vector<char> alive(numTriangles, true);
+    int numAlive = numTriangles;
+    std::vector<int> neighbours;
+
+    while (numAlive > targetTriangles && !queue.empty()) {
+        if (progress != nullptr && progress->isCancelled()) {
+            break;
+        }
+        Collapse collapse = queue.top();
+        queue.pop();
+        int u = collapse.u, v = collapse.v;
+        if (removed[u] || removed[v] || versions[u] != collapse.versionU || versions[v] != collapse.versionV) {
+            continue;
+        }
+
+        // skip collapses that would flip a triangle over
+        bool flips = false;
+        for (int moved : { u, v }) {
+            for (int t : vertexTriangles[moved]) {
+                int* corners = &triangles[3 * t];
+                bool hasBoth = (corners[0] == u || corners[1] == u || corners[2] == u) && (corners[0] == v || corners[1] == v || corners[2] == v);
+                if (!alive[t] || hasBoth) {
+                    continue;
+                }
+                Vec3 before = triangleNormal(t, -1, Vec3());
+                Vec3 after = triangleNormal(t, moved, collapse.position);
+                if (before.dot(after) < 0) {
+                    flips = true;
+                }
+            }
+        }
+        if (flips) {
+            continue;
+        }
+
+        // move u to the new position, and join v's triangles onto u
+        positions[u] = collapse.position;
+        quadrics[u] += quadrics[v];
+        removed[v] = true;
+        versions[u]++;
+        for (int t : vertexTriangles[v]) {
+            if (!alive[t]) {
+                continue;
+            }
+            int* corners = &triangles[3 * t];
+            if (corners[0] == u || corners[1] == u || corners[2] == u) {
+                alive[t] = false;
+                numAlive--;
+            } else {
+                std::replace(corners, corners + 3, v, u);
+                vertexTriangles[u].push_back(t);
+            }
+        }
+        vertexTriangles[v] = std::vector<int>();
+        auto& around = vertexTriangles[u];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](int t) { return !alive[t]; }), around.end());
+
+        // the edges around u have changed cost
+        neighbours.clear();
+        for (int t : around) {
+            for (int i = 0; i < 3; i++) {
+                if (triangles[3 * t + i] != u) {
+                    neighbours.push_back(triangles[3 * t + i]);
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (int w : neighbours) {
+            queue.push(findCollapse(std::min(u, w), std::max(u, w)));
+        }
+    }
+
+    for (int v = 0; v < numVertices; v++) {
+        mesh.vertices[3 * v] = positions[v].x;
+        mesh.vertices[3 * v + 1] = positions[v].y;
+        mesh.vertices[3 * v + 2] = positions[v].z;
+    }
+
+    MeshFaces decimated;
+    for (int t = 0; t < numTriangles; t++) {
+        if (alive[t]) {
+            decimated.vertices.insert(decimated.vertices.end(), triangles.begin() + 3 * t, triangles.begin() + 3 * t + 3);
+            decimated.starts.push_back(decimated.vertices.size());
+            decimated.groups.push_back(groups[t]);
+        }
+    }
+    faces = std::move(decimated);
+}
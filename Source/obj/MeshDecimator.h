@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ObjReader.h"
+#include "../parser/ParseProgress.h"
+
+// Simplifies a mesh until it has roughly targetEdges edges, by repeatedly
+// collapsing the edge whose removal changes the shape of the mesh the least,
+// as measured by quadric error metrics (Garland and Heckbert, 1997). Faces
+// are split into triangles first, but only if the mesh needs simplifying.
+//
+// Edges on the boundary of the mesh, or between faces in different groups,
+// are held in place so that outlines survive, and collapses that would flip
+// a face over are skipped. Vertices keep their indices, so removed vertices
+// are just left unused by any face. If progress is cancelled, collapsing
+// stops early and the mesh is left partly simplified.
+void decimateMesh(ObjMesh& mesh, int targetEdges, const ParseProgress* progress = nullptr);
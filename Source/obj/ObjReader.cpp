@@ -0,0 +1,326 @@
+#include "ObjReader.h"
+#include "../concurrency/ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <string_view>
+
+// chunks are at least this many bytes, so there are plenty of jobs for
+// large files without the overhead of many tiny ones
+static const size_t CHUNK_SIZE = 1 << 20;
+
+namespace {
+
+// a change of object, group or material partway through a chunk
+struct GroupChange {
+    bool material;
+    std::string_view name;
+};
+
+struct Chunk {
+    const char* begin;
+    const char* end;
+
+    size_t numVertices = 0;
+    size_t numFaces = 0;
+    size_t numFaceVertices = 0;
+    std::vector<GroupChange> changes;
+
+    // where the chunk's vertices and faces start in the final arrays
+    size_t vertexOffset = 0;
+    size_t faceOffset = 0;
+    size_t faceVertexOffset = 0;
+    // the group of faces at the start of the chunk, and after each change
+    int startGroup = 0;
+    std::vector<int> changeGroups;
+};
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+void skipSpace(const char*& p, const char* end) {
+    while (p < end && isSpace(*p)) {
+        p++;
+    }
+}
+
+bool atLineEnd(const char* p, const char* end) {
+    return p == end || *p == '\n' || *p == '#';
+}
+
+void skipLine(const char*& p, const char* end) {
+    while (p < end && *p != '\n') {
+        p++;
+    }
+    if (p < end) {
+        p++;
+    }
+}
+
+// returns true if the line starts with keyword followed by a space or the end of the line
+bool startsWith(const char*& p, const char* end, std::string_view keyword) {
+    if (end - p < (ptrdiff_t) keyword.size() || std::string_view(p, keyword.size()) != keyword) {
+        return false;
+    }
+    const char* after = p + keyword.size();
+    if (!atLineEnd(after, end) && !isSpace(*after)) {
+        return false;
+    }
+    p = after;
+    return true;
+}
+
+// moves p to the start of the next whitespace separated token on the line,
+// returning false if there isn't one
+bool nextToken(const char*& p, const char* end) {
+    skipSpace(p, end);
+    return !atLineEnd(p, end);
+}
+
+void skipToken(const char*& p, const char* end) {
+    while (p < end && !isSpace(*p) && *p != '\n' && *p != '#') {
+        p++;
+    }
+}
+
+// the rest of the line, without surrounding whitespace or comments
+std::string_view restOfLine(const char* p, const char* end) {
+    skipSpace(p, end);
+    const char* start = p;
+    while (!atLineEnd(p, end)) {
+        p++;
+    }
+    while (p > start && isSpace(p[-1])) {
+        p--;
+    }
+    return std::string_view(start, p - start);
+}
+
+bool parseInt(const char* p, const char* end, int64_t& value) {
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9') {
+        return false;
+    }
+    value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && value < INT32_MAX) {
+        value = 10 * value + (*p++ - '0');
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
+// parses a decimal number such as -1.25e-3, which is all OBJ files use.
+// Anything that isn't a number is read as 0.
+float parseFloat(const char* p, const char* end) {
+    static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    bool negative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+')) {
+        p++;
+    }
+
+    // digits beyond what fits in the mantissa only change the exponent
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 19) {
+            mantissa = 10 * mantissa + (*p - '0');
+            digits += mantissa > 0;
+        } else {
+            exponent++;
+        }
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 19) {
+                mantissa = 10 * mantissa + (*p - '0');
+                digits += mantissa > 0;
+                exponent--;
+            }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int64_t e;
+        if (parseInt(p + 1, end, e)) {
+            exponent += (int) std::max<int64_t>(-1000, std::min<int64_t>(1000, e));
+        }
+    }
+
+    double value = (double) mantissa;
+    if (exponent < 0 && exponent >= -22) {
+        value /= powersOfTen[-exponent];
+    } else if (exponent > 0 && exponent <= 22) {
+        value *= powersOfTen[exponent];
+    } else if (exponent != 0) {
+        value *= std::pow(10.0, exponent);
+    }
+    return negative ? -value : value;
+}
+
+// Walks the lines of a chunk, calling onVertex(p) for each vertex and
+// onFace(p, numVertices) for each face, with p at the first number, and
+// onChange(change) for each new object, group or material.
+template <typename VertexFn, typename FaceFn, typename ChangeFn>
+void forEachLine(const Chunk& chunk, VertexFn onVertex, FaceFn onFace, ChangeFn onChange) {
+    const char* end = chunk.end;
+    for (const char* p = chunk.begin; p < end; skipLine(p, end)) {
+        skipSpace(p, end);
+        if (p == end) {
+            break;
+        }
+        switch (*p) {
+            case 'v':
+                if (startsWith(p, end, "v")) {
+                    onVertex(p);
+                }
+                break;
+            case 'f':
+                if (startsWith(p, end, "f")) {
+                    int count = 0;
+                    for (const char* token = p; nextToken(token, end); skipToken(token, end)) {
+                        count++;
+                    }
+                    if (count > 0) {
+                        onFace(p, count);
+                    }
+                }
+                break;
+            case 'o':
+            case 'g':
+                if (startsWith(p, end, "o") || startsWith(p, end, "g")) {
+                    onChange(GroupChange{ false, restOfLine(p, end) });
+                }
+                break;
+            case 'u':
+                if (startsWith(p, end, "usemtl")) {
+                    onChange(GroupChange{ true, restOfLine(p, end) });
+                }
+                break;
+        }
+    }
+}
+
+}
+
+size_t ObjMesh::getMemoryUsage() const {
+    return vertices.capacity() * sizeof(float)
+        + faces.vertices.capacity() * sizeof(int)
+        + faces.starts.capacity() * sizeof(size_t)
+        + faces.groups.capacity() * sizeof(int);
+}
+
+ObjMesh readObj(const char* data, size_t size) {
+    const char* end = data + size;
+
+    // split the file into chunks that each end just after a newline
+    std::vector<Chunk> chunks;
+    for (const char* begin = data; begin < end;) {
+        const char* chunkEnd = begin + std::min(CHUNK_SIZE, (size_t) (end - begin));
+        while (chunkEnd < end && chunkEnd[-1] != '\n') {
+            chunkEnd++;
+        }
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end = chunkEnd;
+        chunks.push_back(std::move(chunk));
+        begin = chunkEnd;
+    }
+
+    // first pass: count everything in each chunk
+    parallelFor((int) chunks.size(), [&](int i) {
+        Chunk& chunk = chunks[i];
+        forEachLine(chunk,
+            [&](const char*) { chunk.numVertices++; },
+            [&](const char*, int count) {
+                chunk.numFaces++;
+                chunk.numFaceVertices += count;
+            },
+            [&](GroupChange change) { chunk.changes.push_back(change); });
+    });
+
+    // work out where each chunk goes, and give each distinct pair of
+    // object or group name and material name its own group, in order
+    ObjMesh mesh;
+    std::string_view object, material;
+    std::map<std::pair<std::string_view, std::string_view>, int> groupIds;
+    int group = groupIds.emplace(std::make_pair(object, material), 0).first->second;
+    size_t numVertices = 0, numFaces = 0, numFaceVertices = 0;
+
+    for (auto& chunk : chunks) {
+        chunk.vertexOffset = numVertices;
+        chunk.faceOffset = numFaces;
+        chunk.faceVertexOffset = numFaceVertices;
+        numVertices += chunk.numVertices;
+        numFaces += chunk.numFaces;
+        numFaceVertices += chunk.numFaceVertices;
+
+        chunk.startGroup = group;
+        for (auto& change : chunk.changes) {
+            (change.material ? material : object) = change.name;
+            group = groupIds.emplace(std::make_pair(object, material), groupIds.size()).first->second;
+            chunk.changeGroups.push_back(group);
+        }
+    }
+
+    mesh.vertices.resize(3 * numVertices);
+    mesh.faces.vertices.resize(numFaceVertices);
+    mesh.faces.starts.resize(numFaces + 1);
+    mesh.faces.groups.resize(numFaces);
+
+    // second pass: parse each chunk into its place in the mesh
+    parallelFor((int) chunks.size(), [&](int i) {
+        Chunk& chunk = chunks[i];
+        size_t vertex = chunk.vertexOffset;
+        size_t face = chunk.faceOffset;
+        size_t faceVertex = chunk.faceVertexOffset;
+        int chunkGroup = chunk.startGroup;
+        size_t change = 0;
+        const char* chunkEnd = chunk.end;
+
+        forEachLine(chunk,
+            [&](const char* p) {
+                // any missing coordinates are 0, and any after z are colours, which are skipped
+                for (int axis = 0; axis < 3 && nextToken(p, chunkEnd); axis++) {
+                    mesh.vertices[3 * vertex + axis] = parseFloat(p, chunkEnd);
+                    skipToken(p, chunkEnd);
+                }
+                vertex++;
+            },
+            [&](const char* p, int count) {
+                for (int j = 0; j < count; j++) {
+                    nextToken(p, chunkEnd);
+                    // indices start at 1, and negative indices count back from the latest vertex
+                    int64_t index;
+                    if (!parseInt(p, chunkEnd, index) || index == 0) {
+                        index = -1;
+                    } else if (index > 0) {
+                        index--;
+                    } else {
+                        index += vertex;
+                    }
+                    mesh.faces.vertices[faceVertex++] = index >= 0 && index < (int64_t) numVertices ? (int) index : -1;
+                    skipToken(p, chunkEnd);
+                }
+                mesh.faces.starts[face + 1] = faceVertex;
+                mesh.faces.groups[face] = chunkGroup;
+                face++;
+            },
+            [&](GroupChange) { chunkGroup = chunk.changeGroups[change++]; });
+    });
+
+    return mesh;
+}
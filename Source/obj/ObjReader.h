@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// the faces of a mesh, where face f joins the vertices from
+// vertices[starts[f]] to vertices[starts[f + 1] - 1] in a loop
+struct MeshFaces {
+    std::vector<int> vertices;
+    std::vector<size_t> starts = { 0 };
+    // faces in different objects, groups or materials have different ids
+    std::vector<int> groups;
+
+    int size() const {
+        return groups.size();
+    }
+};
+
+// the parts of an OBJ file that are needed to find its edges
+struct ObjMesh {
+    // the x, y and z coordinates of each vertex
+    std::vector<float> vertices;
+    MeshFaces faces;
+
+    size_t getMemoryUsage() const;
+};
+
+// Reads the vertex positions and faces of an OBJ file straight from memory,
+// e.g. a juce::MemoryBlock or a memory mapped file, without copying the text.
+// Normals, texture coordinates and everything else are skipped, apart from
+// object, group and material names, which give each face its group.
+//
+// The file is split into chunks of whole lines that are parsed in parallel.
+// The first pass counts the vertices and faces in each chunk, so the second
+// pass can write each chunk straight into its place in the final arrays.
+//
+// Face indices that don't refer to a vertex are set to -1.
+ObjMesh readObj(const char* data, size_t size);
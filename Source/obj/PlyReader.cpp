@@ -0,0 +1,333 @@
+#include "PlyReader.h"
+#include "../concurrency/ParallelFor.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+// rows are read in blocks of this many, each by one job
+static const size_t ROWS_PER_JOB = 16384;
+
+namespace {
+
+enum class Type { Invalid, Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+Type parseType(const std::string& name) {
+    if (name == "char" || name == "int8") return Type::Int8;
+    if (name == "uchar" || name == "uint8") return Type::UInt8;
+    if (name == "short" || name == "int16") return Type::Int16;
+    if (name == "ushort" || name == "uint16") return Type::UInt16;
+    if (name == "int" || name == "int32") return Type::Int32;
+    if (name == "uint" || name == "uint32") return Type::UInt32;
+    if (name == "float" || name == "float32") return Type::Float32;
+    if (name == "double" || name == "float64") return Type::Float64;
+    return Type::Invalid;
+}
+
+size_t sizeOf(Type type) {
+    switch (type) {
+        case Type::Int8: case Type::UInt8: return 1;
+        case Type::Int16: case Type::UInt16: return 2;
+        case Type::Int32: case Type::UInt32: case Type::Float32: return 4;
+        case Type::Float64: return 8;
+        default: return 0;
+    }
+}
+
+template <typename T>
+T load(const char* p, bool swap) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if (swap) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+double readValue(const char* p, Type type, bool swap) {
+    switch (type) {
+        case Type::Int8: return load<int8_t>(p, swap);
+        case Type::UInt8: return load<uint8_t>(p, swap);
+        case Type::Int16: return load<int16_t>(p, swap);
+        case Type::UInt16: return load<uint16_t>(p, swap);
+        case Type::Int32: return load<int32_t>(p, swap);
+        case Type::UInt32: return load<uint32_t>(p, swap);
+        case Type::Float32: return load<float>(p, swap);
+        case Type::Float64: return load<double>(p, swap);
+        default: return 0;
+    }
+}
+
+struct Property {
+    std::string name;
+    Type type = Type::Invalid;
+    // lists are a count followed by that many values of type
+    bool list = false;
+    Type countType = Type::Invalid;
+};
+
+struct Element {
+    std::string name;
+    size_t count = 0;
+    std::vector<Property> properties;
+
+    int find(std::string_view property) const {
+        for (int i = 0; i < properties.size(); i++) {
+            if (properties[i].name == property) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // the size of every row, or 0 if rows contain lists and vary in size
+    size_t fixedRowSize() const {
+        size_t size = 0;
+        for (auto& property : properties) {
+            if (property.list) {
+                return 0;
+            }
+            size += sizeOf(property.type);
+        }
+        return size;
+    }
+};
+
+// Calls onProperty(index, p, count) for each property in the row starting
+// at p, where count is 1 for scalars, and p points to the first value.
+// Returns the start of the next row, or nullptr if the row runs past end.
+template <typename PropertyFn>
+const char* walkRow(const Element& element, const char* p, const char* end, bool swap, PropertyFn onProperty) {
+    for (int i = 0; i < element.properties.size(); i++) {
+        auto& property = element.properties[i];
+        size_t count = 1;
+        if (property.list) {
+            size_t countSize = sizeOf(property.countType);
+            if (end - p < (ptrdiff_t) countSize) {
+                return nullptr;
+            }
+            double value = readValue(p, property.countType, swap);
+            count = value > 0 ? (size_t) value : 0;
+            p += countSize;
+        }
+        size_t size = count * sizeOf(property.type);
+        if ((size_t) (end - p) < size) {
+            return nullptr;
+        }
+        onProperty(i, p, count);
+        p += size;
+    }
+    return p;
+}
+
+// Finds the start of every block of ROWS_PER_JOB rows of the element, so
+// that blocks can be read in parallel, followed by the end of the element.
+// Rows are only walked one by one when their size varies. Returns false if
+// the element runs past end.
+bool findBlocks(const Element& element, const char* begin, const char* end, bool swap, std::vector<const char*>& blocks) {
+    blocks.clear();
+    size_t rowSize = element.fixedRowSize();
+    if (rowSize > 0 || element.properties.empty()) {
+        if (element.count > 0 && (size_t) (end - begin) / std::max<size_t>(rowSize, 1) < element.count) {
+            return false;
+        }
+        for (size_t row = 0; row < element.count; row += ROWS_PER_JOB) {
+            blocks.push_back(begin + row * rowSize);
+        }
+        blocks.push_back(begin + element.count * rowSize);
+        return true;
+    }
+
+    const char* p = begin;
+    for (size_t row = 0; row < element.count; row++) {
+        if (row % ROWS_PER_JOB == 0) {
+            blocks.push_back(p);
+        }
+        p = walkRow(element, p, end, swap, [](int, const char*, size_t) {});
+        if (p == nullptr) {
+            return false;
+        }
+    }
+    blocks.push_back(p);
+    return true;
+}
+
+bool readVertices(const Element& element, const std::vector<const char*>& blocks, bool swap, ObjMesh& mesh) {
+    int axes[3] = { element.find("x"), element.find("y"), element.find("z") };
+    for (int axis : axes) {
+        if (axis == -1 || element.properties[axis].list) {
+            return false;
+        }
+    }
+
+    mesh.vertices.resize(3 * element.count);
+
+    // packed floats in our byte order can be copied straight from the file
+    bool packed = !swap && element.properties.size() == 3 && axes[0] == 0 && axes[1] == 1 && axes[2] == 2;
+    for (int axis : axes) {
+        packed = packed && element.properties[axis].type == Type::Float32;
+    }
+    if (packed) {
+        std::memcpy(mesh.vertices.data(), blocks.front(), mesh.vertices.size() * sizeof(float));
+        return true;
+    }
+
+    parallelFor((int) blocks.size() - 1, [&](int block) {
+        const char* p = blocks[block];
+        size_t last = std::min(element.count, (block + 1) * ROWS_PER_JOB);
+        for (size_t vertex = block * ROWS_PER_JOB; vertex < last; vertex++) {
+            p = walkRow(element, p, blocks.back(), swap, [&](int property, const char* value, size_t) {
+                for (int axis = 0; axis < 3; axis++) {
+                    if (property == axes[axis]) {
+                        mesh.vertices[3 * vertex + axis] = readValue(value, element.properties[property].type, swap);
+                    }
+                }
+            });
+        }
+    });
+    return true;
+}
+
+bool readFaces(const Element& element, const std::vector<const char*>& blocks, bool swap, ObjMesh& mesh) {
+    int indices = element.find("vertex_indices");
+    if (indices == -1) {
+        indices = element.find("vertex_index");
+    }
+    if (indices == -1 || !element.properties[indices].list) {
+        return false;
+    }
+    Type type = element.properties[indices].type;
+    size_t typeSize = sizeOf(type);
+    int numBlocks = blocks.size() - 1;
+
+    // count the indices in each block, so each block knows where its faces go
+    std::vector<size_t> blockStarts(numBlocks + 1, 0);
+    parallelFor(numBlocks, [&](int block) {
+        const char* p = blocks[block];
+        size_t last = std::min(element.count, (block + 1) * ROWS_PER_JOB);
+        for (size_t face = block * ROWS_PER_JOB; face < last; face++) {
+            p = walkRow(element, p, blocks.back(), swap, [&](int property, const char*, size_t count) {
+                if (property == indices) {
+                    blockStarts[block + 1] += count;
+                }
+            });
+        }
+    });
+    for (int block = 0; block < numBlocks; block++) {
+        blockStarts[block + 1] += blockStarts[block];
+    }
+
+    size_t numVertices = mesh.vertices.size() / 3;
+    mesh.faces.vertices.resize(blockStarts.back());
+    mesh.faces.starts.resize(element.count + 1);
+    mesh.faces.groups.assign(element.count, 0);
+
+    parallelFor(numBlocks, [&](int block) {
+        const char* p = blocks[block];
+        size_t faceVertex = blockStarts[block];
+        size_t last = std::min(element.count, (block + 1) * ROWS_PER_JOB);
+        for (size_t face = block * ROWS_PER_JOB; face < last; face++) {
+            p = walkRow(element, p, blocks.back(), swap, [&](int property, const char* values, size_t count) {
+                if (property != indices) {
+                    return;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    double index = readValue(values + i * typeSize, type, swap);
+                    mesh.faces.vertices[faceVertex++] = index >= 0 && index < numVertices ? (int) index : -1;
+                }
+            });
+            mesh.faces.starts[face + 1] = faceVertex;
+        }
+    });
+    return true;
+}
+
+}
+
+ObjMesh readPly(const char* data, size_t size) {
+    const char* end = data + size;
+
+    std::string_view start(data, std::min<size_t>(size, 1 << 20));
+    size_t headerEnd = start.find("end_header");
+    if (start.substr(0, 3) != "ply" || headerEnd == std::string_view::npos) {
+        return ObjMesh();
+    }
+    const char* body = data + headerEnd;
+    while (body < end && *body != '\n') {
+        body++;
+    }
+    if (body < end) {
+        body++;
+    }
+
+    bool bigEndian = false;
+    bool binary = false;
+    std::vector<Element> elements;
+    std::istringstream header(std::string(data, headerEnd));
+    std::string line;
+    while (std::getline(header, line)) {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            words >> format;
+            binary = format == "binary_little_endian" || format == "binary_big_endian";
+            bigEndian = format == "binary_big_endian";
+        } else if (keyword == "element") {
+            Element element;
+            words >> element.name >> element.count;
+            elements.push_back(element);
+        } else if (keyword == "property" && !elements.empty()) {
+            Property property;
+            std::string type;
+            words >> type;
+            if (type == "list") {
+                std::string countType;
+                words >> countType >> type;
+                property.list = true;
+                property.countType = parseType(countType);
+                if (property.countType == Type::Invalid || property.countType == Type::Float32 || property.countType == Type::Float64) {
+                    return ObjMesh();
+                }
+            }
+            property.type = parseType(type);
+            words >> property.name;
+            if (property.type == Type::Invalid) {
+                return ObjMesh();
+            }
+            elements.back().properties.push_back(property);
+        }
+    }
+    if (!binary) {
+        return ObjMesh();
+    }
+
+    bool swap = bigEndian != (std::endian::native == std::endian::big);
+    ObjMesh mesh;
+    const char* p = body;
+    std::vector<const char*> blocks;
+    for (auto& element : elements) {
+        if (!findBlocks(element, p, end, swap, blocks)) {
+            return ObjMesh();
+        }
+        // faces refer to vertices, so vertices must come first
+        if (element.name == "vertex" && mesh.vertices.empty()) {
+            if (!readVertices(element, blocks, swap, mesh)) {
+                return ObjMesh();
+            }
+        } else if (element.name == "face" && mesh.faces.size() == 0) {
+            if (!readFaces(element, blocks, swap, mesh)) {
+                return ObjMesh();
+            }
+        }
+        p = blocks.back();
+    }
+
+    return mesh;
+}
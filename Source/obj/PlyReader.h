@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ObjReader.h"
+
+// Reads the vertex positions and faces of a binary PLY file, in either byte
+// order, straight from memory. Vertex positions are copied directly from the
+// file when they are stored as packed floats in the machine's byte order, and
+// faces are read in parallel. ASCII PLY files aren't supported, and give an
+// empty mesh, as does a file that is truncated or has an invalid header.
+ObjMesh readPly(const char* data, size_t size);
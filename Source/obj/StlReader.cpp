@@ -0,0 +1,140 @@
+#include "StlReader.h"
+#include "../concurrency/ParallelFor.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+static const size_t HEADER_SIZE = 84;
+static const size_t TRIANGLE_SIZE = 50;
+static const size_t TRIANGLES_PER_JOB = 16384;
+// corners closer than this fraction of the model's size are welded together
+static const double WELD_TOLERANCE = 1e-6;
+// grid cells are this many times larger than the tolerance, so that most
+// corners are far enough inside their cell that no other cell is searched
+static const double CELL_SCALE = 64;
+
+// STL files are always little endian
+template <typename T>
+static T loadLittleEndian(const char* p) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if constexpr (std::endian::native == std::endian::big) {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+ObjMesh readStl(const char* data, size_t size) {
+    if (size < HEADER_SIZE) {
+        return ObjMesh();
+    }
+    size_t numTriangles = loadLittleEndian<uint32_t>(data + 80);
+    if ((size - HEADER_SIZE) / TRIANGLE_SIZE < numTriangles || numTriangles == 0) {
+        return ObjMesh();
+    }
+    size_t numCorners = 3 * numTriangles;
+    int numJobs = (numTriangles + TRIANGLES_PER_JOB - 1) / TRIANGLES_PER_JOB;
+
+    // each triangle is a normal, three corners and two unused bytes
+    std::vector<float> corners(3 * numCorners);
+    std::vector<float> jobMin(3 * numJobs, INFINITY), jobMax(3 * numJobs, -INFINITY);
+    parallelFor(numJobs, [&](int job) {
+        size_t last = std::min(numTriangles, (job + 1) * TRIANGLES_PER_JOB);
+        for (size_t triangle = job * TRIANGLES_PER_JOB; triangle < last; triangle++) {
+            const char* p = data + HEADER_SIZE + triangle * TRIANGLE_SIZE + 3 * sizeof(float);
+            for (int i = 0; i < 9; i++) {
+                float value = loadLittleEndian<float>(p + i * sizeof(float));
+                if (!std::isfinite(value)) {
+                    value = 0;
+                }
+                corners[9 * triangle + i] = value;
+                jobMin[3 * job + i % 3] = std::min(jobMin[3 * job + i % 3], value);
+                jobMax[3 * job + i % 3] = std::max(jobMax[3 * job + i % 3], value);
+            }
+        }
+    });
+
+    double min[3] = { INFINITY, INFINITY, INFINITY };
+    double extent = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        double max = -INFINITY;
+        for (int job = 0; job < numJobs; job++) {
+            min[axis] = std::min<double>(min[axis], jobMin[3 * job + axis]);
+            max = std::max<double>(max, jobMax[3 * job + axis]);
+        }
+        extent = std::max(extent, max - min[axis]);
+    }
+    double tolerance = extent > 0 ? WELD_TOLERANCE * extent : 1e-30;
+    double cellSize = CELL_SCALE * tolerance;
+
+    // the cell containing each corner, as its x, y and z cell coordinates
+    // packed 21 bits each into one key
+    auto cellKey = [](uint64_t x, uint64_t y, uint64_t z) {
+        return (x << 42) | (y << 21) | z;
+    };
+    auto cellCoordinate = [&](size_t corner, int axis) {
+        return (corners[3 * corner + axis] - min[axis]) / cellSize;
+    };
+
+    ObjMesh mesh;
+    mesh.faces.vertices.resize(numCorners);
+    mesh.faces.starts.resize(numTriangles + 1);
+    mesh.faces.groups.assign(numTriangles, 0);
+    for (size_t triangle = 0; triangle <= numTriangles; triangle++) {
+        mesh.faces.starts[triangle] = 3 * triangle;
+    }
+
+    // each cell has a list of its welded vertices, linked through nextInCell
+    std::unordered_map<uint64_t, int> cells;
+    cells.reserve(numCorners / 2);
+    std::vector<int> nextInCell;
+    double margin = tolerance / cellSize;
+
+    for (size_t corner = 0; corner < numCorners; corner++) {
+        // search the neighbouring cells on any side that the corner is close to
+        int64_t cell[3];
+        int from[3], to[3];
+        for (int axis = 0; axis < 3; axis++) {
+            double coordinate = cellCoordinate(corner, axis);
+            cell[axis] = (int64_t) coordinate;
+            double fraction = coordinate - cell[axis];
+            from[axis] = fraction < margin && cell[axis] > 0 ? -1 : 0;
+            to[axis] = fraction > 1 - margin ? 1 : 0;
+        }
+
+        int vertex = -1;
+        for (int dx = from[0]; dx <= to[0] && vertex == -1; dx++) {
+            for (int dy = from[1]; dy <= to[1] && vertex == -1; dy++) {
+                for (int dz = from[2]; dz <= to[2] && vertex == -1; dz++) {
+                    auto found = cells.find(cellKey(cell[0] + dx, cell[1] + dy, cell[2] + dz));
+                    for (int v = found == cells.end() ? -1 : found->second; v != -1; v = nextInCell[v]) {
+                        bool close = true;
+                        for (int axis = 0; axis < 3; axis++) {
+                            close = close && std::abs(mesh.vertices[3 * v + axis] - corners[3 * corner + axis]) <= tolerance;
+                        }
+                        if (close) {
+                            vertex = v;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (vertex == -1) {
+            vertex = nextInCell.size();
+            mesh.vertices.insert(mesh.vertices.end(), corners.begin() + 3 * corner, corners.begin() + 3 * corner + 3);
+            auto inserted = cells.emplace(cellKey(cell[0], cell[1], cell[2]), vertex);
+            nextInCell.push_back(inserted.second ? -1 : inserted.first->second);
+            inserted.first->second = vertex;
+        }
+        mesh.faces.vertices[corner] = vertex;
+    }
+
+    return mesh;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "ObjReader.h"
+
+// Reads the triangles of a binary STL file straight from memory. STL files
+// store each corner of each triangle separately, so corners that are at the
+// same position, to within a tiny fraction of the model's size, are welded
+// into one vertex using a hash grid. Otherwise no triangles would share an
+// edge. ASCII STL files aren't supported, and give an empty mesh.
+ObjMesh readStl(const char* data, size_t size);
@@ -1,14 +1,13 @@
 #include "WorldObject.h"
 #include "../chinese_postman/ChinesePostman.h"
-#include "tiny_obj_loader.h"
+#include "../chinese_postman/ApproximateChinesePostman.h"
+#include "ObjReader.h"
+#include "MeshDecimator.h"
 #include "../MathUtil.h"
-#include <unordered_set>
-
-struct pair_hash {
-    inline std::size_t operator()(const std::pair<int, int>& v) const {
-        return v.first * 31 + v.second;
-    }
-};
+#include "../concurrency/ParallelFor.h"
+#include "../concurrency/ParallelRadixSort.h"
+#include <atomic>
+#include <numbers>
 
 //
 // returns all vertex indices in all connected sub-components of the graph
@@ -17,7 +16,7 @@ struct pair_hash {
 std::vector<std::vector<int>> ConnectedComponents(Graph& G) {
     std::vector<std::vector<int>> components;
     std::vector<bool> visited(G.GetNumVertices(), false);
-    std::list<int> L;
+    std::vector<int> L;
 
     for (int i = 0; i < visited.size(); i++) {
         // if condition should only be true for the first element in
@@ -44,16 +43,146 @@ std::vector<std::vector<int>> ConnectedComponents(Graph& G) {
     return components;
 }
 
-WorldObject::WorldObject(const std::string& obj_string) {
-    tinyobj::ObjReaderConfig reader_config;
-    reader_config.triangulate = false;
-    reader_config.vertex_color = false;
-    tinyobj::ObjReader reader;
+// faces are split into blocks of this size so that there are enough jobs to share out
+static const int FACES_PER_JOB = 16384;
+
+//
+// each face with k vertices has k edges, so the edges of every face are
+// written to their own place in a flat array in parallel, with the edge
+// from vertices[i] at index i. Each edge is packed into a single key, with
+// the smaller vertex first, so that sorting the keys and removing duplicates
+// leaves every edge once, in order.
+//
+static std::vector<uint64_t> FaceEdgeKeys(const MeshFaces& faces, int numVertices, int vertex_bits) {
+    std::vector<uint64_t> keys(faces.vertices.size());
+
+    parallelFor((faces.size() + FACES_PER_JOB - 1) / FACES_PER_JOB, [&](int job) {
+        int end = std::min((job + 1) * FACES_PER_JOB, faces.size());
+        for (int face = job * FACES_PER_JOB; face < end; face++) {
+            size_t first = faces.starts[face];
+            size_t last = faces.starts[face + 1];
+            // each vertex is joined to the next, and the last vertex to the first
+            for (size_t i = first; i < last; i++) {
+                uint64_t u = (uint32_t) faces.vertices[i];
+                uint64_t v = (uint32_t) faces.vertices[i + 1 == last ? first : i + 1];
+                if (u >= (uint64_t) numVertices || v >= (uint64_t) numVertices) {
+                    // a self loop at vertex 0, which is ignored
+                    u = v = 0;
+                }
+                keys[i] = (std::min(u, v) << vertex_bits) | std::max(u, v);
+            }
+        }
+    });
+
+    return keys;
+}
+
+//
+// keeps only the edges that outline the shape of the mesh: edges on the
+// boundary of the mesh, edges where the faces either side meet at more than
+// crease_angle degrees, and edges between faces in different groups. Edges
+// shared by more than two faces are kept too, as they aren't smooth.
+//
+// edge_keys must be the sorted, unique keys of face_edge_keys.
+//
+static std::vector<uint64_t> FeatureEdges(const MeshFaces& faces, const std::vector<float>& vs, const std::vector<uint64_t>& face_edge_keys, const std::vector<uint64_t>& edge_keys, double crease_angle) {
+    int num_jobs = (faces.size() + FACES_PER_JOB - 1) / FACES_PER_JOB;
+
+    // the unit normal of each face, using Newell's method so that
+    // polygons that aren't quite flat still get a sensible normal
+    std::vector<float> normals(3 * faces.size(), 0);
+    parallelFor(num_jobs, [&](int job) {
+        int end = std::min((job + 1) * FACES_PER_JOB, faces.size());
+        for (int face = job * FACES_PER_JOB; face < end; face++) {
+            size_t first = faces.starts[face];
+            size_t last = faces.starts[face + 1];
+            double nx = 0, ny = 0, nz = 0;
+            for (size_t i = first; i < last; i++) {
+                int a = faces.vertices[i];
+                int b = faces.vertices[i + 1 == last ? first : i + 1];
+                if (a < 0 || b < 0 || 3 * a >= vs.size() || 3 * b >= vs.size()) {
+                    continue;
+                }
+                nx += (vs[3 * a + 1] - vs[3 * b + 1]) * (vs[3 * a + 2] + vs[3 * b + 2]);
+                ny += (vs[3 * a + 2] - vs[3 * b + 2]) * (vs[3 * a] + vs[3 * b]);
+                nz += (vs[3 * a] - vs[3 * b]) * (vs[3 * a + 1] + vs[3 * b + 1]);
+            }
+            double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+            if (length > 0) {
+                normals[3 * face] = nx / length;
+                normals[3 * face + 1] = ny / length;
+                normals[3 * face + 2] = nz / length;
+            }
+        }
+    });
+
+    // the number of faces using each edge, and the first and last of them,
+    // which are the only two when the edge is shared by exactly two faces
+    std::vector<std::atomic<int>> edge_face_count(edge_keys.size());
+    std::vector<std::atomic<int>> edge_first_face(edge_keys.size());
+    std::vector<std::atomic<int>> edge_last_face(edge_keys.size());
+    for (int e = 0; e < edge_keys.size(); e++) {
+        edge_face_count[e] = 0;
+        edge_first_face[e] = faces.size();
+        edge_last_face[e] = -1;
+    }
+
+    parallelFor(num_jobs, [&](int job) {
+        int end = std::min((job + 1) * FACES_PER_JOB, faces.size());
+        for (int face = job * FACES_PER_JOB; face < end; face++) {
+            for (size_t i = faces.starts[face]; i < faces.starts[face + 1]; i++) {
+                int e = std::lower_bound(edge_keys.begin(), edge_keys.end(), face_edge_keys[i]) - edge_keys.begin();
+                edge_face_count[e]++;
+
+                int first = edge_first_face[e];
+                while (face < first && !edge_first_face[e].compare_exchange_weak(first, face)) {}
+                int last = edge_last_face[e];
+                while (face > last && !edge_last_face[e].compare_exchange_weak(last, face)) {}
+            }
+        }
+    });
+
+    double min_cos = std::cos(crease_angle * std::numbers::pi / 180.0);
+    // chars rather than bools so that jobs never write to the same byte
+    std::vector<char> is_feature(edge_keys.size());
+    int num_edges = edge_keys.size();
+    parallelFor((num_edges + FACES_PER_JOB - 1) / FACES_PER_JOB, [&](int job) {
+        int end = std::min((job + 1) * FACES_PER_JOB, num_edges);
+        for (int e = job * FACES_PER_JOB; e < end; e++) {
+            int count = edge_face_count[e];
+            int a = edge_first_face[e];
+            int b = edge_last_face[e];
+            if (count != 2) {
+                is_feature[e] = true;
+            } else if (faces.groups[a] != faces.groups[b]) {
+                is_feature[e] = true;
+            } else {
+                double cos = normals[3 * a] * normals[3 * b] + normals[3 * a + 1] * normals[3 * b + 1] + normals[3 * a + 2] * normals[3 * b + 2];
+                is_feature[e] = cos < min_cos;
+            }
+        }
+    });
+
+    std::vector<uint64_t> features;
+    for (int e = 0; e < edge_keys.size(); e++) {
+        if (is_feature[e]) {
+            features.push_back(edge_keys[e]);
+        }
+    }
+    return features;
+}
+
+WorldObject::WorldObject(const char* obj_data, size_t size, ObjSettings settings, ParseProgress* progress) : WorldObject(readObj(obj_data, size), settings, progress) {}
 
-    reader.ParseFromString(obj_string, "", reader_config);
+WorldObject::WorldObject(ObjMesh mesh, ObjSettings settings, ParseProgress* progress) {
+    auto cancelled = [progress]() {
+        return progress != nullptr && progress->isCancelled();
+    };
 
-    vs = reader.GetAttrib().vertices;
-	numVertices = vs.size() / 3;
+    loadMemory = mesh.getMemoryUsage();
+
+    std::vector<float>& vs = mesh.vertices;
+	int numVertices = vs.size() / 3;
 
     //
     // normalising object vertices
@@ -91,113 +220,146 @@ WorldObject::WorldObject(const std::string& obj_string) {
         vs[i] /= max;
     }
 
+    if (settings.simplify) {
+        decimateMesh(mesh, settings.targetEdges, progress);
+    }
+    if (cancelled()) {
+        return;
+    }
+
+    MeshFaces& faces = mesh.faces;
+
     //
-    // getting edges from obj file
-    // 
-    std::vector<tinyobj::shape_t> shapes = reader.GetShapes();
-    std::unordered_set<std::pair<int, int>, pair_hash> edge_set;
-
-	for (auto& shape : shapes) {
-        int i = 0;
-        int face = 0;
-        while (i < shape.mesh.indices.size()) {
-            int prevVertex = -1;
-            int num_face_vertices = shape.mesh.num_face_vertices[face];
-            int firstVertex;
-            int lastVertex;
-            // num_face_vertices stores the number of vertices per face, used to
-            // iterate through mesh.indices and know when a face starts/ends
-            for (int j = 0; j < num_face_vertices; j++) {
-                int vertex = shape.mesh.indices[i].vertex_index;
-                if (j == 0) {
-                    firstVertex = vertex;
-                }
-                if (j == num_face_vertices - 1) {
-                    lastVertex = vertex;
-                }
-				if (prevVertex != -1) {
-					int first = std::min(prevVertex, vertex);
-					int last = std::max(prevVertex, vertex);
-					edge_set.insert(std::make_pair(first, last));
-				}
-				prevVertex = vertex;
-				i++;
-			}
-            int first = std::min(firstVertex, lastVertex);
-            int last = std::max(firstVertex, lastVertex);
-            edge_set.insert(std::make_pair(first, last));
-            face++;
-        }
-	}
+    // getting edges from faces
+    //
+    int vertex_bits = 1;
+    while (vertex_bits < 31 && (1 << vertex_bits) < numVertices) {
+        vertex_bits++;
+    }
+
+    std::vector<uint64_t> edge_keys = FaceEdgeKeys(faces, numVertices, vertex_bits);
+    std::vector<uint64_t> face_edge_keys;
+    if (settings.featureEdges) {
+        face_edge_keys = edge_keys;
+    }
 
-    std::list<std::pair<int, int>> edge_list;
+    // the radix sort needs a buffer as large as the keys
+    loadMemory += (face_edge_keys.capacity() + 2 * edge_keys.capacity()) * sizeof(uint64_t);
+    parallelRadixSort(edge_keys, 2 * vertex_bits);
+    edge_keys.erase(std::unique(edge_keys.begin(), edge_keys.end()), edge_keys.end());
 
-    for (auto& edge : edge_set) {
-        edge_list.push_back(edge);
+    if (settings.featureEdges) {
+        edge_keys = FeatureEdges(faces, vs, face_edge_keys, edge_keys, settings.creaseAngle);
+    }
+
+    // only the vertex positions are needed from here on
+    faces = MeshFaces();
+    face_edge_keys = std::vector<uint64_t>();
+
+    std::vector<std::pair<int, int>> edge_list;
+    edge_list.reserve(edge_keys.size());
+    uint64_t vertex_mask = (1ull << vertex_bits) - 1;
+    for (uint64_t key : edge_keys) {
+        edge_list.push_back(std::make_pair((int) (key >> vertex_bits), (int) (key & vertex_mask)));
     }
 
     Graph graph(numVertices, edge_list);
     std::vector<std::vector<int>> connected_components = ConnectedComponents(graph);
+    if (cancelled()) {
+        return;
+    }
 
-    // perform chinese postman on all connected sub-components of graph
-    // TODO: move this to separate graph-related file
-    for (auto& connected_component : connected_components) {
-        // TODO: make this parallel: https://stackoverflow.com/questions/36246300/parallel-loops-in-c
-		// TODO: check the number of edges in the subgraph to make sure it's not too large compared to java version
+    // finding the path takes most of the time, so progress is mostly
+    // measured by how many edges are in components that have been solved
+    const double EDGES_PROGRESS = 0.1;
+    size_t numEdges = edge_list.size();
+    std::atomic<size_t> solvedEdges = 0;
+    if (progress != nullptr) {
+        progress->setProgress(EDGES_PROGRESS);
+    }
 
-        //
-        // get a mapping to graph vertices that doesn't skip over
-		// any numbers, allowing the Graph class to be used
-        // 
-		// we also need a mapping back to the obj vertices so that
-        // we can construct the path at the end
-        //
-        std::vector<bool> present_vertices(graph.GetNumVertices(), false);
-
-        for (int vertex : connected_component) {
-            present_vertices[vertex] = true;
+    //
+    // get a mapping to graph vertices in each component that doesn't skip
+    // over any numbers, allowing the Graph class to be used. Each component's
+    // vertices are sorted, so they map back from graph to obj vertices, and
+    // as the components don't overlap, one array maps obj to graph vertices.
+    //
+    std::vector<int> obj_to_graph_vertex(numVertices, -1);
+    parallelFor((int) connected_components.size(), [&](int component_index) {
+        auto& connected_component = connected_components[component_index];
+        std::sort(connected_component.begin(), connected_component.end());
+        for (int i = 0; i < connected_component.size(); i++) {
+            obj_to_graph_vertex[connected_component[i]] = i;
         }
+    });
 
-        std::unordered_map<int, int> obj_to_graph_vertex;
-        std::unordered_map<int, int> graph_to_obj_vertex;
-
-        int count = 0;
-        for (int i = 0; i < graph.GetNumVertices(); i++) {
-            if (present_vertices[i]) {
-                obj_to_graph_vertex[i] = i - count;
-                graph_to_obj_vertex[i - count] = i;
-            } else {
-                count++;
-            }
+    // perform chinese postman on all connected sub-components of graph.
+    // Components are independent, so they are solved in parallel, each into
+    // its own list of edges, which are joined in order at the end.
+    // TODO: move this to separate graph-related file
+    std::vector<std::vector<Line>> component_edges(connected_components.size());
+    std::vector<double> component_lengths(connected_components.size(), 0);
+    std::vector<double> component_lower_bounds(connected_components.size(), 0);
+    // the time budget is shared by all components, as they are solved at the same time
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(settings.timeBudget));
+
+    parallelFor((int) connected_components.size(), [&](int component_index) {
+        auto& graph_to_obj_vertex = connected_components[component_index];
+        // vertices with no edges, e.g. those inside smooth surfaces when
+        // only feature edges are drawn, have nothing to trace
+        if (graph_to_obj_vertex.size() < 2 || cancelled()) {
+            return;
         }
+		// TODO: check the number of edges in the subgraph to make sure it's not too large compared to java version
 
         // generate all edges in sub-component using the vertex
-        // maps and parent Graph's adjacency list
-        std::list<std::pair<int, int>> sub_edge_list;
+        // maps and parent Graph's adjacency list. These come out
+        // already sorted, as the vertices and their neighbours are.
+        std::vector<std::pair<int, int>> sub_edge_list;
 
-        for (int obj_start : connected_component) {
+        for (int obj_start : graph_to_obj_vertex) {
             for (int obj_end : graph.AdjList(obj_start)) {
+                if (obj_end < obj_start) {
+                    continue;
+                }
                 int graph_start = obj_to_graph_vertex[obj_start];
                 int graph_end = obj_to_graph_vertex[obj_end];
                 sub_edge_list.push_back(std::make_pair(graph_start, graph_end));
             }
         }
 
-        Graph subgraph(connected_component.size(), sub_edge_list);
+        Graph subgraph(graph_to_obj_vertex.size(), sub_edge_list);
 
         std::vector<double> cost(subgraph.GetNumEdges());
-		for (auto& edge : sub_edge_list) {
+		for (int e = 0; e < subgraph.GetNumEdges(); e++) {
+            auto edge = subgraph.GetEdge(e);
             int obj_start = graph_to_obj_vertex[edge.first];
             int obj_end = graph_to_obj_vertex[edge.second];
 			double deltax = vs[3 * obj_start] - vs[3 * obj_end];
 			double deltay = vs[3 * obj_start + 1] - vs[3 * obj_end + 1];
 			double deltaz = vs[3 * obj_start + 2] - vs[3 * obj_end + 2];
 			double c = std::sqrt(deltax * deltax + deltay * deltay + deltaz * deltaz);
-            cost[subgraph.GetEdgeIndex(edge.first, edge.second)] = c;
+            cost[e] = c;
 		}
 
-        pair<list<int>, double> solution = ChinesePostman(subgraph, cost);
-        list<int>& path = solution.first;
+        bool approximate = settings.solver == ObjSettings::Solver::Approximate;
+        if (settings.solver == ObjSettings::Solver::Automatic) {
+            int odd_vertices = 0;
+            for (int vertex = 0; vertex < subgraph.GetNumVertices(); vertex++) {
+                odd_vertices += subgraph.AdjList(vertex).size() % 2;
+            }
+            approximate = odd_vertices > MAX_EXACT_ODD_VERTICES;
+        }
+
+        pair<vector<int>, double> solution;
+        if (approximate) {
+            solution = ApproximateChinesePostman(subgraph, cost, deadline, component_lower_bounds[component_index], progress);
+        } else {
+            solution = ChinesePostman(subgraph, cost);
+            component_lower_bounds[component_index] = solution.second;
+        }
+        component_lengths[component_index] = solution.second;
+        vector<int>& path = solution.first;
 
         // traverse CP solution, converting back to obj vertices
         int prevVertex = -1;
@@ -211,13 +373,31 @@ WorldObject::WorldObject(const std::string& obj_string) {
                 double y2 = vs[vertex * 3 + 1];
                 double z2 = vs[vertex * 3 + 2];
 
-                edges.push_back(Line(x1, y1, z1, x2, y2, z2));
+                component_edges[component_index].push_back(Line(x1, y1, z1, x2, y2, z2));
             }
             prevVertex = vertex;
         }
+
+        if (progress != nullptr) {
+            size_t solved = solvedEdges += subgraph.GetNumEdges();
+            progress->setProgress(EDGES_PROGRESS + (1 - EDGES_PROGRESS) * solved / numEdges);
+        }
+    });
+
+    // the path is incomplete, so none of it is kept
+    if (cancelled()) {
+        return;
+    }
+
+    for (int i = 0; i < component_edges.size(); i++) {
+        edges.insert(edges.end(), component_edges[i].begin(), component_edges[i].end());
+        pathLength += component_lengths[i];
+        pathLowerBound += component_lower_bounds[i];
     }
 }
 
+WorldObject::WorldObject(std::vector<Line> edges, double pathLength, double pathLowerBound) : edges(std::move(edges)), pathLength(pathLength), pathLowerBound(pathLowerBound) {}
+
 std::vector<std::unique_ptr<Shape>> WorldObject::draw() {
     std::vector<std::unique_ptr<Shape>> shapes;
 
@@ -1,14 +1,57 @@
 #pragma once
 
 #include "../shape/Line.h"
+#include "ObjReader.h"
+#include "../parser/ParseProgress.h"
+
+// controls how the path through an OBJ file's edges is found
+struct ObjSettings {
+	enum class Solver {
+		// exact for small models, and approximate for models that would take too long
+		Automatic,
+		Exact,
+		Approximate,
+	};
+
+	Solver solver = Solver::Automatic;
+	// the number of seconds the approximate solver can spend on the path
+	double timeBudget = 2.0;
+	// only draw the edges that outline the model: boundaries, creases sharper
+	// than creaseAngle degrees, and edges between different objects or materials
+	bool featureEdges = false;
+	double creaseAngle = 30.0;
+	// simplify the model until it has about targetEdges edges, so that the
+	// path is quicker to find and can be drawn with fewer samples
+	bool simplify = false;
+	int targetEdges = 2000;
+};
 
 class WorldObject {
 public:
-	WorldObject(const std::string&);
+	// parses the OBJ file in place, so data can be e.g. a memory mapped file.
+	// If progress is given, it is updated as the path is found, and the object
+	// is left without any edges if it is cancelled part of the way through.
+	WorldObject(const char* data, size_t size, ObjSettings settings = ObjSettings(), ParseProgress* progress = nullptr);
+	// uses a mesh read from another format, e.g. PLY or STL
+	WorldObject(ObjMesh mesh, ObjSettings settings = ObjSettings(), ParseProgress* progress = nullptr);
+	// uses edges that have already been computed, e.g. from ParseCache
+	WorldObject(std::vector<Line> edges, double pathLength, double pathLowerBound);
+
+	// components with more odd degree vertices than this use the approximate
+	// solver when the solver is Automatic
+	static const int MAX_EXACT_ODD_VERTICES = 400;
+
+	// must be incremented whenever the edges produced for a file change
+	static const int PARSER_VERSION = 3;
 
     std::vector<std::unique_ptr<Shape>> draw();
     
     std::vector<Line> edges;
-    std::vector<float> vs;
-    int numVertices;
+    // the length of the path, and a lower bound on the length of the shortest
+    // path, which are equal when the path was solved exactly
+    double pathLength = 0;
+    double pathLowerBound = 0;
+    // roughly the largest number of bytes used at once while loading the
+    // file, not counting the file itself, or 0 if it was loaded from the cache
+    size_t loadMemory = 0;
 };
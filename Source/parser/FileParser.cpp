@@ -3,73 +3,220 @@
 #include "../shape/CircleArc.h"
 #include <numbers>
 #include "../PluginProcessor.h"
+#include "../obj/PlyReader.h"
+#include "../obj/StlReader.h"
 
 FileParser::FileParser(OscirenderAudioProcessor &p, std::function<void(int, juce::String, juce::String)> errorCallback) : errorCallback(errorCallback), audioProcessor(p) {}
 
-void FileParser::parse(juce::String fileId, juce::String extension, std::unique_ptr<juce::InputStream> stream, juce::Font font) {
-	juce::SpinLock::ScopedLockType scope(lock);
+FileParser::~FileParser() {
+	cancelParse();
+	LuaParser::close(luaFrameState);
+}
 
-	if (extension == ".lua" && lua != nullptr && lua->isFunctionValid()) {
-		fallbackLuaScript = lua->getScript();
+void FileParser::parseAsync(juce::String fileId, juce::String extension, std::shared_ptr<juce::MemoryBlock> data, juce::Font font, ObjSettings objSettings) {
+	uint32_t generation = ++parseGeneration;
+	auto progress = std::make_shared<ParseProgress>();
+	{
+		juce::SpinLock::ScopedLockType scope(lock);
+		if (parseProgress != nullptr) {
+			parseProgress->cancel();
+		}
+		parseProgress = progress;
 	}
 
-	object = nullptr;
-	svg = nullptr;
-	text = nullptr;
-	gpla = nullptr;
-	lua = nullptr;
-	img = nullptr;
-	wav = nullptr;
-	
-	if (extension == ".obj") {
-		object = std::make_shared<WorldObject>(stream->readEntireStreamAsString().toStdString());
+	std::weak_ptr<FileParser> weakParser = weak_from_this();
+	auto& audioProcessor = this->audioProcessor;
+	auto errorCallback = this->errorCallback;
+
+	audioProcessor.fileParsingPool.addJob([weakParser, generation, progress, &audioProcessor, errorCallback, fileId, extension, data, font, objSettings]() {
+		juce::String fallbackLuaScript;
+		{
+			auto parser = weakParser.lock();
+			// cancelled, either by a newer parse or by the parser being deleted
+			if (parser == nullptr || parser->parseGeneration != generation || progress->isCancelled()) {
+				return juce::ThreadPoolJob::jobHasFinished;
+			}
+			juce::SpinLock::ScopedLockType scope(parser->lock);
+			fallbackLuaScript = parser->fallbackLuaScript;
+			if (extension == ".lua" && parser->lua != nullptr && parser->lua->isFunctionValid()) {
+				fallbackLuaScript = parser->lua->getScript();
+			}
+		}
+
+		ParsedFile parsed = parse(audioProcessor, errorCallback, fileId, extension, data, font, objSettings, fallbackLuaScript, progress.get());
+
+		if (auto parser = weakParser.lock()) {
+			if (parser->parseGeneration == generation && !progress->isCancelled()) {
+				parser->swapIn(parsed, fallbackLuaScript);
+				parser->parsedGeneration = generation;
+				audioProcessor.fileChangeBroadcaster.sendChangeMessage();
+			}
+		}
+
+		return juce::ThreadPoolJob::jobHasFinished;
+	});
+}
+
+void FileParser::cancelParse() {
+	juce::SpinLock::ScopedLockType scope(lock);
+	if (parseProgress != nullptr) {
+		parseProgress->cancel();
+	}
+}
+
+bool FileParser::isParsing() {
+	return parsedGeneration != parseGeneration;
+}
+
+double FileParser::getParseProgress() {
+	juce::SpinLock::ScopedLockType scope(lock);
+	return parseProgress != nullptr ? parseProgress->getProgress() : 0.0;
+}
+
+// runs on a background thread, without holding the lock
+FileParser::ParsedFile FileParser::parse(OscirenderAudioProcessor& audioProcessor, std::function<void(int, juce::String, juce::String)> errorCallback, juce::String fileId, juce::String extension, std::shared_ptr<juce::MemoryBlock> data, juce::Font font, ObjSettings objSettings, juce::String fallbackLuaScript, ParseProgress* progress) {
+	ParsedFile parsed;
+	parsed.data = data;
+	auto stream = std::make_unique<juce::MemoryInputStream>(*data, false);
+
+	if (extension == ".obj" || extension == ".ply" || extension == ".stl") {
+		juce::String type = extension.substring(1) + "-" + juce::String((int) objSettings.solver) + "-" + juce::String(objSettings.timeBudget);
+		if (objSettings.featureEdges) {
+			type += "-features-" + juce::String(objSettings.creaseAngle);
+		}
+		if (objSettings.simplify) {
+			type += "-simplify-" + juce::String(objSettings.targetEdges);
+		}
+		juce::String key = audioProcessor.parseCache.getKey(*data, type, WorldObject::PARSER_VERSION);
+		std::vector<std::vector<Line>> frames;
+		juce::var properties;
+		if (audioProcessor.parseCache.load(key, frames, &properties) && frames.size() == 1) {
+			parsed.object = std::make_shared<WorldObject>(std::move(frames[0]), properties["pathLength"], properties["pathLowerBound"]);
+		} else {
+			// parsed straight from the file's data, as models can be hundreds of megabytes
+			const char* bytes = (const char*) data->getData();
+			if (extension == ".ply") {
+				parsed.object = std::make_shared<WorldObject>(readPly(bytes, data->getSize()), objSettings, progress);
+			} else if (extension == ".stl") {
+				parsed.object = std::make_shared<WorldObject>(readStl(bytes, data->getSize()), objSettings, progress);
+			} else {
+				parsed.object = std::make_shared<WorldObject>(bytes, data->getSize(), objSettings, progress);
+			}
+			// a cancelled parse hasn't found the whole path
+			if (progress->isCancelled()) {
+				return parsed;
+			}
+			DBG("Loaded " + fileId + " using " + juce::File::descriptionOfSizeInBytes(parsed.object->loadMemory));
+			auto object = new juce::DynamicObject();
+			object->setProperty("pathLength", parsed.object->pathLength);
+			object->setProperty("pathLowerBound", parsed.object->pathLowerBound);
+			audioProcessor.parseCache.store(key, { parsed.object->edges }, juce::var(object));
+		}
 	} else if (extension == ".svg") {
-		svg = std::make_shared<SvgParser>(stream->readEntireStreamAsString());
+		parsed.svg = std::make_shared<SvgParser>(stream->readEntireStreamAsString());
+	} else if (extension == ".zip") {
+		parsed.svgSequence = std::make_shared<SvgSequenceParser>(audioProcessor, data);
+		parsed.svgSequence->startLoading();
 	} else if (extension == ".txt") {
-		text = std::make_shared<TextParser>(audioProcessor, stream->readEntireStreamAsString(), font);
+		parsed.text = std::make_shared<TextParser>(audioProcessor, stream->readEntireStreamAsString(), font);
 	} else if (extension == ".lua") {
-		lua = std::make_shared<LuaParser>(fileId, stream->readEntireStreamAsString(), errorCallback, fallbackLuaScript);
+		parsed.lua = std::make_shared<LuaParser>(fileId, stream->readEntireStreamAsString(), errorCallback, &audioProcessor.luaDiagnostics, fallbackLuaScript);
 	} else if (extension == ".gpla") {
-		juce::MemoryBlock buffer{};
-		int bytesRead = stream->readIntoMemoryBlock(buffer);
-		if (bytesRead < 8) return;
-		char* gplaData = (char*)buffer.getData();
-		const char tag[] = "GPLA    ";
-		bool isBinary = true;
-		for (int i = 0; i < 8; i++) {
-			isBinary = isBinary && tag[i] == gplaData[i];
-		}
-		if (isBinary) {
-			gpla = std::make_shared<LineArtParser>(gplaData, bytesRead);
-		}
-		else {
-			stream->setPosition(0);
-			gpla = std::make_shared<LineArtParser>(stream->readEntireStreamAsString());
-		}
-	} else if (extension == ".gif" || extension == ".png" || extension == ".jpg" || extension == ".jpeg") {
-		juce::MemoryBlock buffer{};
-		int bytesRead = stream->readIntoMemoryBlock(buffer);
-		img = std::make_shared<ImageParser>(audioProcessor, extension, buffer);
+		if (data->getSize() < 8) return parsed;
+		// frames are decoded from the data as they're needed
+		parsed.gpla = std::make_shared<LineArtParser>(data);
+	} else if (extension == ".gif" || extension == ".png" || extension == ".jpg" || extension == ".jpeg" || VideoStream::isVideoFile(extension)) {
+		parsed.img = std::make_shared<ImageParser>(audioProcessor, extension, data);
 	} else if (extension == ".wav" || extension == ".aiff") {
-		wav = std::make_shared<WavParser>(audioProcessor);
-		wav->parse(std::move(stream));
+		parsed.wav = std::make_shared<WavParser>(audioProcessor);
+		parsed.wav->parse(data);
 	}
 
-	isAnimatable = gpla != nullptr || (img != nullptr && extension == ".gif");
-	sampleSource = lua != nullptr || img != nullptr || wav != nullptr;
+	parsed.isAnimatable = parsed.gpla != nullptr || parsed.svgSequence != nullptr || (parsed.img != nullptr && (extension == ".gif" || VideoStream::isVideoFile(extension)));
+	parsed.sampleSource = (parsed.lua != nullptr && !parsed.lua->isFrameMode()) || parsed.img != nullptr || parsed.wav != nullptr;
+
+	return parsed;
 }
 
-std::vector<std::unique_ptr<Shape>> FileParser::nextFrame() {
+// the old parsers are swapped out under the lock, but destroyed after it is released
+void FileParser::swapIn(ParsedFile& parsed, juce::String fallbackLuaScript) {
 	juce::SpinLock::ScopedLockType scope(lock);
 
+	this->fallbackLuaScript = fallbackLuaScript;
+
+	std::swap(object, parsed.object);
+	std::swap(svg, parsed.svg);
+	std::swap(svgSequence, parsed.svgSequence);
+	std::swap(text, parsed.text);
+	std::swap(gpla, parsed.gpla);
+	std::swap(lua, parsed.lua);
+	std::swap(img, parsed.img);
+	std::swap(wav, parsed.wav);
+	std::swap(data, parsed.data);
+
+	// the old Lua parser can't be copied any more, so once nothing else holds
+	// it, it's destroyed on the parsing thread along with the rest of parsed
+	if (parsed.lua != nullptr) {
+		retiredLua.push_back(std::move(parsed.lua));
+	}
+	for (auto it = retiredLua.begin(); it != retiredLua.end();) {
+		if (it->use_count() == 1) {
+			parsed.releasedLua.push_back(std::move(*it));
+			it = retiredLua.erase(it);
+		} else {
+			it++;
+		}
+	}
+
+	isAnimatable = parsed.isAnimatable;
+	sampleSource = parsed.sampleSource;
+	imageSource = this->img != nullptr;
+}
+
+std::vector<std::unique_ptr<Shape>> FileParser::nextFrame() {
+	std::shared_ptr<WorldObject> object;
+	std::shared_ptr<SvgParser> svg;
+	std::shared_ptr<SvgSequenceParser> svgSequence;
+	std::shared_ptr<TextParser> text;
+	std::shared_ptr<LineArtParser> gpla;
+	std::shared_ptr<LuaParser> lua;
+	std::shared_ptr<ImageParser> img;
+
+	// the lock is only held while copying the parsers, so that a slow frame
+	// doesn't block the audio thread or a new file being swapped in
+	{
+		juce::SpinLock::ScopedLockType scope(lock);
+		object = this->object;
+		svg = this->svg;
+		svgSequence = this->svgSequence;
+		text = this->text;
+		gpla = this->gpla;
+		lua = this->lua;
+		img = this->img;
+	}
+
+	if (lua == nullptr || !lua->isFrameMode()) {
+		LuaParser::close(luaFrameState);
+	}
+
 	if (object != nullptr) {
 		return object->draw();
 	} else if (svg != nullptr) {
 		return svg->draw();
+	} else if (svgSequence != nullptr) {
+		return svgSequence->draw();
 	} else if (text != nullptr) {
 		return text->draw();
 	} else if (gpla != nullptr) {
 		return gpla->draw();
+	} else if (lua != nullptr && lua->isFrameMode()) {
+		luaFrameVars.sampleRate = audioProcessor.currentSampleRate;
+		luaFrameVars.frequency = audioProcessor.frequency;
+		std::copy(std::begin(audioProcessor.luaValues), std::end(audioProcessor.luaValues), std::begin(luaFrameVars.sliders));
+		// if the script has changed, draw resets luaFrameState for the new parser
+		return lua->draw(luaFrameState, luaFrameVars);
+	} else if (img != nullptr && audioProcessor.traceImage->getBoolValue()) {
+		return img->draw();
 	}
 	auto tempShapes = std::vector<std::unique_ptr<Shape>>();
 	// return a square
@@ -81,32 +228,54 @@ std::vector<std::unique_ptr<Shape>> FileParser::nextFrame() {
 }
 
 OsciPoint FileParser::nextSample(lua_State*& L, LuaVariables& vars) {
-	juce::SpinLock::ScopedLockType scope(lock);
+	std::shared_ptr<LuaParser> luaParser;
 
-	if (lua != nullptr) {
-		auto values = lua->run(L, vars);
-		if (values.size() == 2) {
-			return OsciPoint(values[0], values[1], 0);
-		} else if (values.size() > 2) {
-			return OsciPoint(values[0], values[1], values[2]);
+	{
+		juce::SpinLock::ScopedLockType scope(lock);
+
+		if (img != nullptr) {
+			return img->getSample();
+		} else if (wav != nullptr) {
+			return wav->getSample();
 		}
-	} else if (img != nullptr) {
-		return img->getSample();
-	} else if (wav != nullptr) {
-        return wav->getSample();
-    }
+		luaParser = lua;
+	}
+
+	// Lua runs outside of the lock, as each voice has its own lua_State and
+	// so several voices can run the same parser concurrently
+	if (luaParser != nullptr) {
+		return nextLuaSample(*luaParser, L, vars);
+	}
 
 	return OsciPoint();
 }
 
+std::shared_ptr<LuaParser> FileParser::getSampleLua() {
+	juce::SpinLock::ScopedLockType scope(lock);
+	return img == nullptr && wav == nullptr ? lua : nullptr;
+}
+
+OsciPoint FileParser::nextLuaSample(LuaParser& luaParser, lua_State*& L, LuaVariables& vars) {
+	float values[LuaParser::MAX_VALUES];
+	int numValues = luaParser.run(L, vars, values);
+	if (numValues == 2) {
+		return OsciPoint(values[0], values[1], 0);
+	} else if (numValues > 2) {
+		return OsciPoint(values[0], values[1], values[2]);
+	}
+	return OsciPoint();
+}
+
 void FileParser::closeLua(lua_State*& L) {
+	auto lua = getLua();
 	if (lua != nullptr) {
 		lua->close(L);
     }
 }
 
 bool FileParser::isSample() {
-	return sampleSource;
+	// traced images are drawn as frames instead
+	return sampleSource && !(imageSource && audioProcessor.traceImage->getBoolValue());
 }
 
 bool FileParser::isActive() {
@@ -122,29 +291,41 @@ void FileParser::enable() {
 }
 
 std::shared_ptr<WorldObject> FileParser::getObject() {
+	juce::SpinLock::ScopedLockType scope(lock);
 	return object;
 }
 
 std::shared_ptr<SvgParser> FileParser::getSvg() {
+	juce::SpinLock::ScopedLockType scope(lock);
 	return svg;
 }
 
+std::shared_ptr<SvgSequenceParser> FileParser::getSvgSequence() {
+	juce::SpinLock::ScopedLockType scope(lock);
+	return svgSequence;
+}
+
 std::shared_ptr<TextParser> FileParser::getText() {
+	juce::SpinLock::ScopedLockType scope(lock);
 	return text;
 }
 
 std::shared_ptr<LineArtParser> FileParser::getLineArt() {
+	juce::SpinLock::ScopedLockType scope(lock);
 	return gpla;
 }
 
 std::shared_ptr<LuaParser> FileParser::getLua() {
+	juce::SpinLock::ScopedLockType scope(lock);
 	return lua;
 }
 
 std::shared_ptr<ImageParser> FileParser::getImg() {
+	juce::SpinLock::ScopedLockType scope(lock);
 	return img;
 }
 
 std::shared_ptr<WavParser> FileParser::getWav() {
+	juce::SpinLock::ScopedLockType scope(lock);
     return wav;
 }
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "FrameSource.h"
+#include "ParseProgress.h"
 #include "../shape/Shape.h"
 #include "../obj/WorldObject.h"
 #include "../svg/SvgParser.h"
+#include "../svg/SvgSequenceParser.h"
 #include "../txt/TextParser.h"
 #include "../gpla/LineArtParser.h"
 #include "../lua/LuaParser.h"
@@ -11,13 +13,28 @@
 #include "../wav/WavParser.h"
 
 class OscirenderAudioProcessor;
-class FileParser {
+class FileParser : public std::enable_shared_from_this<FileParser> {
 public:
 	FileParser(OscirenderAudioProcessor &p, std::function<void(int, juce::String, juce::String)> errorCallback = nullptr);
+	~FileParser();
 
-	void parse(juce::String fileName, juce::String extension, std::unique_ptr<juce::InputStream> stream, juce::Font font);
+	// Parses the file on a background thread and swaps it in once it is ready,
+	// so the previously parsed file keeps playing in the meantime. Starting a
+	// new parse cancels any earlier ones that haven't finished.
+	void parseAsync(juce::String fileId, juce::String extension, std::shared_ptr<juce::MemoryBlock> data, juce::Font font, ObjSettings objSettings);
+	// stops the current parse part of the way through, if it can be
+	void cancelParse();
+	bool isParsing();
+	// how far through the current parse is, between 0 and 1. Only parses that
+	// can take a long time, like finding the path through a model, report this.
+	double getParseProgress();
 	std::vector<std::unique_ptr<Shape>> nextFrame();
 	OsciPoint nextSample(lua_State*& L, LuaVariables& vars);
+	// the Lua parser that nextSample runs, or nullptr if samples come from
+	// an image or audio file instead
+	std::shared_ptr<LuaParser> getSampleLua();
+	// runs one sample of a Lua parser, like nextSample does
+	static OsciPoint nextLuaSample(LuaParser& luaParser, lua_State*& L, LuaVariables& vars);
 	void closeLua(lua_State*& L);
 	bool isSample();
 	bool isActive();
@@ -26,31 +43,70 @@ public:
 
 	std::shared_ptr<WorldObject> getObject();
 	std::shared_ptr<SvgParser> getSvg();
+	std::shared_ptr<SvgSequenceParser> getSvgSequence();
 	std::shared_ptr<TextParser> getText();
 	std::shared_ptr<LineArtParser> getLineArt();
 	std::shared_ptr<LuaParser> getLua();
 	std::shared_ptr<ImageParser> getImg();
 	std::shared_ptr<WavParser> getWav();
 
-	bool isAnimatable = false;
+	std::atomic<bool> isAnimatable = false;
 
 private:
+	// everything produced by parsing a file, which is swapped in all at once
+	struct ParsedFile {
+		std::shared_ptr<WorldObject> object;
+		std::shared_ptr<SvgParser> svg;
+		std::shared_ptr<SvgSequenceParser> svgSequence;
+		std::shared_ptr<TextParser> text;
+		std::shared_ptr<LineArtParser> gpla;
+		std::shared_ptr<LuaParser> lua;
+		std::shared_ptr<ImageParser> img;
+		std::shared_ptr<WavParser> wav;
+		// keeps the file alive while parsers are streaming from it
+		std::shared_ptr<juce::MemoryBlock> data;
+		// old Lua parsers that are no longer in use, to be destroyed with this
+		std::vector<std::shared_ptr<LuaParser>> releasedLua;
+		bool isAnimatable = false;
+		bool sampleSource = false;
+	};
+
+	static ParsedFile parse(OscirenderAudioProcessor& audioProcessor, std::function<void(int, juce::String, juce::String)> errorCallback, juce::String fileId, juce::String extension, std::shared_ptr<juce::MemoryBlock> data, juce::Font font, ObjSettings objSettings, juce::String fallbackLuaScript, ParseProgress* progress);
+	void swapIn(ParsedFile& parsed, juce::String fallbackLuaScript);
+
 	OscirenderAudioProcessor& audioProcessor;
 
 	bool active = true;
-	bool sampleSource = false;
+	std::atomic<bool> sampleSource = false;
+	std::atomic<bool> imageSource = false;
+	// incremented for every parse, so that stale parses can be discarded
+	std::atomic<uint32_t> parseGeneration = 0;
+	// the generation of the parse that was last swapped in
+	std::atomic<uint32_t> parsedGeneration = 0;
+	// shared with the job running the latest parse, guarded by lock
+	std::shared_ptr<ParseProgress> parseProgress;
 
 	juce::SpinLock lock;
 
 	std::shared_ptr<WorldObject> object;
 	std::shared_ptr<SvgParser> svg;
+	std::shared_ptr<SvgSequenceParser> svgSequence;
 	std::shared_ptr<TextParser> text;
 	std::shared_ptr<LineArtParser> gpla;
 	std::shared_ptr<LuaParser> lua;
 	std::shared_ptr<ImageParser> img;
 	std::shared_ptr<WavParser> wav;
+	std::shared_ptr<juce::MemoryBlock> data;
+	// Old Lua parsers that the audio thread might still hold a copy of. They
+	// are kept here until nothing else holds them, so that the audio thread
+	// never destroys one.
+	std::vector<std::shared_ptr<LuaParser>> retiredLua;
 
 	juce::String fallbackLuaScript = "return { 0.0, 0.0 }";
 
+	// state used to run frame-mode Lua scripts on the frame producer thread
+	lua_State* luaFrameState = nullptr;
+	LuaVariables luaFrameVars;
+
 	std::function<void(int, juce::String, juce::String)> errorCallback;
 };
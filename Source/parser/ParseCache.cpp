@@ -0,0 +1,165 @@
+#include "ParseCache.h"
+
+// FNV-1a style hash over 8 byte words, with each word mixed by splitmix64.
+// This is only used to identify files, not for security.
+static juce::uint64 hashContent(const void* data, size_t size) {
+	auto mix = [](juce::uint64 x) {
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ull;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebull;
+		x ^= x >> 31;
+		return x;
+	};
+
+	const juce::uint8* bytes = (const juce::uint8*) data;
+	juce::uint64 hash = 14695981039346656037ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		juce::uint64 word;
+		std::memcpy(&word, bytes + i, 8);
+		hash = (hash ^ mix(word)) * 1099511628211ull;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return mix(hash);
+}
+
+ParseCache::ParseCache(juce::File directory, juce::int64 maxSizeBytes) : directory(directory), maxSizeBytes(maxSizeBytes) {}
+
+juce::File ParseCache::getDefaultDirectory() {
+	return juce::File::getSpecialLocation(juce::File::SpecialLocationType::userApplicationDataDirectory)
+#if JUCE_MAC
+		.getChildFile("Application Support")
+#endif
+		.getChildFile("osci-render")
+		.getChildFile("cache");
+}
+
+juce::String ParseCache::getKey(const juce::MemoryBlock& content, const juce::String& type, int parserVersion) {
+	juce::uint64 hash = hashContent(content.getData(), content.getSize());
+	return juce::String::toHexString((juce::int64) hash).paddedLeft('0', 16) + "-" + juce::String((juce::int64) content.getSize()) + "-" + juce::File::createLegalFileName(type) + "-v" + juce::String(parserVersion);
+}
+
+juce::File ParseCache::getEntryFile(const juce::String& key) {
+	return directory.getChildFile(key + ".bin");
+}
+
+bool ParseCache::load(const juce::String& key, std::vector<std::vector<Line>>& frames, juce::var* properties) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	juce::File file = getEntryFile(key);
+	juce::MemoryBlock data;
+	if (!file.existsAsFile() || !file.loadFileAsData(data)) {
+		return false;
+	}
+
+	juce::MemoryInputStream stream(data, false);
+	if ((juce::uint32) stream.readInt() != MAGIC || (juce::uint32) stream.readInt() != FORMAT_VERSION || stream.readString() != key) {
+		return false;
+	}
+
+	std::vector<std::vector<Line>> loaded;
+	int numFrames = stream.readInt();
+	if (numFrames < 0 || numFrames > stream.getNumBytesRemaining() / sizeof(int)) {
+		return false;
+	}
+	loaded.resize(numFrames);
+
+	for (auto& frame : loaded) {
+		int numLines = stream.readInt();
+		if (numLines < 0 || numLines > stream.getNumBytesRemaining() / (6 * sizeof(double))) {
+			return false;
+		}
+		frame.reserve(numLines);
+		for (int i = 0; i < numLines; i++) {
+			double values[6];
+			stream.read(values, sizeof(values));
+			frame.push_back(Line(values[0], values[1], values[2], values[3], values[4], values[5]));
+		}
+	}
+
+	juce::var loadedProperties = juce::JSON::parse(stream.readString());
+
+	frames = std::move(loaded);
+	if (properties != nullptr) {
+		*properties = loadedProperties;
+	}
+	// the modification time records when the entry was last used
+	file.setLastModificationTime(juce::Time::getCurrentTime());
+	return true;
+}
+
+void ParseCache::store(const juce::String& key, const std::vector<std::vector<Line>>& frames, const juce::var& properties) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!directory.exists() && !directory.createDirectory()) {
+		return;
+	}
+
+	juce::File file = getEntryFile(key);
+	// 0 if there isn't an entry being replaced
+	juce::int64 replacedSize = file.getSize();
+
+	juce::MemoryOutputStream stream;
+	stream.writeInt(MAGIC);
+	stream.writeInt(FORMAT_VERSION);
+	stream.writeString(key);
+	stream.writeInt(frames.size());
+
+	for (auto& frame : frames) {
+		stream.writeInt(frame.size());
+		for (auto& line : frame) {
+			// stored at full precision so that a cached file draws exactly
+			// the same as a freshly parsed one
+			double values[6] = { line.x1, line.y1, line.z1, line.x2, line.y2, line.z2 };
+			stream.write(values, sizeof(values));
+		}
+	}
+
+	stream.writeString(juce::JSON::toString(properties, true));
+
+	// written to a temporary file first so a partial entry is never read
+	juce::TemporaryFile temp(file);
+	if (temp.getFile().replaceWithData(stream.getData(), stream.getDataSize()) && temp.overwriteTargetFileWithTemporary() && cacheSize >= 0) {
+		cacheSize += (juce::int64) stream.getDataSize() - replacedSize;
+	}
+
+	evict();
+}
+
+// deletes the least recently used entries until the cache fits in its limit
+void ParseCache::evict() {
+	// the directory is only scanned the first time, and when the running
+	// total says the cache might be too big
+	if (cacheSize >= 0 && cacheSize <= maxSizeBytes) {
+		return;
+	}
+
+	auto entries = directory.findChildFiles(juce::File::findFiles, false, "*.bin");
+
+	juce::int64 totalSize = 0;
+	for (auto& entry : entries) {
+		totalSize += entry.getSize();
+	}
+	cacheSize = totalSize;
+	if (totalSize <= maxSizeBytes) {
+		return;
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const juce::File& a, const juce::File& b) {
+		return a.getLastModificationTime() < b.getLastModificationTime();
+	});
+
+	for (auto& entry : entries) {
+		if (totalSize <= maxSizeBytes) {
+			break;
+		}
+		juce::int64 size = entry.getSize();
+		if (entry.deleteFile()) {
+			totalSize -= size;
+		}
+	}
+	cacheSize = totalSize;
+}
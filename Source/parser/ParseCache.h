@@ -0,0 +1,44 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "../shape/Line.h"
+
+// A persistent cache of parsed files, so that files that are slow to parse
+// (e.g. OBJ files, which need a Chinese postman path) are only parsed once.
+//
+// Entries are keyed by a hash of the file's contents, the type of file, and
+// the version of the parser that produced them, so changing the file or the
+// parser invalidates the entry. Each entry stores the lines of every frame in
+// a binary form, at full precision, along with any properties of the parsed file that
+// would be expensive to recompute. When the cache grows larger than its size limit, the
+// least recently used entries are deleted.
+class ParseCache {
+public:
+	ParseCache(juce::File directory = getDefaultDirectory(), juce::int64 maxSizeBytes = 256 * 1024 * 1024);
+
+	static juce::File getDefaultDirectory();
+
+	// type should include any settings that affect the result of parsing
+	juce::String getKey(const juce::MemoryBlock& content, const juce::String& type, int parserVersion);
+
+	// returns false if there is no valid entry for this key
+	bool load(const juce::String& key, std::vector<std::vector<Line>>& frames, juce::var* properties = nullptr);
+	void store(const juce::String& key, const std::vector<std::vector<Line>>& frames, const juce::var& properties = juce::var());
+
+private:
+	static constexpr juce::uint32 MAGIC = 0x4f534343; // "OSCC"
+	static constexpr juce::uint32 FORMAT_VERSION = 3;
+
+	juce::File getEntryFile(const juce::String& key);
+	void evict();
+
+	juce::File directory;
+	juce::int64 maxSizeBytes;
+	// The total size of the entries, kept up to date as entries are stored,
+	// or -1 before the directory has been scanned. Other instances of the
+	// plugin can share the directory, so the directory is scanned again to
+	// get the real size before anything is deleted.
+	juce::int64 cacheSize = -1;
+	// entries are only read and written by file parsing threads
+	std::mutex mutex;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <atomic>
+
+// Shared between a parse running on a background thread and the FileParser
+// waiting for it, so that the parse can report how far it has got and can be
+// stopped part of the way through once its result is no longer wanted.
+class ParseProgress {
+public:
+    void cancel() {
+        cancelled = true;
+    }
+
+    // long running parses check this regularly and return early, with an
+    // incomplete result, when it is true
+    bool isCancelled() const {
+        return cancelled;
+    }
+
+    // between 0 and 1
+    void setProgress(double value) {
+        progress = value;
+    }
+
+    double getProgress() const {
+        return progress;
+    }
+
+private:
+    std::atomic<bool> cancelled = false;
+    std::atomic<double> progress = 0.0;
+};
@@ -4,24 +4,35 @@
 
 
 SvgParser::SvgParser(juce::String svgFile) {
+    juce::Path path;
+    if (parsePath(svgFile, path)) {
+        pathToShapes(path, shapes);
+        Shape::removeOutOfBounds(shapes);
+        return;
+    }
+    
+    drawError(shapes);
+}
+
+bool SvgParser::parsePath(const juce::String& svgFile, juce::Path& path) {
 	auto doc = juce::XmlDocument::parse(svgFile);
     if (doc != nullptr) {
         std::unique_ptr<juce::Drawable> svg = juce::Drawable::createFromSVG(*doc);
         juce::DrawableComposite* composite = dynamic_cast<juce::DrawableComposite*>(svg.get());
         if (composite != nullptr) {
             auto contentArea = composite->getContentArea();
-            auto path = svg->getOutlineAsPath();
+            path = svg->getOutlineAsPath();
             // apply transform to path to get the content area in the bounds -1 to 1
             path.applyTransform(juce::AffineTransform::translation(-contentArea.getX(), -contentArea.getY()));
             path.applyTransform(juce::AffineTransform::scale(2 / contentArea.getWidth(), 2 / contentArea.getHeight()));
             path.applyTransform(juce::AffineTransform::translation(-1, -1));
-
-            pathToShapes(path, shapes);
-            Shape::removeOutOfBounds(shapes);
-            return;
+            return true;
         }
     }
-    
+    return false;
+}
+
+void SvgParser::drawError(std::vector<std::unique_ptr<Shape>>& shapes) {
     // draw an X to indicate an error.
     shapes.push_back(std::make_unique<Line>(-0.5, -0.5, 0.5, 0.5));
     shapes.push_back(std::make_unique<Line>(-0.5, 0.5, 0.5, -0.5));
@@ -9,6 +9,11 @@ public:
 	~SvgParser();
 
 	static void pathToShapes(juce::Path& path, std::vector<std::unique_ptr<Shape>>& shapes);
+	// Parses an SVG file into a path, scaled so that its content area is
+	// from -1 to 1. Returns false if the file isn't a valid SVG.
+	static bool parsePath(const juce::String& svgFile, juce::Path& path);
+	// draws an X, to show that a file couldn't be parsed
+	static void drawError(std::vector<std::unique_ptr<Shape>>& shapes);
 
 	std::vector<std::unique_ptr<Shape>> draw();
 private:
@@ -0,0 +1,190 @@
+#include "SvgSequenceParser.h"
+#include "SvgParser.h"
+#include "../PluginProcessor.h"
+#include "../concurrency/ParallelFor.h"
+
+// how far, as a fraction of the height of the frame, a flattened curve can
+// stray from the real one
+static const float FLATTENING_TOLERANCE = 0.001f;
+
+SvgSequenceParser::SvgSequenceParser(OscirenderAudioProcessor& p, std::shared_ptr<juce::MemoryBlock> data) : audioProcessor(p), data(data) {
+    juce::ZipFile zip(new juce::MemoryInputStream(*data, false), true);
+    for (int i = 0; i < zip.getNumEntries(); i++) {
+        juce::String name = zip.getEntry(i)->filename;
+        // macOS adds hidden copies of every file to zips it makes
+        bool hidden = name.startsWith("__MACOSX") || name.fromLastOccurrenceOf("/", false, false).startsWith(".");
+        if (name.endsWithIgnoreCase(".svg") && !hidden) {
+            entries.push_back(i);
+        }
+    }
+    // natural order, so that frame2.svg comes before frame10.svg
+    std::sort(entries.begin(), entries.end(), [&zip](int a, int b) {
+        return zip.getEntry(a)->filename.compareNatural(zip.getEntry(b)->filename) < 0;
+    });
+
+    numFrames = entries.size();
+    frames.resize(numFrames);
+    loaded.resize(numFrames, false);
+    if (numFrames == 0) {
+        // there's nothing to play, so an error is drawn instead
+        frames.push_back(parseFrame(juce::String()));
+        loaded.push_back(true);
+        numFrames = 1;
+    }
+}
+
+SvgSequenceParser::~SvgSequenceParser() {}
+
+bool SvgSequenceParser::zipFolder(const juce::File& folder, juce::MemoryBlock& zip) {
+    juce::ZipFile::Builder builder;
+    for (auto& file : folder.findChildFiles(juce::File::findFiles, false, "*.svg")) {
+        // SVGs are small, so compressing them isn't worth the time
+        builder.addFile(file, 0, file.getFileName());
+    }
+    juce::MemoryOutputStream stream(zip, false);
+    return builder.writeToStream(stream, nullptr);
+}
+
+std::vector<Line> SvgSequenceParser::parseFrame(const juce::String& svgFile) {
+    std::vector<std::unique_ptr<Shape>> shapes;
+    juce::Path path;
+    if (SvgParser::parsePath(svgFile, path)) {
+        // y is flipped, as it is for a single SVG
+        juce::PathFlatteningIterator iterator(path, juce::AffineTransform(), FLATTENING_TOLERANCE);
+        while (iterator.next()) {
+            shapes.push_back(std::make_unique<Line>(iterator.x1, -iterator.y1, iterator.x2, -iterator.y2));
+        }
+        Shape::removeOutOfBounds(shapes);
+    } else {
+        SvgParser::drawError(shapes);
+    }
+
+    std::vector<Line> lines;
+    lines.reserve(shapes.size());
+    for (auto& shape : shapes) {
+        lines.push_back(*static_cast<Line*>(shape.get()));
+    }
+    return lines;
+}
+
+void SvgSequenceParser::startLoading() {
+    if (entries.empty()) {
+        return;
+    }
+
+    auto loading = std::make_shared<Loading>();
+    loading->data = data;
+    loading->entries = entries;
+    loadBatch(weak_from_this(), audioProcessor, loading);
+}
+
+void SvgSequenceParser::loadBatch(std::weak_ptr<SvgSequenceParser> weakParser, OscirenderAudioProcessor& audioProcessor, std::shared_ptr<Loading> loading) {
+    audioProcessor.fileParsingPool.addJob([weakParser, &audioProcessor, loading]() {
+        auto job = juce::ThreadPoolJob::getCurrentThreadPoolJob();
+        int numFrames = loading->entries.size();
+        // hands a parsed frame to the parser, or returns false if the parser
+        // has been deleted or the pool is stopping
+        auto publish = [&](int index, const std::vector<Line>& lines) {
+            if (job->shouldExit()) {
+                return false;
+            }
+            auto parser = weakParser.lock();
+            if (parser == nullptr) {
+                return false;
+            }
+            juce::SpinLock::ScopedLockType scope(parser->framesLock);
+            parser->frames[index] = lines;
+            parser->loaded[index] = true;
+            return true;
+        };
+
+        // the first batch checks the cache before anything is parsed
+        if (loading->zip == nullptr) {
+            loading->key = audioProcessor.parseCache.getKey(*loading->data, "svg-sequence", PARSER_VERSION);
+            std::vector<std::vector<Line>> frames;
+            if (audioProcessor.parseCache.load(loading->key, frames) && frames.size() == (size_t) numFrames) {
+                for (int i = 0; i < numFrames; i++) {
+                    if (!publish(i, frames[i])) {
+                        break;
+                    }
+                }
+                return juce::ThreadPoolJob::jobHasFinished;
+            }
+
+            loading->zip = std::make_unique<juce::ZipFile>(new juce::MemoryInputStream(*loading->data, false), true);
+            loading->frames.resize(numFrames);
+            loading->parsed.resize(numFrames, false);
+            loading->remaining = numFrames;
+        }
+
+        // the next frames to be shown that haven't been parsed yet
+        int start;
+        {
+            auto parser = weakParser.lock();
+            if (parser == nullptr || job->shouldExit()) {
+                return juce::ThreadPoolJob::jobHasFinished;
+            }
+            start = parser->frameIndex;
+        }
+        std::vector<int> batch;
+        for (int i = 0; i < numFrames && batch.size() < LOAD_BATCH; i++) {
+            int frame = (start + i) % numFrames;
+            if (!loading->parsed[frame]) {
+                batch.push_back(frame);
+            }
+        }
+
+        // reading the files is quick compared to parsing them
+        std::vector<juce::String> files;
+        for (int frame : batch) {
+            std::unique_ptr<juce::InputStream> stream(loading->zip->createStreamForEntry(loading->entries[frame]));
+            files.push_back(stream != nullptr ? stream->readEntireStreamAsString() : juce::String());
+        }
+        parallelFor((int) batch.size(), [&](int i) {
+            loading->frames[batch[i]] = parseFrame(files[i]);
+        });
+
+        for (int frame : batch) {
+            loading->parsed[frame] = true;
+            if (!publish(frame, loading->frames[frame])) {
+                return juce::ThreadPoolJob::jobHasFinished;
+            }
+        }
+
+        loading->remaining -= batch.size();
+        if (loading->remaining > 0) {
+            // the next batch goes to the back of the queue, so that other
+            // files are parsed in between rather than waiting for the
+            // whole sequence
+            loadBatch(weakParser, audioProcessor, loading);
+        } else {
+            audioProcessor.parseCache.store(loading->key, loading->frames);
+        }
+        return juce::ThreadPoolJob::jobHasFinished;
+    });
+}
+
+void SvgSequenceParser::setFrame(int index) {
+    // the modulo is done twice so that negative frames wrap around too
+    frameIndex = (numFrames + (index % numFrames)) % numFrames;
+}
+
+int SvgSequenceParser::getNumFrames() {
+    return numFrames;
+}
+
+std::vector<std::unique_ptr<Shape>> SvgSequenceParser::draw() {
+    std::vector<std::unique_ptr<Shape>> shapes;
+    juce::SpinLock::ScopedLockType scope(framesLock);
+    int frame = frameIndex;
+    // keep showing the last frame until this one has been parsed
+    if (loaded[frame]) {
+        shownFrame = frame;
+    }
+    if (shownFrame != -1) {
+        for (Line& line : frames[shownFrame]) {
+            shapes.push_back(line.clone());
+        }
+    }
+    return shapes;
+}
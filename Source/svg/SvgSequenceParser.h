@@ -0,0 +1,74 @@
+#pragma once
+#include <JuceHeader.h>
+#include "../shape/Shape.h"
+#include "../shape/Line.h"
+
+class OscirenderAudioProcessor;
+
+// Plays a sequence of SVG files as an animation, one file per frame, such as
+// those exported from After Effects. The files are read from a zip, in the
+// order of the numbers in their names. Folders of SVG files are zipped when
+// they are added, so that they are saved with a project like any other file.
+//
+// Frames are parsed in the background in parallel batches, starting from the
+// frame being shown, and each frame is drawn as soon as it's ready. Each
+// batch is its own job on fileParsingPool, so a long sequence doesn't keep
+// one of its threads from parsing other files. Curves
+// are flattened into lines, so that parsed sequences are kept in the parse
+// cache and open straight away the next time.
+class SvgSequenceParser : public std::enable_shared_from_this<SvgSequenceParser> {
+public:
+	SvgSequenceParser(OscirenderAudioProcessor& p, std::shared_ptr<juce::MemoryBlock> data);
+	~SvgSequenceParser();
+
+	// must be incremented whenever the lines produced for a sequence change
+	static const int PARSER_VERSION = 1;
+
+	// Zips the SVG files in a folder, without compressing them. Returns
+	// false if they couldn't be read.
+	static bool zipFolder(const juce::File& folder, juce::MemoryBlock& zip);
+	// an X if the file isn't a valid SVG
+	static std::vector<Line> parseFrame(const juce::String& svgFile);
+
+	// Starts parsing the frames in the background. Must be called once the
+	// parser is owned by a shared_ptr.
+	void startLoading();
+	void setFrame(int index);
+	int getNumFrames();
+	// Returns the lines of the current frame, or of the last frame that was
+	// ready if it hasn't been parsed yet.
+	std::vector<std::unique_ptr<Shape>> draw();
+
+private:
+	// frames that are parsed in parallel
+	static const int LOAD_BATCH = 16;
+
+	// what has been parsed so far, passed from each batch's job to the next
+	struct Loading {
+		std::shared_ptr<juce::MemoryBlock> data;
+		// reads from data, so is declared after it
+		std::unique_ptr<juce::ZipFile> zip;
+		std::vector<int> entries;
+		juce::String key;
+		std::vector<std::vector<Line>> frames;
+		std::vector<bool> parsed;
+		int remaining = 0;
+	};
+
+	// Queues a job that parses the next batch of frames and then queues the
+	// job for the batch after that, until every frame has been parsed
+	static void loadBatch(std::weak_ptr<SvgSequenceParser> weakParser, OscirenderAudioProcessor& audioProcessor, std::shared_ptr<Loading> loading);
+
+	OscirenderAudioProcessor& audioProcessor;
+	std::shared_ptr<juce::MemoryBlock> data;
+	// the zip entries of the frames, in the order they're played
+	std::vector<int> entries;
+	int numFrames = 0;
+	std::atomic<int> frameIndex = 0;
+
+	juce::SpinLock framesLock;
+	std::vector<std::vector<Line>> frames;
+	std::vector<bool> loaded;
+	// the frame that was last drawn, only used by draw
+	int shownFrame = -1;
+};
@@ -0,0 +1,106 @@
+#include "AudioOverview.h"
+
+AudioOverview::AudioOverview(std::function<juce::AudioFormatReader*()> createReader, juce::int64 totalSamples) : juce::Thread("Audio Overview"), createReader(createReader), totalSamples(totalSamples) {
+    juce::int64 numBins = (totalSamples + BIN_SIZE - 1) / BIN_SIZE;
+    while (numBins > 0) {
+        auto level = std::make_unique<Level>();
+        level->bins.resize(numBins);
+        levels.push_back(std::move(level));
+        numBins = numBins == 1 ? 0 : (numBins + 1) / 2;
+    }
+
+    if (!levels.empty()) {
+        startThread();
+    }
+}
+
+AudioOverview::~AudioOverview() {
+    stopThread(1000);
+}
+
+double AudioOverview::getProgress() {
+    if (levels.empty()) {
+        return 1.0;
+    }
+    return levels[0]->ready / (double) levels[0]->bins.size();
+}
+
+AudioOverview::Bin AudioOverview::merge(const Bin& a, const Bin& b) {
+    return {
+        juce::jmin(a.minX, b.minX), juce::jmax(a.maxX, b.maxX),
+        juce::jmin(a.minY, b.minY), juce::jmax(a.maxY, b.maxY),
+    };
+}
+
+void AudioOverview::run() {
+    std::unique_ptr<juce::AudioFormatReader> reader(createReader());
+    if (reader == nullptr || reader->numChannels == 0) {
+        return;
+    }
+
+    juce::AudioBuffer<float> buffer(juce::jmin(2, (int) reader->numChannels), READ_SIZE);
+    Level& detail = *levels[0];
+    for (juce::int64 start = 0; start < totalSamples && !threadShouldExit(); start += READ_SIZE) {
+        int numSamples = (int) juce::jmin((juce::int64) READ_SIZE, totalSamples - start);
+        reader->read(&buffer, 0, numSamples, start, true, true);
+
+        auto x = buffer.getReadPointer(0);
+        auto y = buffer.getReadPointer(buffer.getNumChannels() - 1);
+        juce::int64 first = start / BIN_SIZE;
+        for (int i = 0; i < numSamples; i += BIN_SIZE) {
+            int binSamples = juce::jmin(BIN_SIZE, numSamples - i);
+            auto xRange = juce::FloatVectorOperations::findMinAndMax(x + i, binSamples);
+            auto yRange = juce::FloatVectorOperations::findMinAndMax(y + i, binSamples);
+            detail.bins[first + i / BIN_SIZE] = { xRange.getStart(), xRange.getEnd(), yRange.getStart(), yRange.getEnd() };
+        }
+        detail.ready = first + (numSamples + BIN_SIZE - 1) / BIN_SIZE;
+        mergeLevels(detail.ready == detail.bins.size());
+    }
+}
+
+void AudioOverview::mergeLevels(bool finished) {
+    for (int i = 1; i < levels.size(); i++) {
+        Level& below = *levels[i - 1];
+        Level& level = *levels[i];
+        juce::int64 belowReady = below.ready;
+        juce::int64 ready = level.ready;
+        // the last bin may only cover one bin below, once it is all read
+        while (ready < level.bins.size() && (2 * ready + 1 < belowReady || (finished && 2 * ready < belowReady))) {
+            const Bin& a = below.bins[2 * ready];
+            level.bins[ready] = 2 * ready + 1 < below.bins.size() ? merge(a, below.bins[2 * ready + 1]) : a;
+            ready++;
+        }
+        level.ready = ready;
+    }
+}
+
+void AudioOverview::getBins(double start, double end, std::vector<Bin>& bins) {
+    std::fill(bins.begin(), bins.end(), Bin());
+    if (levels.empty() || bins.empty() || end <= start) {
+        return;
+    }
+
+    // the least detailed level that still has a bin for every output bin
+    double samplesPerBin = (end - start) * totalSamples / bins.size();
+    int index = 0;
+    while (index + 1 < levels.size() && ((juce::int64) BIN_SIZE << (index + 1)) <= samplesPerBin) {
+        index++;
+    }
+    Level& level = *levels[index];
+    double binSize = (double) ((juce::int64) BIN_SIZE << index);
+    juce::int64 ready = level.ready;
+
+    for (int i = 0; i < bins.size(); i++) {
+        double sample = start * totalSamples + i * samplesPerBin;
+        juce::int64 first = juce::jmax((juce::int64) 0, (juce::int64) (sample / binSize));
+        juce::int64 last = juce::jmin(ready, (juce::int64) std::ceil((sample + samplesPerBin) / binSize));
+        if (first >= last) {
+            continue;
+        }
+        Bin bin = level.bins[first];
+        for (juce::int64 j = first + 1; j < last; j++) {
+            bin = merge(bin, level.bins[j]);
+        }
+        bins[i] = bin;
+    }
+}
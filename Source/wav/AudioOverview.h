@@ -0,0 +1,57 @@
+#pragma once
+#include <JuceHeader.h>
+
+// The range of an audio file's samples at several resolutions, for drawing
+// its waveform and previewing it while scrubbing.
+//
+// The file is read once on a background thread into the most detailed level,
+// where each bin covers BIN_SIZE samples. Each level above it has half as
+// many bins, each covering two bins of the level below, so any part of the
+// file can be summarised from a handful of bins. Bins can be read while the
+// file is still being read, and the parts that haven't been read yet are
+// empty.
+class AudioOverview : private juce::Thread {
+public:
+    // the range of the x (left) and y (right) channels
+    struct Bin {
+        float minX = 0, maxX = 0;
+        float minY = 0, maxY = 0;
+    };
+
+    // createReader is called once, on the background thread, so it must
+    // create a reader that is separate from any used for playback
+    AudioOverview(std::function<juce::AudioFormatReader*()> createReader, juce::int64 totalSamples);
+    ~AudioOverview() override;
+
+    // the fraction of the file that has been read
+    double getProgress();
+
+    // Splits the part of the file between start and end, as fractions of its
+    // length, evenly between the bins, and fills each with the range of the
+    // samples in it.
+    void getBins(double start, double end, std::vector<Bin>& bins);
+
+private:
+    // samples in each bin of the most detailed level
+    static const int BIN_SIZE = 256;
+    // samples read from the file at a time
+    static const int READ_SIZE = 256 * BIN_SIZE;
+
+    struct Level {
+        std::vector<Bin> bins;
+        // bins before this have been filled
+        std::atomic<juce::int64> ready = 0;
+    };
+
+    void run() override;
+    // fills the bins of the levels above the most detailed one that the bins
+    // below them are ready for
+    void mergeLevels(bool finished);
+    static Bin merge(const Bin& a, const Bin& b);
+
+    std::function<juce::AudioFormatReader*()> createReader;
+    juce::int64 totalSamples;
+    std::vector<std::unique_ptr<Level>> levels;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioOverview)
+};
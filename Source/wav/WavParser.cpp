@@ -2,37 +2,96 @@
 #include "../CommonPluginProcessor.h"
 
 
-WavParser::WavParser(CommonAudioProcessor& p) : audioProcessor(p) {}
+WavParser::WavParser(CommonAudioProcessor& p) : juce::Thread("WAV Decoder"), audioProcessor(p) {}
 
-WavParser::~WavParser() {}
+WavParser::~WavParser() {
+    close();
+}
 
 bool WavParser::parse(std::unique_ptr<juce::InputStream> stream) {
-    initialised = false;
     if (stream == nullptr) {
+        initialised = false;
+        stopDecoding();
         return false;
     }
-    counter = 0;
-    currentSample = 0;
-    juce::AudioFormatManager formatManager;
-    formatManager.registerBasicFormats();
-    juce::AudioFormatReader* reader = formatManager.createReaderFor(std::move(stream));
+    // the stream is kept in memory so that the overview can read it too
+    auto data = std::make_shared<juce::MemoryBlock>();
+    stream->readIntoMemoryBlock(*data);
+    return parse(data);
+}
+
+bool WavParser::parse(std::shared_ptr<juce::MemoryBlock> data) {
+    return open([data]() {
+        juce::AudioFormatManager formatManager;
+        formatManager.registerBasicFormats();
+        return formatManager.createReaderFor(std::make_unique<juce::MemoryInputStream>(*data, false));
+    });
+}
+
+bool WavParser::parse(juce::File file) {
+    return open([file]() {
+        juce::AudioFormatReader* reader = createMappedReader(file);
+        if (reader == nullptr) {
+            // formats that can't be mapped, such as FLAC, are streamed instead
+            juce::AudioFormatManager formatManager;
+            formatManager.registerBasicFormats();
+            reader = formatManager.createReaderFor(file);
+        }
+        return reader;
+    });
+}
+
+juce::AudioFormatReader* WavParser::createMappedReader(juce::File file) {
+    std::unique_ptr<juce::AudioFormat> format;
+    if (file.hasFileExtension("wav;wave")) {
+        format = std::make_unique<juce::WavAudioFormat>();
+    } else if (file.hasFileExtension("aif;aiff")) {
+        format = std::make_unique<juce::AiffAudioFormat>();
+    } else {
+        return nullptr;
+    }
+
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader(format->createMemoryMappedReader(file));
+    if (reader == nullptr || !reader->mapEntireFile() || reader->getMappedSection().isEmpty()) {
+        return nullptr;
+    }
+    return reader.release();
+}
+
+bool WavParser::open(std::function<juce::AudioFormatReader*()> createReader) {
+    initialised = false;
+    stopDecoding();
+    juce::AudioFormatReader* reader = createReader();
     if (reader == nullptr) {
         return false;
     }
     afSource = new juce::AudioFormatReaderSource(reader, true);
-    if (afSource == nullptr) {
-        return false;
-    }
     totalSamples = afSource->getTotalLength();
     afSource->setLooping(looping);
     source = std::make_unique<juce::ResamplingAudioSource>(afSource, true, reader->numChannels);
-    if (source == nullptr) {
-        return false;
-    }
     fileSampleRate = reader->sampleRate;
-    audioBuffer.setSize(reader->numChannels, 1);
-    setSampleRate(audioProcessor.currentSampleRate);
+    audioBuffer.setSize(reader->numChannels, BLOCK_SIZE);
+    currentSampleRate = 0;
+    progress = 0;
+    previewSamples = 0;
+    overview = std::make_shared<AudioOverview>(createReader, totalSamples);
+
+    // enough blocks to cover the read ahead at high sample rates, with one
+    // more for the block being played
+    double sampleRate = juce::jmax(48000.0, (double) audioProcessor.currentSampleRate);
+    int numBlocks = juce::jmax(4, (int) std::ceil(READ_AHEAD * sampleRate / BLOCK_SIZE) + 1);
+    blocks = std::vector<Block>(numBlocks);
+    empty = std::make_unique<LockFreeQueue<int>>(numBlocks);
+    decoded = std::make_unique<LockFreeQueue<int>>(numBlocks);
+    for (int i = 0; i < numBlocks; i++) {
+        empty->tryPush(i);
+    }
+    current = -1;
+    position = 0;
+    decodedGeneration = generation;
+
     initialised = true;
+    startThread();
 
     return true;
 }
@@ -40,64 +99,123 @@ bool WavParser::parse(std::unique_ptr<juce::InputStream> stream) {
 void WavParser::close() {
     if (initialised) {
         initialised = false;
+        stopDecoding();
         source.reset();
         afSource = nullptr;
+        overview = nullptr;
     }
 }
 
+void WavParser::stopDecoding() {
+    signalThreadShouldExit();
+    notify();
+    stopThread(1000);
+}
+
 bool WavParser::isInitialised() {
     return initialised;
 }
 
-void WavParser::setSampleRate(double sampleRate) {
-    double ratio = fileSampleRate / sampleRate;
-    source->setResamplingRatio(ratio);
-    source->prepareToPlay(1, sampleRate);
-    currentSampleRate = sampleRate;
+std::shared_ptr<AudioOverview> WavParser::getOverview() {
+    return initialised ? overview : nullptr;
 }
 
-OsciPoint WavParser::getSample() {
-    if (!initialised || paused) {
-        return OsciPoint();
-    }
+double WavParser::getProgress() {
+    return progress;
+}
 
-    if (currentSampleRate != audioProcessor.currentSampleRate) {
-        setSampleRate(audioProcessor.currentSampleRate);
-    }
+void WavParser::run() {
+    while (!threadShouldExit()) {
+        juce::uint32 seek = generation;
+        if (seek != decodedGeneration) {
+            decodedGeneration = seek;
+            afSource->setNextReadPosition(seekProgress * totalSamples);
+            source->flushBuffers();
+        }
+
+        double sampleRate = audioProcessor.currentSampleRate;
+        if (sampleRate > 0 && sampleRate != currentSampleRate) {
+            source->setResamplingRatio(fileSampleRate / sampleRate);
+            source->prepareToPlay(BLOCK_SIZE, sampleRate);
+            currentSampleRate = sampleRate;
+        }
 
-    if (looping != afSource->isLooping()) {
-        afSource->setLooping(looping);
+        if (looping != afSource->isLooping()) {
+            afSource->setLooping(looping);
+            // start again if looping is turned on after the end
+            if (looping && afSource->getNextReadPosition() >= totalSamples) {
+                afSource->setNextReadPosition(0);
+            }
+        }
+        // nothing is decoded once the end has been reached, so it is silent
+        bool finished = !looping && afSource->getNextReadPosition() >= totalSamples;
+
+        int index;
+        if (currentSampleRate == 0 || finished || !empty->tryPop(index)) {
+            wait(WAIT_TIME);
+            continue;
+        }
+
+        Block& block = blocks[index];
+        block.generation = seek;
+        decodeBlock(block);
+        decoded->tryPush(index);
     }
+}
 
+void WavParser::decodeBlock(Block& block) {
+    block.start = afSource->getNextReadPosition();
+    block.step = source->getResamplingRatio();
     source->getNextAudioBlock(juce::AudioSourceChannelInfo(audioBuffer));
-    currentSample += source->getResamplingRatio();
-    counter++;
-    if (currentSample >= totalSamples && afSource->isLooping()) {
-        currentSample = 0;
-        counter = 0;
-        afSource->setNextReadPosition(0);
-    }
-    if (counter % currentSampleRate == 0) {
-        if (onProgress != nullptr) {
-            onProgress((double)currentSample / totalSamples);
+
+    int numChannels = audioBuffer.getNumChannels();
+    auto channels = audioBuffer.getArrayOfReadPointers();
+    for (int i = 0; i < BLOCK_SIZE; i++) {
+        if (numChannels == 1) {
+            block.points[i] = OsciPoint(channels[0][i], channels[0][i], 1.0);
+        } else if (numChannels == 2) {
+            block.points[i] = OsciPoint(channels[0][i], channels[1][i], 1.0);
+        } else if (numChannels >= 3) {
+            block.points[i] = OsciPoint(channels[0][i], channels[1][i], channels[2][i]);
+        } else {
+            block.points[i] = OsciPoint();
         }
     }
-    
-    if (audioBuffer.getNumChannels() == 1) {
-        return OsciPoint(audioBuffer.getSample(0, 0), audioBuffer.getSample(0, 0), 1.0);
-    } else if (audioBuffer.getNumChannels() == 2) {
-        return OsciPoint(audioBuffer.getSample(0, 0), audioBuffer.getSample(1, 0), 1.0);
-    } else if (audioBuffer.getNumChannels() >= 3) {
-        return OsciPoint(audioBuffer.getSample(0, 0), audioBuffer.getSample(1, 0), audioBuffer.getSample(2, 0));
-    } else {
+}
+
+OsciPoint WavParser::getSample() {
+    if (!initialised || (paused && previewSamples <= 0)) {
         return OsciPoint();
     }
+
+    juce::uint32 seek = generation;
+    while (current == -1 || position == BLOCK_SIZE || blocks[current].generation != seek) {
+        if (current != -1) {
+            empty->tryPush(current);
+            current = -1;
+        }
+        // the decoding thread has fallen behind, or the file has finished
+        if (!decoded->tryPop(current)) {
+            return OsciPoint();
+        }
+        position = 0;
+        progress = std::fmod(blocks[current].start, (double) totalSamples) / totalSamples;
+    }
+
+    if (paused) {
+        previewSamples--;
+    }
+    return blocks[current].points[position++];
 }
 
 void WavParser::setProgress(double progress) {
     if (initialised) {
-        afSource->setNextReadPosition(progress * totalSamples);
-        currentSample = progress * totalSamples;
+        seekProgress = progress;
+        this->progress = progress;
+        generation++;
+        if (paused) {
+            previewSamples = PREVIEW_LENGTH;
+        }
     }
 }
 
@@ -111,7 +229,7 @@ bool WavParser::isLooping() {
 
 void WavParser::setPaused(bool paused) {
     this->paused = paused;
-    counter = 0;
+    previewSamples = 0;
 }
 
 bool WavParser::isPaused() {
@@ -1,28 +1,71 @@
 #pragma once
 #include "../shape/OsciPoint.h"
 #include <JuceHeader.h>
+#include "../concurrency/LockFreeQueue.h"
+#include "AudioOverview.h"
 
 class CommonAudioProcessor;
-class WavParser {
+
+// Plays an audio file as a source of points. The file is decoded and
+// resampled a block at a time on a background thread, ahead of where it is
+// playing, so getSample only ever reads from blocks that are ready and never
+// waits for the file or locks.
+//
+// WAV and AIFF files are memory mapped rather than read, so seeking anywhere
+// in them is instant, and an overview of the file is read in the background
+// for drawing and scrubbing through it.
+class WavParser : private juce::Thread {
 public:
     WavParser(CommonAudioProcessor& p);
-	~WavParser();
+	~WavParser() override;
 
 	OsciPoint getSample();
 
 	void setProgress(double progress);
 	void setPaused(bool paused);
 	bool isPaused();
+	// takes effect after the audio that has already been decoded ahead
 	void setLooping(bool looping);
 	bool isLooping();
+	// how far through the file playback is, from 0 to 1
+	double getProgress();
 	bool parse(std::unique_ptr<juce::InputStream> stream);
+	bool parse(std::shared_ptr<juce::MemoryBlock> data);
+	bool parse(juce::File file);
 	void close();
 	bool isInitialised();
-
-	std::function<void(double)> onProgress;
+	// nullptr if no file is open
+	std::shared_ptr<AudioOverview> getOverview();
 
 private:
-	void setSampleRate(double sampleRate);
+	// samples in each decoded block
+	static const int BLOCK_SIZE = 512;
+	// seconds of audio that are decoded ahead of playback
+	static constexpr double READ_AHEAD = 0.2;
+	// how long, in milliseconds, the decoding thread sleeps once it is ahead
+	static const int WAIT_TIME = 5;
+	// samples that are played when seeking while paused, so that the
+	// visualiser shows where playback is
+	static const int PREVIEW_LENGTH = 2048;
+
+	struct Block {
+		std::vector<OsciPoint> points = std::vector<OsciPoint>(BLOCK_SIZE);
+		// the seek that the block was decoded after, so blocks from before a
+		// seek are skipped
+		juce::uint32 generation = 0;
+		// where in the file the block starts, and how far each sample moves
+		double start = 0;
+		double step = 1;
+	};
+
+	// creates a reader that reads samples straight from a memory mapped file,
+	// or nullptr if the file can't be mapped
+	static juce::AudioFormatReader* createMappedReader(juce::File file);
+	// opens a file using createReader, which is also used by the overview
+	bool open(std::function<juce::AudioFormatReader*()> createReader);
+	void run() override;
+	void stopDecoding();
+	void decodeBlock(Block& block);
 
 	std::atomic<bool> initialised = false;
 	juce::AudioFormatReaderSource* afSource = nullptr;
@@ -30,10 +73,30 @@ private:
 	std::unique_ptr<juce::ResamplingAudioSource> source = nullptr;
 	juce::AudioBuffer<float> audioBuffer;
 	std::atomic<long> totalSamples;
-	std::atomic<long> counter = 0;
-    std::atomic<double> currentSample = 0;
+	std::atomic<double> progress = 0;
 	std::atomic<bool> paused = false;
+	// samples left to preview while paused
+	std::atomic<int> previewSamples = 0;
+	std::shared_ptr<AudioOverview> overview;
 	int fileSampleRate;
-	int currentSampleRate;
+	// the sample rate that source is resampling to, only used by the decoding thread
+	double currentSampleRate = 0;
+
+	// Blocks are passed between the threads by their index. The decoding
+	// thread fills blocks from empty and pushes them to decoded, and
+	// getSample hands them back to empty once it has played them.
+	std::vector<Block> blocks;
+	std::unique_ptr<LockFreeQueue<int>> empty;
+	std::unique_ptr<LockFreeQueue<int>> decoded;
+	// the block being played by getSample, or -1 if none
+	int current = -1;
+	int position = 0;
+
+	// incremented by every seek
+	std::atomic<juce::uint32> generation = 0;
+	std::atomic<double> seekProgress = 0;
+	// the seek that the decoding thread last acted on
+	juce::uint32 decodedGeneration = 0;
+
     CommonAudioProcessor& audioProcessor;
 };
@@ -1,7 +1,7 @@
 bl_info = {
     "name": "osci-render",
     "author": "James Ball", 
-    "version": (1, 1, 0),
+    "version": (1, 2, 0),
     "blender": (3, 1, 2),
     "location": "View3D",
     "description": "Addon to send gpencil frames over to osci-render",
@@ -18,6 +18,7 @@ import json
 import atexit
 import struct
 import base64
+import zlib
 from bpy.props import StringProperty
 from bpy.app.handlers import persistent
 from bpy_extras.io_utils import ImportHelper
@@ -28,10 +29,23 @@ PORT = 51677
 sock = None
 
 
-GPLA_MAJOR = 2
+# Version 2 was written by earlier versions of this add-on, but in the same
+# format as version 1. Version 3 is the compact format.
+GPLA_MAJOR = 3
 GPLA_MINOR = 0
 GPLA_PATCH = 0
 
+# file flags
+GPLA_QUANTISED = 1
+
+# object flags
+GPLA_SAME_MATRIX = 1
+GPLA_SAME_STROKES = 2
+
+# frame compression methods
+GPLA_UNCOMPRESSED = 0
+GPLA_ZLIB = 1
+
 
 class OBJECT_PT_osci_render_settings(bpy.types.Panel):
     bl_idname = "OBJECT_PT_osci_render_settings"
@@ -45,6 +59,7 @@ class OBJECT_PT_osci_render_settings(bpy.types.Panel):
 
     def draw(self, context):
         self.layout.prop(context.scene, "oscirenderPort")
+        self.layout.prop(context.scene, "oscirenderQuantise")
         global sock
         if sock is None:
             self.layout.operator("render.osci_render_connect", text="Connect to osci-render instance")
@@ -127,32 +142,99 @@ def close_osci_render():
         except socket.error as exp:
             sock = None
 
-def get_gpla_file_allframes(scene):
+def write_varint(bin, value):
+    while value >= 0x80:
+        bin.append((value & 0x7F) | 0x80)
+        value >>= 7
+    bin.append(value)
+
+
+def write_signed_varint(bin, value):
+    # zigzag encoding, so that small negative numbers are small too
+    write_varint(bin, value * 2 if value >= 0 else -value * 2 - 1)
+
+
+def to_float32(values):
+    return list(struct.unpack("<%df" % len(values), struct.pack("<%df" % len(values), *values)))
+
+
+def get_strokes_binary(strokes, quantise):
     bin = bytearray()
+    strokes = [stroke for stroke in strokes if len(stroke) > 0]
     
-    # header
-    bin.extend(("GPLA    ").encode("utf8"))
-    bin.extend(GPLA_MAJOR.to_bytes(8, "little"))
-    bin.extend(GPLA_MINOR.to_bytes(8, "little"))
-    bin.extend(GPLA_PATCH.to_bytes(8, "little"))
+    if quantise:
+        # vertices are stored as steps between the smallest and largest x, y and z
+        points = [point for stroke in strokes for point in stroke]
+        origin = to_float32([min((point[i] for point in points), default=0) for i in range(3)])
+        largest = [max((point[i] for point in points), default=0) for i in range(3)]
+        step = to_float32([(largest[i] - origin[i]) / 65535 for i in range(3)])
+        bin.extend(struct.pack("<6f", *origin, *step))
     
-    # file info
-    bin.extend(("FILE    ").encode("utf8"))
-    bin.extend(("fCount  ").encode("utf8"))
-    bin.extend((scene.frame_end - scene.frame_start + 1).to_bytes(8, "little"))
-    bin.extend(("fRate   ").encode("utf8"))
-    bin.extend(scene.render.fps.to_bytes(8, "little"))
-    bin.extend(("DONE    ").encode("utf8"))
+    write_varint(bin, len(strokes))
+    last = [0, 0, 0]
+    for stroke in strokes:
+        write_varint(bin, len(stroke))
+        for point in stroke:
+            if quantise:
+                for i in range(3):
+                    steps = round((point[i] - origin[i]) / step[i]) if step[i] > 0 else 0
+                    steps = min(max(steps, 0), 65535)
+                    write_signed_varint(bin, steps - last[i])
+                    last[i] = steps
+            else:
+                bin.extend(struct.pack("<3f", *point))
     
-    for frame in range(0, scene.frame_end - scene.frame_start + 1):
-        scene.frame_set(frame + scene.frame_start)
-        bin.extend(get_frame_info_binary())
+    return bin
+
+
+def get_frame_binary(focal_length, objects, previous, frame, quantise):
+    # previous holds the matrix and strokes of each object in the previous
+    # frame, and the frames they are stored in, so that unchanged ones are
+    # only stored once
+    frame_info = bytearray(struct.pack("<f", focal_length))
+    write_varint(frame_info, len(objects))
     
-    bin.extend(("END GPLA").encode("utf8"))
+    stored = []
+    for i, (matrix, strokes) in enumerate(objects):
+        matrix_bin = struct.pack("<12f", *matrix)
+        strokes_bin = get_strokes_binary(strokes, quantise)
+        matrix_frame = frame
+        strokes_frame = frame
+        flags = 0
+        if previous is not None and i < len(previous):
+            if previous[i][0] == matrix_bin:
+                flags |= GPLA_SAME_MATRIX
+                matrix_frame = previous[i][1]
+            if previous[i][2] == strokes_bin:
+                flags |= GPLA_SAME_STROKES
+                strokes_frame = previous[i][3]
+        
+        frame_info.append(flags)
+        if flags & GPLA_SAME_MATRIX:
+            write_varint(frame_info, matrix_frame)
+        else:
+            frame_info.extend(matrix_bin)
+        if flags & GPLA_SAME_STROKES:
+            write_varint(frame_info, strokes_frame)
+        else:
+            frame_info.extend(strokes_bin)
+        
+        stored.append((matrix_bin, matrix_frame, strokes_bin, strokes_frame))
     
-    return bin
+    # size, compression method, then the frame
+    chunk = bytearray(struct.pack("<I", len(frame_info)))
+    compressed = zlib.compress(bytes(frame_info))
+    if len(compressed) < len(frame_info):
+        chunk.append(GPLA_ZLIB)
+        chunk.extend(compressed)
+    else:
+        chunk.append(GPLA_UNCOMPRESSED)
+        chunk.extend(frame_info)
     
-def get_gpla_file(scene):
+    return chunk, stored
+
+
+def get_gpla_binary(frames, frame_rate, quantise):
     bin = bytearray()
     
     # header
@@ -162,18 +244,34 @@ def get_gpla_file(scene):
     bin.extend(GPLA_PATCH.to_bytes(8, "little"))
     
     # file info
-    bin.extend(("FILE    ").encode("utf8"))
-    bin.extend(("fCount  ").encode("utf8"))
-    bin.extend((scene.frame_end - scene.frame_start + 1).to_bytes(8, "little"))
-    bin.extend(("fRate   ").encode("utf8"))
-    bin.extend(scene.render.fps.to_bytes(8, "little"))
-    bin.extend(("DONE    ").encode("utf8"))
+    bin.extend(struct.pack("<3I", GPLA_QUANTISED if quantise else 0, len(frames), frame_rate))
     
-    bin.extend(get_frame_info_binary())
+    # where each frame starts, and where the last one ends
+    offset = len(bin) + 8 * (len(frames) + 1)
+    for frame in frames:
+        bin.extend(struct.pack("<Q", offset))
+        offset += len(frame)
+    bin.extend(struct.pack("<Q", offset))
     
-    bin.extend(("END GPLA").encode("utf8"))
+    for frame in frames:
+        bin.extend(frame)
     
     return bin
+
+def get_gpla_file_allframes(scene):
+    frames = []
+    previous = None
+    for frame in range(0, scene.frame_end - scene.frame_start + 1):
+        scene.frame_set(frame + scene.frame_start)
+        chunk, previous = get_frame_binary(get_focal_length(), get_frame_objects(), previous, frame, scene.oscirenderQuantise)
+        frames.append(chunk)
+    
+    return get_gpla_binary(frames, scene.render.fps, scene.oscirenderQuantise)
+    
+def get_gpla_file(scene):
+    chunk, _ = get_frame_binary(get_focal_length(), get_frame_objects(), None, 0, scene.oscirenderQuantise)
+    
+    return get_gpla_binary([chunk], scene.render.fps, scene.oscirenderQuantise)
     
 @persistent
 def save_scene_to_file(scene, file_path):
@@ -190,108 +288,36 @@ def save_scene_to_file(scene, file_path):
     scene.frame_set(return_frame)
     return 0
 
-def get_frame_info_binary():
-    frame_info = bytearray() 
-    frame_info.extend(("FRAME   ").encode("utf8"))
-    
-    frame_info.extend(("focalLen").encode("utf8"))
-    frame_info.extend(struct.pack("d", -0.05 * bpy.data.cameras[0].lens))
-    
-    frame_info.extend(("OBJECTS ").encode("utf8"))
-    
-    if (bpy.app.version[0] > 4) or (bpy.app.version[0] == 4 and bpy.app.version[1] >= 3):
-        for object in bpy.data.objects:
-            if object.visible_get() and object.type == 'GREASEPENCIL':
-                dg =  bpy.context.evaluated_depsgraph_get()
-                obj = object.evaluated_get(dg)
-                frame_info.extend(("OBJECT  ").encode("utf8"))
-                
-                # matrix
-                frame_info.extend(("MATRIX  ").encode("utf8"))
-                camera_space = bpy.context.scene.camera.matrix_world.inverted() @ obj.matrix_world
-                for i in range(4):
-                    for j in range(4):
-                        frame_info.extend(struct.pack("d", camera_space[i][j]))
-                frame_info.extend(("DONE    ").encode("utf8"))
-                
-                # strokes
-                frame_info.extend(("STROKES ").encode("utf8"))
-                layers = obj.data.layers
-                for layer in layers:
-                    strokes = layer.frames.data.current_frame().drawing.strokes
-                    for stroke in strokes:
-                        frame_info.extend(("STROKE  ").encode("utf8"))
-                    
-                        frame_info.extend(("vertexCt").encode("utf8"))
-                        frame_info.extend(len(stroke.points).to_bytes(8, "little"))
-                    
-                        frame_info.extend(("VERTICES").encode("utf8"))
-                        for vert in stroke.points:
-                            frame_info.extend(struct.pack("d", vert.position.x))
-                            frame_info.extend(struct.pack("d", vert.position.y))
-                            frame_info.extend(struct.pack("d", vert.position.z))
-                        # VERTICES
-                        frame_info.extend(("DONE    ").encode("utf8"))
-                
-                        # STROKE
-                        frame_info.extend(("DONE    ").encode("utf8"))
-                
-                # STROKES
-                frame_info.extend(("DONE    ").encode("utf8"))
-                
-                # OBJECT
-                frame_info.extend(("DONE    ").encode("utf8"))
-    else:
-        for object in bpy.data.objects: 
-            if object.visible_get() and object.type == 'GPENCIL':
-                dg =  bpy.context.evaluated_depsgraph_get()
-                obj = object.evaluated_get(dg)
-                frame_info.extend(("OBJECT  ").encode("utf8"))
-                
-                # matrix
-                frame_info.extend(("MATRIX  ").encode("utf8"))
-                camera_space = bpy.context.scene.camera.matrix_world.inverted() @ obj.matrix_world
-                for i in range(4):
-                    for j in range(4):
-                        frame_info.extend(struct.pack("d", camera_space[i][j]))
-                # MATRIX
-                frame_info.extend(("DONE    ").encode("utf8"))
-                
-                # strokes
-                frame_info.extend(("STROKES ").encode("utf8"))
-                layers = obj.data.layers
-                for layer in layers:
-                    strokes = layer.frames.data.active_frame.strokes
-                    for stroke in strokes:
-                        frame_info.extend(("STROKE  ").encode("utf8"))
-                        
-                        frame_info.extend(("vertexCt").encode("utf8"))
-                        frame_info.extend(len(stroke.points).to_bytes(8, "little"))
-                        
-                        frame_info.extend(("VERTICES").encode("utf8"))
-                        for vert in stroke.points:
-                            frame_info.extend(struct.pack("d", vert.co[0]))
-                            frame_info.extend(struct.pack("d", vert.co[1]))
-                            frame_info.extend(struct.pack("d", vert.co[2]))
-                        # VERTICES
-                        frame_info.extend(("DONE    ").encode("utf8"))
-                    
-                        # STROKE
-                        frame_info.extend(("DONE    ").encode("utf8"))
-                
-                # STROKES
-                frame_info.extend(("DONE    ").encode("utf8"))
-                
-                # OBJECT
-                frame_info.extend(("DONE    ").encode("utf8"))
-    
-    # OBJECTS
-    frame_info.extend(("DONE    ").encode("utf8"))
+def get_focal_length():
+    return -0.05 * bpy.data.cameras[0].lens
+
+def get_frame_objects():
+    # the camera space matrix and strokes of each visible grease pencil object
+    objects = []
+    new_api = (bpy.app.version[0] > 4) or (bpy.app.version[0] == 4 and bpy.app.version[1] >= 3)
     
-    # FRAME
-    frame_info.extend(("DONE    ").encode("utf8"))
+    for object in bpy.data.objects:
+        if object.visible_get() and object.type == ('GREASEPENCIL' if new_api else 'GPENCIL'):
+            dg =  bpy.context.evaluated_depsgraph_get()
+            obj = object.evaluated_get(dg)
+            
+            # only the top three rows of the matrix are used
+            camera_space = bpy.context.scene.camera.matrix_world.inverted() @ obj.matrix_world
+            matrix = [camera_space[i][j] for i in range(3) for j in range(4)]
+            
+            strokes = []
+            layers = obj.data.layers
+            for layer in layers:
+                if new_api:
+                    for stroke in layer.frames.data.current_frame().drawing.strokes:
+                        strokes.append([(vert.position.x, vert.position.y, vert.position.z) for vert in stroke.points])
+                else:
+                    for stroke in layer.frames.data.active_frame.strokes:
+                        strokes.append([(vert.co[0], vert.co[1], vert.co[2]) for vert in stroke.points])
+            
+            objects.append((matrix, strokes))
     
-    return frame_info
+    return objects
     
 
 @persistent
@@ -311,6 +337,7 @@ operations = [OBJECT_PT_osci_render_settings, osci_render_connect, osci_render_c
 
 def register():
     bpy.types.Scene.oscirenderPort = bpy.props.IntProperty(name="osci-render port",description="The port through which osci-render will connect",min=51600,max=51699,default=51677)
+    bpy.types.Scene.oscirenderQuantise = bpy.props.BoolProperty(name="Quantise vertices",description="Store vertices in 16 bits, which makes line art much smaller at a slight loss of precision",default=True)
     bpy.app.handlers.frame_change_pre.append(send_scene_to_osci_render)
     bpy.app.handlers.depsgraph_update_post.append(send_scene_to_osci_render)
     atexit.register(close_osci_render)
@@ -320,6 +347,7 @@ def register():
 
 def unregister():
     del bpy.types.Object.oscirenderPort
+    del bpy.types.Scene.oscirenderQuantise
     bpy.app.handlers.frame_change_pre.remove(send_scene_to_osci_render)
     bpy.app.handlers.depsgraph_update_post.remove(send_scene_to_osci_render)
     atexit.unregister(close_osci_render)